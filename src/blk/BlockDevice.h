@@ -229,12 +229,18 @@ public:
   virtual void reset_zone(uint64_t zone) {
     ceph_assert(is_smr());
   }
+  /// write pointer (absolute offset) of each zone, conventional zones
+  /// report their start
   virtual std::vector<uint64_t> get_zones() {
     ceph_assert(is_smr());
     return std::vector<uint64_t>();
   }
 
   virtual void aio_submit(IOContext *ioc) = 0;
+  /// batch the aio_submit() calls made by this thread until aio_unplug();
+  /// plugs nest, backends without submission batching ignore them
+  virtual void aio_plug() {}
+  virtual void aio_unplug() {}
 
   void set_no_exclusive_lock() {
     lock_exclusive = false;
@@ -34,6 +34,7 @@ struct aio_t {
   boost::container::small_vector<iovec,4> iov;
   uint64_t offset, length;
   long rval;
+  bool is_write = false;
   ceph::buffer::list bl;  ///< write payload (so that it remains stable for duration)
 
   boost::intrusive::list_member_hook<> queue_item;
@@ -44,6 +45,7 @@ struct aio_t {
   void pwritev(uint64_t _offset, uint64_t len) {
     offset = _offset;
     length = len;
+    is_write = true;
 #if defined(HAVE_LIBAIO)
     io_prep_pwritev(&iocb, fd, &iov[0], iov.size(), offset);
 #elif defined(HAVE_POSIXAIO)
@@ -104,6 +106,17 @@ struct io_queue_t {
   virtual int submit_batch(aio_iter begin, aio_iter end,
 			   void *priv, int *retries, int submit_retries, int initial_delay_us) = 0;
   virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+
+  /// while plugged, batches queued by the calling thread may be held back
+  /// and handed to the kernel together on the outermost unplug()
+  virtual void plug() {}
+  virtual void unplug() {}
+
+  /// have the kernel map these long-lived buffers once, rather than on
+  /// every io that reads into or writes from them
+  virtual int register_buffers(const std::vector<iovec>& bufs) {
+    return -EOPNOTSUPP;
+  }
 };
 
 struct aio_queue_t final : public io_queue_t {
@@ -24,6 +24,11 @@
 #include <sys/mman.h>
 #include <chrono>
 
+#if defined(__linux__)
+#include <linux/blkzoned.h>
+#include <linux/falloc.h>
+#endif
+
 #include <boost/container/flat_map.hpp>
 #include <boost/lockfree/queue.hpp>
 
@@ -299,6 +304,11 @@ int KernelDevice::open(const string& p)
     }
   }
 
+  r = _zoned_open(S_ISBLK(st.st_mode));
+  if (r < 0) {
+    goto out_fail;
+  }
+
   r = _post_open();
   if (r < 0) {
     goto out_fail;
@@ -327,6 +337,12 @@ int KernelDevice::open(const string& p)
 	  << " " << (rotational ? "rotational device," : "non-rotational device,")
       << " discard " << (support_discard ? "supported" : "not supported")
 	  << dendl;
+  if (is_smr()) {
+    dout(1) << __func__ << " zoned device" << (zoned_emulated ? " (emulated)" : "")
+	    << ", zone_size 0x" << std::hex << zone_size
+	    << " conventional region 0x" << conventional_region_size << std::dec
+	    << dendl;
+  }
   return 0;
 
 out_fail:
@@ -410,6 +426,239 @@ void KernelDevice::close()
   path.clear();
 }
 
+// zone ioctls count in 512 byte sectors
+static constexpr unsigned ZONE_SECTOR_SHIFT = 9;
+
+int KernelDevice::_zoned_open(bool is_block)
+{
+  zone_size = 0;
+  conventional_region_size = 0;
+  zoned_emulated = false;
+  emulated_zones.clear();
+#if defined(__linux__) && defined(BLKGETZONESZ)
+  if (is_block) {
+    if (!BlkDev(fd_directs[WRITE_LIFE_NOT_SET]).is_host_managed_zoned()) {
+      // host-aware drives take random writes like any other
+      return 0;
+    }
+    uint32_t zone_sectors = 0;
+    if (::ioctl(fd_directs[WRITE_LIFE_NOT_SET], BLKGETZONESZ, &zone_sectors) < 0 ||
+        zone_sectors == 0) {
+      return 0;  // not zoned
+    }
+    zone_size = (uint64_t)zone_sectors << ZONE_SECTOR_SHIFT;
+    std::vector<std::pair<uint64_t, bool>> zones;
+    int r = _report_zones(&zones);
+    if (r < 0) {
+      derr << __func__ << " failed to report zones: " << cpp_strerror(r)
+	   << dendl;
+      zone_size = 0;
+      return r;
+    }
+    for (auto& [wp, conventional] : zones) {
+      if (!conventional) {
+	break;
+      }
+      conventional_region_size += zone_size;
+    }
+    dout(1) << __func__ << " " << zones.size() << " zones" << dendl;
+    return 0;
+  }
+#endif
+  uint64_t emulate = cct->_conf.get_val<Option::size_t>(
+    "bdev_zoned_emulate_zone_size");
+  if (is_block || emulate == 0) {
+    return 0;
+  }
+  if (emulate % block_size) {
+    derr << __func__ << " bdev_zoned_emulate_zone_size 0x" << std::hex
+	 << emulate << " is not a multiple of block size 0x" << block_size
+	 << std::dec << dendl;
+    return -EINVAL;
+  }
+  uint64_t num_zones = size / emulate;
+  uint64_t num_conventional = std::min<uint64_t>(
+    num_zones,
+    cct->_conf.get_val<uint64_t>("bdev_zoned_emulate_conventional_zones"));
+  zone_size = emulate;
+  conventional_region_size = num_conventional * zone_size;
+  zoned_emulated = true;
+  // a zone is written sequentially, so its write pointer is where the
+  // data in the file ends
+  for (uint64_t z = num_conventional; z < num_zones; ++z) {
+    uint64_t start = z * zone_size;
+    off_t hole = ::lseek(fd_buffereds[WRITE_LIFE_NOT_SET], start, SEEK_HOLE);
+    if (hole < 0) {
+      hole = start;
+    }
+    uint64_t wp = std::clamp<uint64_t>(hole, start, start + zone_size);
+    emulated_zones.push_back({wp, wp});
+  }
+  return 0;
+}
+
+int KernelDevice::_report_zones(
+  std::vector<std::pair<uint64_t, bool>> *zones) const
+{
+#if defined(__linux__) && defined(BLKREPORTZONE)
+  const unsigned batch = 4096;
+  std::vector<char> buf(sizeof(blk_zone_report) + batch * sizeof(blk_zone));
+  auto rep = reinterpret_cast<blk_zone_report*>(buf.data());
+  uint64_t sector = 0;
+  uint64_t end = size >> ZONE_SECTOR_SHIFT;
+  while (sector < end) {
+    memset(buf.data(), 0, buf.size());
+    rep->sector = sector;
+    rep->nr_zones = batch;
+    if (::ioctl(fd_directs[WRITE_LIFE_NOT_SET], BLKREPORTZONE, rep) < 0) {
+      return -errno;
+    }
+    if (rep->nr_zones == 0) {
+      break;
+    }
+    for (unsigned i = 0; i < rep->nr_zones; ++i) {
+      const blk_zone& z = rep->zones[i];
+      bool conventional = z.type == BLK_ZONE_TYPE_CONVENTIONAL;
+      uint64_t wp = conventional ? z.start : z.wp;
+      if (z.cond == BLK_ZONE_COND_FULL) {
+	wp = z.start + z.len;
+      }
+      zones->emplace_back(wp << ZONE_SECTOR_SHIFT, conventional);
+      sector = z.start + z.len;
+    }
+  }
+  return 0;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
+int KernelDevice::_zoned_check_write(uint64_t off, uint64_t len)
+{
+  // writes to a sequential zone must follow those submitted before, this
+  // is what the device would enforce
+  std::lock_guard l(zone_lock);
+  uint64_t end = off + len;
+  off = std::max(off, conventional_region_size);
+  while (off < end) {
+    uint64_t zone = off / zone_size;
+    uint64_t idx = zone - conventional_region_size / zone_size;
+    uint64_t l = std::min(end, (zone + 1) * zone_size) - off;
+    if (idx >= emulated_zones.size()) {
+      break;  // tail past the last whole zone
+    }
+    auto& z = emulated_zones[idx];
+    if (z.submitted != off) {
+      derr << __func__ << " unaligned write 0x" << std::hex << off << "~" << l
+	   << " to zone " << std::dec << zone << " with write pointer 0x"
+	   << std::hex << z.submitted << std::dec << dendl;
+      return -EIO;
+    }
+    z.submitted += l;
+    off += l;
+  }
+  return 0;
+}
+
+void KernelDevice::_zoned_write_done(uint64_t off, uint64_t len, bool ok)
+{
+  // the write pointer only moves once the data is on the device; a failed
+  // write takes the submission point back to where it started
+  std::lock_guard l(zone_lock);
+  uint64_t end = off + len;
+  off = std::max(off, conventional_region_size);
+  while (off < end) {
+    uint64_t zone = off / zone_size;
+    uint64_t idx = zone - conventional_region_size / zone_size;
+    uint64_t l = std::min(end, (zone + 1) * zone_size) - off;
+    if (idx >= emulated_zones.size()) {
+      break;
+    }
+    auto& z = emulated_zones[idx];
+    if (ok) {
+      z.wp = std::max(z.wp, off + l);
+    } else {
+      z.submitted = std::min(z.submitted, off);
+    }
+    off += l;
+  }
+}
+
+void KernelDevice::reset_zone(uint64_t zone)
+{
+  ceph_assert(is_smr());
+  uint64_t start = zone * zone_size;
+  ceph_assert(start >= conventional_region_size);
+  ceph_assert(start + zone_size <= size);
+  dout(10) << __func__ << " zone " << zone << dendl;
+  if (zoned_emulated) {
+    std::lock_guard l(zone_lock);
+#if defined(FALLOC_FL_PUNCH_HOLE)
+    if (::fallocate(fd_directs[WRITE_LIFE_NOT_SET],
+		    FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		    start, zone_size) < 0) {
+      int r = -errno;
+      derr << __func__ << " failed to punch zone " << zone << ": "
+	   << cpp_strerror(r) << dendl;
+      ceph_abort_msg("failed to reset zone");
+    }
+#endif
+    emulated_zones[zone - conventional_region_size / zone_size] = {start, start};
+    return;
+  }
+#if defined(__linux__) && defined(BLKRESETZONE)
+  blk_zone_range range;
+  range.sector = start >> ZONE_SECTOR_SHIFT;
+  range.nr_sectors = zone_size >> ZONE_SECTOR_SHIFT;
+  if (::ioctl(fd_directs[WRITE_LIFE_NOT_SET], BLKRESETZONE, &range) < 0) {
+    int r = -errno;
+    derr << __func__ << " failed to reset zone " << zone << ": "
+	 << cpp_strerror(r) << dendl;
+    ceph_abort_msg("failed to reset zone");
+  }
+#else
+  ceph_abort_msg("zoned devices are not supported on this platform");
+#endif
+}
+
+void KernelDevice::reset_all_zones()
+{
+  ceph_assert(is_smr());
+  dout(10) << __func__ << dendl;
+  for (uint64_t zone = conventional_region_size / zone_size;
+       zone < size / zone_size; ++zone) {
+    reset_zone(zone);
+  }
+}
+
+std::vector<uint64_t> KernelDevice::get_zones()
+{
+  ceph_assert(is_smr());
+  std::vector<uint64_t> res;
+  if (zoned_emulated) {
+    for (uint64_t start = 0; start < conventional_region_size;
+	 start += zone_size) {
+      res.push_back(start);
+    }
+    std::lock_guard l(zone_lock);
+    for (auto& z : emulated_zones) {
+      res.push_back(z.wp);
+    }
+    return res;
+  }
+  std::vector<std::pair<uint64_t, bool>> zones;
+  int r = _report_zones(&zones);
+  if (r < 0) {
+    derr << __func__ << " failed to report zones: " << cpp_strerror(r)
+	 << dendl;
+    ceph_abort_msg("failed to report zones");
+  }
+  for (auto& [wp, conventional] : zones) {
+    res.push_back(wp);
+  }
+  return res;
+}
+
 int KernelDevice::collect_metadata(const string& prefix, map<string,string> *pm) const
 {
   (*pm)[prefix + "support_discard"] = stringify((int)(bool)support_discard);
@@ -418,6 +667,12 @@ int KernelDevice::collect_metadata(const string& prefix, map<string,string> *pm)
   (*pm)[prefix + "block_size"] = stringify(get_block_size());
   (*pm)[prefix + "optimal_io_size"] = stringify(get_optimal_io_size());
   (*pm)[prefix + "driver"] = "KernelDevice";
+  if (is_smr()) {
+    (*pm)[prefix + "zoned"] = zoned_emulated ? "emulated" : "host-managed";
+    (*pm)[prefix + "zone_size"] = stringify(zone_size);
+    (*pm)[prefix + "conventional_region_size"] =
+      stringify(conventional_region_size);
+  }
   if (rotational) {
     (*pm)[prefix + "type"] = "hdd";
   } else {
@@ -591,6 +846,7 @@ int KernelDevice::_aio_start()
       }
       return r;
     }
+    _aio_register_buffers();
     aio_thread.create("bstore_aio");
   }
   return 0;
@@ -736,6 +992,10 @@ void KernelDevice::_aio_thread()
 	io_since_flush.store(true);
 
 	long r = aio[i]->get_return_value();
+	if (zoned_emulated && aio[i]->is_write) {
+	  _zoned_write_done(aio[i]->offset, aio[i]->length,
+			    r >= 0 && (uint64_t)r == aio[i]->length);
+	}
         if (r < 0) {
           derr << __func__ << " got r=" << r << " (" << cpp_strerror(r) << ")"
 	       << dendl;
@@ -1082,6 +1342,20 @@ void KernelDevice::aio_submit(IOContext *ioc)
   }
 }
 
+void KernelDevice::aio_plug()
+{
+  if (aio) {
+    io_queue->plug();
+  }
+}
+
+void KernelDevice::aio_unplug()
+{
+  if (aio) {
+    io_queue->unplug();
+  }
+}
+
 int KernelDevice::_sync_write(uint64_t off, bufferlist &bl, bool buffered, int write_hint)
 {
   uint64_t len = bl.length();
@@ -1161,6 +1435,12 @@ int KernelDevice::write(
 	       << dendl;
     return 0;
   }
+  if (zoned_emulated) {
+    int r = _zoned_check_write(off, len);
+    if (r < 0) {
+      return r;
+    }
+  }
 
   if ((!buffered || bl.get_num_buffers() >= IOV_MAX) &&
       bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
@@ -1170,7 +1450,11 @@ int KernelDevice::write(
   bl.hexdump(*_dout);
   *_dout << dendl;
 
-  return _sync_write(off, bl, buffered, write_hint);
+  int r = _sync_write(off, bl, buffered, write_hint);
+  if (zoned_emulated) {
+    _zoned_write_done(off, len, r >= 0);
+  }
+  return r;
 }
 
 int KernelDevice::aio_write(
@@ -1190,6 +1474,12 @@ int KernelDevice::aio_write(
 	       << dendl;
     return 0;
   }
+  if (zoned_emulated) {
+    int r = _zoned_check_write(off, len);
+    if (r < 0) {
+      return r;
+    }
+  }
 
   if ((!buffered || bl.get_num_buffers() >= IOV_MAX) &&
       bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
@@ -1260,6 +1550,9 @@ int KernelDevice::aio_write(
   {
     int r = _sync_write(off, bl, buffered, write_hint);
     _aio_log_finish(ioc, off, len);
+    if (zoned_emulated) {
+      _zoned_write_done(off, len, r >= 0);
+    }
     if (r < 0)
       return r;
   }
@@ -1315,6 +1608,7 @@ struct ExplicitHugePagePool {
 
   ExplicitHugePagePool(const size_t buffer_size, size_t buffers_in_pool)
     : buffer_size(buffer_size), region_q(buffers_in_pool) {
+    regions.reserve(buffers_in_pool);
     while (buffers_in_pool--) {
       void* const mmaped_region = ::mmap(
         nullptr,
@@ -1338,6 +1632,7 @@ struct ExplicitHugePagePool {
                    " /proc/sys/vm/nr_hugepages misconfigured?");
       } else {
         region_q.push(mmaped_region);
+        regions.push_back(iovec{mmaped_region, buffer_size});
       }
     }
   }
@@ -1363,9 +1658,14 @@ struct ExplicitHugePagePool {
     return buffer_size;
   }
 
+  const std::vector<iovec>& get_regions() const {
+    return regions;
+  }
+
 private:
   const size_t buffer_size;
   region_queue_t region_q;
+  std::vector<iovec> regions; // every region of the pool, for registration
 };
 
 struct HugePagePoolOfPools {
@@ -1395,6 +1695,16 @@ struct HugePagePoolOfPools {
     return nullptr;
   }
 
+  std::vector<iovec> get_regions() const {
+    std::vector<iovec> regions;
+    for (const auto& pool : pools) {
+      regions.insert(std::end(regions),
+                     std::begin(pool.get_regions()),
+                     std::end(pool.get_regions()));
+    }
+    return regions;
+  }
+
   static HugePagePoolOfPools from_desc(const std::string& conf);
 
 private:
@@ -1422,6 +1732,39 @@ HugePagePoolOfPools HugePagePoolOfPools::from_desc(const std::string& desc) {
   return HugePagePoolOfPools{std::move(conf)};
 }
 
+static HugePagePoolOfPools& get_hp_pools(CephContext* cct)
+{
+  static HugePagePoolOfPools hp_pools = HugePagePoolOfPools::from_desc(
+    cct->_conf.get_val<std::string>("bdev_read_preallocated_huge_buffers")
+  );
+  return hp_pools;
+}
+
+// reads landing in the huge page pools are then issued against
+// buffers the kernel has mapped once, see io_queue_t::register_buffers()
+void KernelDevice::_aio_register_buffers()
+{
+  if (cct->_conf.get_val<std::string>(
+        "bdev_read_preallocated_huge_buffers").empty()) {
+    return;
+  }
+  auto regions = get_hp_pools(cct).get_regions();
+  if (regions.empty()) {
+    return;
+  }
+  int r = io_queue->register_buffers(regions);
+  if (r == -EOPNOTSUPP) {
+    return;
+  } else if (r < 0) {
+    derr << __func__ << " failed to register " << regions.size()
+         << " huge buffers, ios on them pin pages per request: "
+         << cpp_strerror(r) << dendl;
+  } else {
+    dout(1) << __func__ << " registered " << regions.size()
+            << " huge buffers" << dendl;
+  }
+}
+
 // create a buffer basing on user-configurable. it's intended to make
 // our buffers THP-able.
 ceph::unique_leakable_ptr<buffer::raw> KernelDevice::create_custom_aligned(
@@ -1432,10 +1775,7 @@ ceph::unique_leakable_ptr<buffer::raw> KernelDevice::create_custom_aligned(
   if (len < CEPH_PAGE_SIZE) {
     return ceph::buffer::create_small_page_aligned(len);
   } else {
-    static HugePagePoolOfPools hp_pools = HugePagePoolOfPools::from_desc(
-      cct->_conf.get_val<std::string>("bdev_read_preallocated_huge_buffers")
-    );
-    if (auto lucky_raw = hp_pools.try_create(len); lucky_raw) {
+    if (auto lucky_raw = get_hp_pools(cct).try_create(len); lucky_raw) {
       dout(20) << __func__ << " allocated from huge pool"
 	       << " lucky_raw.data=" << (void*)lucky_raw->get_data()
 	       << " bdev_read_preallocated_huge_buffers="
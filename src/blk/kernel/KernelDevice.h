@@ -105,6 +105,7 @@ private:
 
   int _aio_start();
   void _aio_stop();
+  void _aio_register_buffers();
 
   void _discard_update_threads(bool discard_stop = false);
   void _discard_stop();
@@ -119,6 +120,21 @@ private:
 
   int direct_read_unaligned(uint64_t off, uint64_t len, char *buf);
 
+  // zoned devices: zone_size/conventional_region_size are detected at open,
+  // on a regular file zones may be emulated (bdev_zoned_emulate_zone_size)
+  bool zoned_emulated = false;
+  ceph::mutex zone_lock = ceph::make_mutex("KernelDevice::zone_lock");
+  struct emulated_zone_t {
+    uint64_t wp;         ///< end of the completed writes
+    uint64_t submitted;  ///< end of the submitted writes
+  };
+  std::vector<emulated_zone_t> emulated_zones;  ///< the sequential zones
+  int _zoned_open(bool is_block);
+  /// (write pointer, conventional) for every zone of a real zoned device
+  int _report_zones(std::vector<std::pair<uint64_t, bool>> *zones) const;
+  int _zoned_check_write(uint64_t off, uint64_t len);
+  void _zoned_write_done(uint64_t off, uint64_t len, bool ok);
+
   // stalled aio debugging
   aio_list_t debug_queue;
   ceph::mutex debug_queue_lock = ceph::make_mutex("KernelDevice::debug_queue_lock");
@@ -137,6 +153,8 @@ public:
   ~KernelDevice();
 
   void aio_submit(IOContext *ioc) override;
+  void aio_plug() override;
+  void aio_unplug() override;
   void discard_drain() override;
   void swap_discard_queued(interval_set<uint64_t>& other) override;
   int collect_metadata(const std::string& prefix, std::map<std::string,std::string> *pm) const override;
@@ -151,6 +169,13 @@ public:
   int refresh_size() override;
 
   int get_ebd_state(ExtBlkDevState &state) const override;
+
+  bool is_smr() const override {
+    return zone_size != 0;
+  }
+  void reset_all_zones() override;
+  void reset_zone(uint64_t zone) override;
+  std::vector<uint64_t> get_zones() override;
   int detect_ebd(std::string& id) override;
 
   int read(uint64_t off, uint64_t len, ceph::buffer::list *pbl,
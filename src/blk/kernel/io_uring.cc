@@ -18,8 +18,32 @@ struct ioring_data {
   pthread_mutex_t sq_mutex;
   int epoll_fd = -1;
   std::map<int, int> fixed_fds_map;
+  // registered buffers: start address -> (length, buffer index)
+  std::map<uintptr_t, std::pair<size_t, int>> fixed_bufs_map;
 };
 
+/*
+ * Per-thread plugging: while a thread holds a plug on a ring, the sqes it
+ * prepares are left in the SQ ring and handed to the kernel with a single
+ * io_uring_submit() when the outermost plug is released.  Another thread
+ * submitting in between simply flushes them earlier.
+ */
+struct ioring_plug_t {
+  struct ioring_data *d;
+  unsigned depth;
+  bool pending;
+};
+static thread_local std::vector<ioring_plug_t> ioring_plugs;
+
+static ioring_plug_t *find_plug(struct ioring_data *d)
+{
+  for (auto& p : ioring_plugs) {
+    if (p.d == d)
+      return &p;
+  }
+  return nullptr;
+}
+
 static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
 			  struct aio_t **paio)
 {
@@ -51,51 +75,88 @@ static int find_fixed_fd(struct ioring_data *d, int real_fd)
   return it->second;
 }
 
+/* the registered buffer holding all of the io's single iovec, if any */
+static int find_fixed_buf(struct ioring_data *d, struct aio_t *io)
+{
+  if (d->fixed_bufs_map.empty() || io->iov.size() != 1)
+    return -1;
+
+  uintptr_t base = (uintptr_t)io->iov[0].iov_base;
+  auto it = d->fixed_bufs_map.upper_bound(base);
+  if (it == d->fixed_bufs_map.begin())
+    return -1;
+  --it;
+  if (base + io->iov[0].iov_len > it->first + it->second.first)
+    return -1;
+
+  return it->second.second;
+}
+
 static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 		     struct aio_t *io)
 {
   int fixed_fd = find_fixed_fd(d, io->fd);
+  int fixed_buf = find_fixed_buf(d, io);
 
   ceph_assert(fixed_fd != -1);
 
-  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
-    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
-			 io->iov.size(), io->offset);
-  else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
-    io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
-			io->iov.size(), io->offset);
-  else
+  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV) {
+    if (fixed_buf != -1)
+      io_uring_prep_write_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+				io->iov[0].iov_len, io->offset, fixed_buf);
+    else
+      io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
+			   io->iov.size(), io->offset);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV) {
+    if (fixed_buf != -1)
+      io_uring_prep_read_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+			       io->iov[0].iov_len, io->offset, fixed_buf);
+    else
+      io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
+			  io->iov.size(), io->offset);
+  } else {
     ceph_assert(0);
+  }
 
   io_uring_sqe_set_data(sqe, io);
   io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
 }
 
 static int ioring_queue(struct ioring_data *d, void *priv,
-			list<aio_t>::iterator beg, list<aio_t>::iterator end)
+			list<aio_t>::iterator beg, list<aio_t>::iterator end,
+			bool defer_submit)
 {
   struct io_uring *ring = &d->io_uring;
-  struct aio_t *io = nullptr;
+  int submitted = 0;
 
   ceph_assert(beg != end);
 
   do {
-    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-    if (!sqe)
-      break;
-
-    io = &*beg;
+    struct io_uring_sqe *sqe;
+    while (!(sqe = io_uring_get_sqe(ring))) {
+      /* SQ ring is full, hand what we have to the kernel first */
+      int r = io_uring_submit(ring);
+      if (r < 0)
+	return r;
+      submitted += r;
+      if (ring->flags & IORING_SETUP_SQPOLL)
+	io_uring_sqring_wait(ring);
+    }
+
+    struct aio_t *io = &*beg;
     io->priv = priv;
 
     init_sqe(d, sqe, io);
 
   } while (++beg != end);
 
-  if (!io)
-    /* Queue is full, go and reap something first */
-    return 0;
+  if (defer_submit)
+    return submitted;
 
-  return io_uring_submit(ring);
+  int r = io_uring_submit(ring);
+  if (r < 0)
+    return r;
+  return submitted + r;
 }
 
 static void build_fixed_fds_map(struct ioring_data *d,
@@ -172,6 +233,10 @@ close_ring_fd:
 
 void ioring_queue_t::shutdown()
 {
+  if (!d->fixed_bufs_map.empty()) {
+    d->fixed_bufs_map.clear();
+    io_uring_unregister_buffers(&d->io_uring);
+  }
   d->fixed_fds_map.clear();
   close(d->epoll_fd);
   d->epoll_fd = -1;
@@ -185,13 +250,62 @@ int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
 {
   (void)retries;
 
+  ioring_plug_t *plug = find_plug(d.get());
+  bool defer = plug && plug->depth;
+
   pthread_mutex_lock(&d->sq_mutex);
-  int rc = ioring_queue(d.get(), priv, beg, end);
+  int rc = ioring_queue(d.get(), priv, beg, end, defer);
   pthread_mutex_unlock(&d->sq_mutex);
 
+  if (defer)
+    plug->pending = true;
+
   return rc;
 }
 
+void ioring_queue_t::plug()
+{
+  ioring_plug_t *plug = find_plug(d.get());
+  if (!plug) {
+    ioring_plugs.push_back(ioring_plug_t{d.get(), 0, false});
+    plug = &ioring_plugs.back();
+  }
+  ++plug->depth;
+}
+
+void ioring_queue_t::unplug()
+{
+  ioring_plug_t *plug = find_plug(d.get());
+  ceph_assert(plug && plug->depth);
+  if (--plug->depth)
+    return;
+
+  bool pending = plug->pending;
+  ioring_plugs.erase(ioring_plugs.begin() + (plug - &ioring_plugs[0]));
+  if (!pending)
+    return;
+
+  pthread_mutex_lock(&d->sq_mutex);
+  int r = io_uring_submit(&d->io_uring);
+  pthread_mutex_unlock(&d->sq_mutex);
+  ceph_assert(r >= 0);
+}
+
+int ioring_queue_t::register_buffers(const std::vector<iovec>& bufs)
+{
+  ceph_assert(d->fixed_bufs_map.empty());
+
+  int ret = io_uring_register_buffers(&d->io_uring, bufs.data(), bufs.size());
+  if (ret < 0)
+    return ret;
+
+  int index = 0;
+  for (auto& b : bufs) {
+    d->fixed_bufs_map[(uintptr_t)b.iov_base] = {b.iov_len, index++};
+  }
+  return 0;
+}
+
 int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
 {
 get_cqe:
@@ -259,6 +373,21 @@ int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
   ceph_assert(0);
 }
 
+void ioring_queue_t::plug()
+{
+  ceph_assert(0);
+}
+
+void ioring_queue_t::unplug()
+{
+  ceph_assert(0);
+}
+
+int ioring_queue_t::register_buffers(const std::vector<iovec>& bufs)
+{
+  ceph_assert(0);
+}
+
 bool ioring_queue_t::supported()
 {
   return false;
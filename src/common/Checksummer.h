@@ -4,6 +4,8 @@
 #ifndef CEPH_OS_BLUESTORE_CHECKSUMMER
 #define CEPH_OS_BLUESTORE_CHECKSUMMER
 
+#include <algorithm>
+
 #include "include/buffer.h"
 #include "include/byteorder.h"
 #include "include/ceph_assert.h"
@@ -90,6 +92,16 @@ public:
       ) {
       return p.crc32c(len, init_value);
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value,
+			 reinterpret_cast<const unsigned char*>(data),
+			 len);
+    }
   };
 
   struct crc32c_16 {
@@ -111,6 +123,16 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xffff;
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value,
+			 reinterpret_cast<const unsigned char*>(data),
+			 len) & 0xffff;
+    }
   };
 
   struct crc32c_8 {
@@ -132,6 +154,16 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xff;
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value,
+			 reinterpret_cast<const unsigned char*>(data),
+			 len) & 0xff;
+    }
   };
 
   struct xxhash32 {
@@ -161,6 +193,14 @@ public:
       }
       return XXH32_digest(state);
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return XXH32(data, len, init_value);
+    }
   };
 
   struct xxhash64 {
@@ -190,6 +230,14 @@ public:
       }
       return XXH64_digest(state);
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return XXH64(data, len, init_value);
+    }
   };
 
   template<class Alg>
@@ -212,24 +260,20 @@ public:
       const ceph::buffer::list &bl,
       ceph::buffer::ptr* csum_data) {
     ceph_assert(length % csum_block_size == 0);
-    size_t blocks = length / csum_block_size;
-    ceph::buffer::list::const_iterator p = bl.begin();
     ceph_assert(bl.length() >= length);
 
-    typename Alg::state_t state;
-    Alg::init(&state);
-
     ceph_assert(csum_data->length() >= (offset + length) / csum_block_size *
 	   sizeof(typename Alg::value_t));
 
     typename Alg::value_t *pv =
       reinterpret_cast<typename Alg::value_t*>(csum_data->c_str());
     pv += offset / csum_block_size;
-    while (blocks--) {
-      *pv = Alg::calc(state, init_value, csum_block_size, p);
-      ++pv;
-    }
-    Alg::fini(&state);
+    calc_chunks<Alg>(
+      init_value, csum_block_size, length, bl,
+      [&](size_t, typename Alg::init_value_t v) {
+	*pv++ = v;
+	return true;
+      });
     return 0;
   }
 
@@ -243,31 +287,70 @@ public:
     uint64_t *bad_csum=0
     ) {
     ceph_assert(length % csum_block_size == 0);
-    ceph::buffer::list::const_iterator p = bl.begin();
     ceph_assert(bl.length() >= length);
 
-    typename Alg::state_t state;
-    Alg::init(&state);
-
     const typename Alg::value_t *pv =
       reinterpret_cast<const typename Alg::value_t*>(csum_data.c_str());
     pv += offset / csum_block_size;
-    size_t pos = offset;
-    while (length > 0) {
-      typename Alg::init_value_t v = Alg::calc(state, -1, csum_block_size, p);
-      if (*pv != v) {
-	if (bad_csum) {
-	  *bad_csum = v;
+    int bad = -1;  // no errors
+    calc_chunks<Alg>(
+      -1, csum_block_size, length, bl,
+      [&](size_t pos, typename Alg::init_value_t v) {
+	if (*pv != v) {
+	  if (bad_csum) {
+	    *bad_csum = v;
+	  }
+	  bad = offset + pos;
+	  return false;
 	}
-	Alg::fini(&state);
-	return pos;
+	++pv;
+	return true;
+      });
+    return bad;
+  }
+
+private:
+  // Checksum the first `length` bytes of bl chunk by chunk, passing each
+  // chunk's position and value to f, which returns false to stop early.
+  // Whole chunks within a contiguous buffer are hashed straight from memory
+  // in one pass over the buffer; only chunks straddling a buffer boundary
+  // go through the bufferlist iterator and the streaming hash state.
+  template<class Alg, class F>
+  static void calc_chunks(
+    typename Alg::init_value_t init_value,
+    size_t csum_block_size,
+    size_t length,
+    const ceph::buffer::list &bl,
+    F&& f) {
+    ceph::buffer::list::const_iterator p = bl.begin();
+    typename Alg::state_t state{};
+    bool have_state = false;
+    size_t pos = 0;
+    bool more = true;
+    while (more && pos < length) {
+      ceph::buffer::ptr cur = p.get_current_ptr();
+      size_t run = std::min<size_t>(cur.length(), length - pos);
+      run -= run % csum_block_size;
+      if (run) {
+	const char *data = cur.c_str();
+	for (size_t i = 0; more && i < run; i += csum_block_size) {
+	  more = f(pos + i,
+		   Alg::calc(state, init_value, csum_block_size, data + i));
+	}
+	p += run;
+	pos += run;
+      } else {
+	if (!have_state) {
+	  Alg::init(&state);
+	  have_state = true;
+	}
+	more = f(pos, Alg::calc(state, init_value, csum_block_size, p));
+	pos += csum_block_size;
       }
-      ++pv;
-      pos += csum_block_size;
-      length -= csum_block_size;
     }
-    Alg::fini(&state);
-    return -1;  // no errors
+    if (have_state) {
+      Alg::fini(&state);
+    }
   }
 };
 
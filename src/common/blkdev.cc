@@ -228,6 +228,15 @@ bool BlkDev::is_rotational() const
   return get_int_property("queue/rotational") > 0;
 }
 
+bool BlkDev::is_host_managed_zoned() const
+{
+  // host-aware drives take random writes, only host-managed ones need
+  // zoned writes
+  char buf[32] = {0};
+  return get_string_property("queue/zoned", buf, sizeof(buf)) == 0 &&
+    strcmp(buf, "host-managed") == 0;
+}
+
 int BlkDev::get_numa_node(int *node) const
 {
   int numa = get_int_property("device/device/numa_node");
@@ -786,6 +795,11 @@ bool BlkDev::is_rotational() const
   return false;
 }
 
+bool BlkDev::is_host_managed_zoned() const
+{
+  return false;
+}
+
 int BlkDev::get_numa_node(int *node) const
 {
   return -1;
@@ -927,6 +941,11 @@ bool BlkDev::is_rotational() const
 #endif
 }
 
+bool BlkDev::is_host_managed_zoned() const
+{
+  return false;
+}
+
 int BlkDev::get_numa_node(int *node) const
 {
   int numa = get_int_property("device/device/numa_node");
@@ -1091,6 +1110,11 @@ bool BlkDev::is_rotational(const char *devname) const
   return false;
 }
 
+bool BlkDev::is_host_managed_zoned() const
+{
+  return false;
+}
+
 int BlkDev::model(char *model, size_t max) const
 {
   return -EOPNOTSUPP;
@@ -52,6 +52,7 @@ public:
   bool support_discard() const;
   int get_optimal_io_size() const;
   bool is_rotational() const;
+  bool is_host_managed_zoned() const;
   int get_numa_node(int *node) const;
   int dev(char *dev, size_t max) const;
   int vendor(char *vendor, size_t max) const;
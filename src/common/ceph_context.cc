@@ -295,6 +295,7 @@ public:
       "log_file"s,
       "log_max_new"s,
       "log_max_recent"s,
+      "log_thread_ring_size"s,
       "log_to_file"s,
       "log_to_syslog"s,
       "err_to_syslog"s,
@@ -352,6 +353,10 @@ public:
       log->set_max_recent(conf->log_max_recent);
     }
 
+    if (changed.count("log_thread_ring_size")) {
+      log->set_thread_ring_size(conf->log_thread_ring_size);
+    }
+
     // graylog
     if (changed.count("log_to_graylog") || changed.count("err_to_graylog")) {
       int l = conf->log_to_graylog ? 99 : (conf->err_to_graylog ? -1 : -2);
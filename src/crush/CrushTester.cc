@@ -565,6 +565,21 @@ int CrushTester::test(CephContext* cct)
         // create a vector to hold placement results temporarily 
         vector<int> temporary_per ( per.size() );
 
+        // map the whole batch through crush at once
+        vector<vector<int>> crush_out;
+        if (use_crush) {
+          vector<int> xs;
+          xs.reserve(batch_max - batch_min + 1);
+          for (int x = batch_min; x <= batch_max; x++) {
+            uint32_t real_x = x;
+            if (pool_id != -1) {
+              real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
+            }
+            xs.push_back(real_x);
+          }
+          crush.do_rule_batch(r, xs, crush_out, nr, weight, 0);
+        }
+
         for (int x = batch_min; x <= batch_max; x++) {
           // create a vector to hold the results of a CRUSH placement or RNG simulation
           vector<int> out;
@@ -572,11 +587,7 @@ int CrushTester::test(CephContext* cct)
           if (use_crush) {
             if (output_mappings)
 	      err << "CRUSH"; // prepend CRUSH to placement output
-            uint32_t real_x = x;
-            if (pool_id != -1) {
-              real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
-            }
-            crush.do_rule(r, real_x, out, nr, weight, 0);
+            out.swap(crush_out[x - batch_min]);
           } else {
             if (output_mappings)
 	      err << "RNG"; // prepend RNG to placement output to denote simulation
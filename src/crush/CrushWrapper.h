@@ -1617,6 +1617,29 @@ public:
       out[i] = rawout[i];
   }
 
+  /// do_rule() for each input in xs, with one workspace for all of them
+  template<typename WeightVector>
+  void do_rule_batch(int rule, const std::vector<int>& xs,
+		     std::vector<std::vector<int>>& outs, int maxout,
+		     const WeightVector& weight,
+		     uint64_t choose_args_index) const {
+    std::vector<int> rawout(xs.size() * maxout);
+    std::vector<int> lens(xs.size());
+    std::vector<char> work(crush_work_size(crush, maxout));
+    crush_init_workspace(crush, std::data(work));
+    crush_choose_arg_map arg_map = choose_args_get_with_fallback(
+      choose_args_index);
+    crush_do_rule_batch(crush, rule, std::data(xs), xs.size(),
+			std::data(rawout), maxout, std::data(lens),
+			std::data(weight), std::size(weight),
+			std::data(work), arg_map.args);
+    outs.resize(xs.size());
+    for (size_t i = 0; i < xs.size(); ++i) {
+      auto first = rawout.begin() + i * maxout;
+      outs[i].assign(first, first + std::max(lens[i], 0));
+    }
+  }
+
   int _choose_type_stack(
     CephContext *cct,
     const std::vector<std::pair<int,int>>& stack,
@@ -140,6 +140,75 @@ __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d, __u32 e)
 	}
 }
 
+#if !defined(__KERNEL__) && defined(__SSE2__)
+#include <emmintrin.h>
+
+/* crush_hashmix() on four lanes at once */
+#define crush_hashmix_step_r(x, y, z, s) do {			\
+		x = _mm_sub_epi32(_mm_sub_epi32(x, y), z);	\
+		x = _mm_xor_si128(x, _mm_srli_epi32(z, s));	\
+	} while (0)
+#define crush_hashmix_step_l(x, y, z, s) do {			\
+		x = _mm_sub_epi32(_mm_sub_epi32(x, y), z);	\
+		x = _mm_xor_si128(x, _mm_slli_epi32(z, s));	\
+	} while (0)
+#define crush_hashmix_sse2(a, b, c) do {		\
+		crush_hashmix_step_r(a, b, c, 13);	\
+		crush_hashmix_step_l(b, c, a, 8);	\
+		crush_hashmix_step_r(c, a, b, 13);	\
+		crush_hashmix_step_r(a, b, c, 12);	\
+		crush_hashmix_step_l(b, c, a, 16);	\
+		crush_hashmix_step_r(c, a, b, 5);	\
+		crush_hashmix_step_r(a, b, c, 3);	\
+		crush_hashmix_step_l(b, c, a, 10);	\
+		crush_hashmix_step_r(c, a, b, 15);	\
+	} while (0)
+
+static unsigned int crush_hash32_rjenkins1_3_sse2(__u32 a0, const __s32 *b0,
+						  __u32 c0, __u32 *out,
+						  unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i a = _mm_set1_epi32(a0);
+		__m128i b = _mm_loadu_si128((const __m128i *)(b0 + i));
+		__m128i c = _mm_set1_epi32(c0);
+		__m128i x = _mm_set1_epi32(231232);
+		__m128i y = _mm_set1_epi32(1232);
+		__m128i hash = _mm_xor_si128(
+			_mm_set1_epi32(crush_hash_seed ^ a0 ^ c0), b);
+
+		crush_hashmix_sse2(a, b, hash);
+		crush_hashmix_sse2(c, x, hash);
+		crush_hashmix_sse2(y, a, hash);
+		crush_hashmix_sse2(b, x, hash);
+		crush_hashmix_sse2(y, c, hash);
+		_mm_storeu_si128((__m128i *)(out + i), hash);
+	}
+	return i;
+}
+#endif
+
+void crush_hash32_3_batch(int type, __u32 a, const __s32 *b, __u32 c,
+			  __u32 *out, unsigned int n)
+{
+	unsigned int i = 0;
+
+	switch (type) {
+	case CRUSH_HASH_RJENKINS1:
+#if !defined(__KERNEL__) && defined(__SSE2__)
+		i = crush_hash32_rjenkins1_3_sse2(a, b, c, out, n);
+#endif
+		for (; i < n; i++)
+			out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+		break;
+	default:
+		for (; i < n; i++)
+			out[i] = 0;
+	}
+}
+
 const char *crush_hash_name(int type)
 {
 	switch (type) {
@@ -307,15 +307,14 @@ static inline __s32 *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket
 }
 
 /*
- * Compute exponential random variable using inversion method.
+ * Compute exponential random variable using inversion method, from
+ * u = crush_hash32_3(bucket hash, x, item, r).
  *
  * for reference, see the exponential distribution example at:  
  * https://en.wikipedia.org/wiki/Inverse_transform_sampling#Examples
  */
-static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
-                                                      int weight)
+static inline __s64 crush_straw2_draw(unsigned int u, int weight)
 {
-	unsigned int u = crush_hash32_3(type, x, y, z);
 	u &= 0xffff;
 
 	/*
@@ -339,25 +338,41 @@ static inline __s64 generate_exponential_distribution(int type, int x, int y, in
 	return div64_s64(ln, weight);
 }
 
+/* items hashed per crush_hash32_3_batch() call */
+#define CRUSH_STRAW2_HASH_BATCH 64
+
 static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 				int x, int r, const struct crush_choose_arg *arg,
                                 int position)
 {
-	unsigned int i, high = 0;
+	unsigned int i, j, n, high = 0;
 	__s64 draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         __s32 *ids = get_choose_arg_ids(bucket, arg);
-	for (i = 0; i < bucket->h.size; i++) {
-                dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
-		if (weights[i]) {
-			draw = generate_exponential_distribution(bucket->h.hash, x, ids[i], r, weights[i]);
-		} else {
-			draw = S64_MIN;
-		}
+	__u32 u[CRUSH_STRAW2_HASH_BATCH];
 
-		if (i == 0 || draw > high_draw) {
-			high = i;
-			high_draw = draw;
+	/*
+	 * the hashes of a run of items are independent, compute them
+	 * together and leave only the ln lookup and the division per item
+	 */
+	for (i = 0; i < bucket->h.size; i += n) {
+		n = bucket->h.size - i;
+		if (n > CRUSH_STRAW2_HASH_BATCH)
+			n = CRUSH_STRAW2_HASH_BATCH;
+		crush_hash32_3_batch(bucket->h.hash, x, ids + i, r, u, n);
+		for (j = 0; j < n; j++) {
+			dprintk("weight 0x%x item %d\n", weights[i + j],
+				ids[i + j]);
+			if (weights[i + j]) {
+				draw = crush_straw2_draw(u[j], weights[i + j]);
+			} else {
+				draw = S64_MIN;
+			}
+
+			if (i + j == 0 || draw > high_draw) {
+				high = i + j;
+				high_draw = draw;
+			}
 		}
 	}
 
@@ -2051,3 +2066,35 @@ int crush_do_rule(const struct crush_map *map,
 			choose_args);
 	}
 }
+
+/**
+ * crush_do_rule_batch - crush_do_rule for several inputs
+ * @x: hash inputs, nx of them
+ * @result: nx vectors of result_max items each
+ * @result_len: number of items mapped for each input
+ */
+int crush_do_rule_batch(const struct crush_map *map,
+			int ruleno, const int *x, int nx,
+			int *result, int result_max, int *result_len,
+			const __u32 *weight, int weight_max,
+			void *cwin, const struct crush_choose_arg *choose_args)
+{
+	int i;
+
+	if ((__u32)ruleno >= map->max_rules || !map->rules[ruleno]) {
+		dprintk(" bad ruleno %d\n", ruleno);
+		for (i = 0; i < nx; i++)
+			result_len[i] = 0;
+		return 0;
+	}
+	/*
+	 * the workspace carries over between inputs (uniform buckets
+	 * recompute their permutation when x changes)
+	 */
+	for (i = 0; i < nx; i++)
+		result_len[i] = crush_do_rule(map, ruleno, x[i],
+					      result + i * result_max,
+					      result_max, weight, weight_max,
+					      cwin, choose_args);
+	return nx;
+}
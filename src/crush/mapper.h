@@ -94,6 +94,22 @@ extern int crush_do_rule(const struct crush_map *map,
 			 const __u32 *weights, int weight_max,
 			 void *cwin, const struct crush_choose_arg *choose_args);
 
+/** @ingroup API
+ *
+ * crush_do_rule() for each of the __nx__ inputs in __x__, sharing the
+ * workspace __cwin__. The items for x[i] are stored at
+ * result[i * result_max] and their count in __result_len__[i]. The
+ * mappings are identical to calling crush_do_rule() on each input.
+ *
+ * @return the number of inputs mapped, 0 if __ruleno__ is invalid
+ */
+extern int crush_do_rule_batch(const struct crush_map *map,
+			       int ruleno, const int *x, int nx,
+			       int *result, int result_max, int *result_len,
+			       const __u32 *weights, int weight_max,
+			       void *cwin,
+			       const struct crush_choose_arg *choose_args);
+
 /* Returns enough workspace for any crush rule within map to generate
    result_max outputs. The caller can then allocate this much on its own,
    either on the stack, in a per-thread long-lived buffer, or however it likes.*/
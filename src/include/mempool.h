@@ -156,6 +156,7 @@ namespace mempool {
   f(bluestore_alloc)		      \
   f(bluestore_cache_data)	      \
   f(bluestore_cache_onode)	      \
+  f(bluestore_cache_onode_cold)	      \
   f(bluestore_cache_meta)	      \
   f(bluestore_cache_other)	      \
   f(bluestore_cache_buffer)	      \
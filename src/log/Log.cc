@@ -27,6 +27,8 @@
 
 #include <algorithm>
 #include <iostream>
+#include <optional>
+#include <queue>
 #include <set>
 
 #include <fmt/format.h>
@@ -45,6 +47,75 @@ static OnExitManager exit_callbacks;
 // and should be set once during startup.
 static Log::prefix_hook_t prefix_hook = nullptr;
 
+static std::atomic<uint64_t> next_log_id = {1};
+
+/// where a thread submits entries without taking m_queue_mutex; the
+/// thread produces, the flusher consumes under m_flush_mutex.  Entries
+/// are built in place in preallocated slots, so a submission does not
+/// touch the heap unless the message outgrows ConcreteEntry's buffer.
+struct Log::ThreadRing {
+  explicit ThreadRing(std::size_t n)
+    : size(n), slots(std::make_unique<std::optional<ConcreteEntry>[]>(n)) {}
+
+  /// by the thread
+  bool full() const {
+    return tail.load(std::memory_order_relaxed) -
+      head.load(std::memory_order_acquire) == size;
+  }
+  void push(const Entry& e) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    slots[t % size].emplace(e);
+    tail.store(t + 1, std::memory_order_release);
+  }
+
+  /// by the flusher
+  std::size_t read_available() const {
+    return tail.load(std::memory_order_acquire) -
+      head.load(std::memory_order_relaxed);
+  }
+  ConcreteEntry& front(std::size_t i) {
+    return *slots[(head.load(std::memory_order_relaxed) + i) % size];
+  }
+  void pop(std::size_t n) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < n; ++i) {
+      slots[(h + i) % size].reset();
+    }
+    head.store(h + n, std::memory_order_release);
+  }
+
+  const std::size_t size;
+  std::unique_ptr<std::optional<ConcreteEntry>[]> slots;
+  std::atomic<uint64_t> head = {0};  ///< next slot the flusher takes
+  std::atomic<uint64_t> tail = {0};  ///< next slot the thread fills
+  const pthread_t thread = pthread_self();
+  std::atomic<uint64_t> dropped = {0};
+  uint64_t dropped_reported = 0;  ///< by the flusher
+  std::atomic<bool> exited = {false};
+};
+
+namespace {
+/// the rings the thread submits to, one per Log it logs to, keyed by
+/// Log::m_id; a thread rarely logs to more than one or two Logs
+struct thread_ring_t {
+  std::vector<std::pair<uint64_t, std::shared_ptr<Log::ThreadRing>>> rings;
+  ~thread_ring_t();
+};
+
+thread_local thread_ring_t thread_ring;
+// set once thread_ring is destroyed: a thread_local destructed after it
+// may still log, and then takes the lock
+thread_local bool thread_ring_gone = false;
+
+thread_ring_t::~thread_ring_t()
+{
+  thread_ring_gone = true;
+  for (auto& [id, ring] : rings) {
+    ring->exited.store(true, std::memory_order_release);
+  }
+}
+} // anonymous namespace
+
 static void log_on_exit(void *p)
 {
   Log *l = *(Log **)p;
@@ -61,7 +132,8 @@ void Log::set_prefix_hook(prefix_hook_t hook)
 Log::Log(const SubsystemMap *s)
   : m_indirect_this(nullptr),
     m_subs(s),
-    m_recent(DEFAULT_MAX_RECENT)
+    m_recent(DEFAULT_MAX_RECENT),
+    m_id(next_log_id++)
 {
   m_log_buf.reserve(MAX_LOG_BUF);
   _configure_stderr();
@@ -143,6 +215,11 @@ void Log::set_max_new(std::size_t n)
   m_max_new = n;
 }
 
+void Log::set_thread_ring_size(std::size_t n)
+{
+  m_thread_ring_size = n;
+}
+
 void Log::set_max_recent(std::size_t n)
 {
   std::scoped_lock lock(m_flush_mutex);
@@ -258,8 +335,56 @@ void Log::stop_journald_logger()
   m_journald.reset();
 }
 
+bool Log::_submit_to_ring(Entry& e)
+{
+  std::size_t n = m_thread_ring_size.load(std::memory_order_relaxed);
+  if (!n || thread_ring_gone || !is_started()) {
+    return false;
+  }
+  auto& rings = thread_ring.rings;
+  auto it = std::find_if(rings.begin(), rings.end(),
+                         [this](const auto& p) { return p.first == m_id; });
+  if (it == rings.end() || it->second->size != n) {
+    if (it != rings.end()) {
+      // resized: left for the flusher to drain and forget
+      it->second->exited.store(true, std::memory_order_release);
+    } else {
+      // forget the rings of Logs that are gone; only we still hold them
+      std::erase_if(rings, [](const auto& p) {
+        return p.second.use_count() == 1;
+      });
+      it = rings.emplace(rings.end(), m_id, nullptr);
+    }
+    it->second = std::make_shared<ThreadRing>(n);
+    std::scoped_lock lock(m_queue_mutex);
+    m_rings.push_back(it->second);
+  }
+  ThreadRing& ring = *it->second;
+
+  if (unlikely(m_inject_segv))
+    *(volatile int *)(0) = 0xdead;
+
+  if (ring.full()) {
+    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    m_ring_dropped.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    ring.push(e);
+  }
+  // wake the flusher once per flush, not once per entry
+  if (!m_ring_pending.load(std::memory_order_relaxed) &&
+      !m_ring_pending.exchange(true)) {
+    std::scoped_lock lock(m_queue_mutex);
+    m_cond_flusher.notify_all();
+  }
+  return true;
+}
+
 void Log::submit_entry(Entry&& e)
 {
+  if (_submit_to_ring(e)) {
+    return;
+  }
+
   std::unique_lock lock(m_queue_mutex);
   m_queue_mutex_holder = pthread_self();
 
@@ -282,16 +407,7 @@ void Log::flush()
 {
   std::scoped_lock lock1(m_flush_mutex);
   m_flush_mutex_holder = pthread_self();
-
-  {
-    std::scoped_lock lock2(m_queue_mutex);
-    m_queue_mutex_holder = pthread_self();
-    assert(m_flush.empty());
-    m_flush.swap(m_new);
-    m_cond_loggers.notify_all();
-    m_queue_mutex_holder = 0;
-  }
-
+  _take_new();
   _flush(m_flush, false);
   m_flush_mutex_holder = 0;
 }
@@ -516,19 +632,97 @@ static uint64_t tid_to_int(T tid)
   }
 }
 
-void Log::dump_recent()
+void Log::_take_new()
 {
-  std::scoped_lock lock1(m_flush_mutex);
-  m_flush_mutex_holder = pthread_self();
-
   {
     std::scoped_lock lock2(m_queue_mutex);
     m_queue_mutex_holder = pthread_self();
     assert(m_flush.empty());
     m_flush.swap(m_new);
+    m_cond_loggers.notify_all();
+    if (!m_rings.empty()) {
+      m_ring_pending = false;
+      std::erase_if(m_rings, [](const auto& r) {
+        return r->exited.load(std::memory_order_acquire) &&
+          r->read_available() == 0 &&
+          r->dropped.load(std::memory_order_relaxed) == r->dropped_reported;
+      });
+      m_drain = m_rings;
+    }
     m_queue_mutex_holder = 0;
   }
+  if (m_drain.empty()) {
+    return;
+  }
+
+  // m_new, then each ring, each in submission order
+  // (ring entries are merged in place and only popped afterwards, so
+  // that their slots are not refilled underneath us)
+  std::vector<std::pair<std::size_t, std::size_t>> runs;
+  std::vector<std::size_t> taken;
+  for (auto& e : m_flush) {
+    m_merge.push_back(&e);
+  }
+  const std::size_t owned = m_merge.size();
+  runs.emplace_back(0, owned);
+  for (auto& r : m_drain) {
+    std::size_t begin = m_merge.size();
+    std::size_t n = r->read_available();
+    for (std::size_t i = 0; i < n; ++i) {
+      m_merge.push_back(&r->front(i));
+    }
+    taken.push_back(n);
+    if (n) {
+      runs.emplace_back(begin, m_merge.size());
+    }
+    uint64_t dropped = r->dropped.load(std::memory_order_relaxed);
+    if (dropped != r->dropped_reported) {
+      _log_message(fmt::format("--- {} log entries dropped, ring of thread {:x} full ---",
+                               dropped - r->dropped_reported,
+                               tid_to_int(r->thread)), false);
+      r->dropped_reported = dropped;
+    }
+  }
+
+  if (m_merge.size() > owned) {
+    // merge the runs by timestamp, keeping each in order even if the
+    // clock steps back
+    auto later = [this](const auto& a, const auto& b) {
+      return m_merge[b.first]->m_stamp < m_merge[a.first]->m_stamp;
+    };
+    std::priority_queue<std::pair<std::size_t, std::size_t>,
+                        std::vector<std::pair<std::size_t, std::size_t>>,
+                        decltype(later)> heads(later);
+    for (auto& run : runs) {
+      if (run.first < run.second) {
+        heads.push(run);
+      }
+    }
+    m_merged.reserve(m_merge.size());
+    while (!heads.empty()) {
+      auto run = heads.top();
+      heads.pop();
+      m_merged.emplace_back(std::move(*m_merge[run.first]));
+      if (++run.first < run.second) {
+        heads.push(run);
+      }
+    }
+    m_flush.swap(m_merged);
+    m_merged.clear();
+  }
+  for (std::size_t i = 0; i < m_drain.size(); ++i) {
+    m_drain[i]->pop(taken[i]);
+  }
+  m_drain.clear();
+  m_merge.clear();
+}
+
+void Log::dump_recent()
+{
+  std::scoped_lock lock1(m_flush_mutex);
+  m_flush_mutex_holder = pthread_self();
 
+  _take_new();
   _flush(m_flush, false);
 
   _log_message("--- begin dump of recent events ---", true);
@@ -602,7 +796,7 @@ void *Log::entry()
     std::unique_lock lock(m_queue_mutex);
     m_queue_mutex_holder = pthread_self();
     while (!m_stop) {
-      if (!m_new.empty()) {
+      if (!m_new.empty() || m_ring_pending) {
         m_queue_mutex_holder = 0;
         lock.unlock();
         flush();
@@ -6,6 +6,7 @@
 
 #include <boost/circular_buffer.hpp>
 
+#include <atomic>
 #include <condition_variable>
 #include <map>
 #include <memory>
@@ -44,6 +45,8 @@ public:
 
   void set_coarse_timestamps(bool coarse);
   void set_max_new(std::size_t n);
+  /// give each submitting thread a ring of n entries, 0 to take the lock
+  void set_thread_ring_size(std::size_t n);
   void set_max_recent(std::size_t n);
   void set_log_file(std::string_view fn);
   void reopen_log_file();
@@ -72,6 +75,11 @@ public:
 
   void submit_entry(Entry&& e);
 
+  /// entries dropped because a thread's ring was full
+  uint64_t get_ring_dropped() const {
+    return m_ring_dropped;
+  }
+
   void start();
   void stop();
 
@@ -90,6 +98,8 @@ public:
    */
   static void set_prefix_hook(prefix_hook_t hook);
 
+  struct ThreadRing;
+
 protected:
   using EntryVector = std::vector<ConcreteEntry>;
 
@@ -123,6 +133,23 @@ private:
   EntryRing m_recent; ///< recent (less new) entries we've already written at low detail
   EntryVector m_flush; ///< entries to be flushed (here to optimize heap allocations)
 
+  /*
+   * With set_thread_ring_size(), threads submit to a ring of their own
+   * rather than to m_new: there is no lock to serialize them on, but an
+   * entry is dropped when its ring is full.  The flusher drains the rings
+   * and merges them with m_new by timestamp.  Entries submitted around a
+   * flush may still be written out of order with those of other threads.
+   * A ring preallocates its n entries, about 1KiB each.
+   */
+  const uint64_t m_id; ///< tells rings of different Logs apart
+  std::atomic<std::size_t> m_thread_ring_size = 0;
+  std::vector<std::shared_ptr<ThreadRing>> m_rings; // protected by m_queue_mutex
+  std::atomic<bool> m_ring_pending = false; ///< rings were submitted to since the last flush
+  std::atomic<uint64_t> m_ring_dropped = 0;
+  std::vector<std::shared_ptr<ThreadRing>> m_drain; // protected by m_flush_mutex
+  std::vector<ConcreteEntry*> m_merge; // protected by m_flush_mutex
+  EntryVector m_merged; // protected by m_flush_mutex
+
   std::string m_log_file;
   int m_fd = -1;
   uid_t m_uid = 0;
@@ -158,6 +185,8 @@ private:
   void _log_message(std::string_view s, bool crash);
   void _configure_stderr();
   void _log_stderr(std::string_view strv);
+  bool _submit_to_ring(Entry& e);
+  void _take_new();
 
 
 
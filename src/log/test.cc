@@ -14,6 +14,8 @@
 
 #include <limits.h>
 
+#include <thread>
+
 using namespace std;
 using namespace ceph::logging;
 
@@ -465,6 +467,94 @@ TEST(Log, Speed_nogather)
   }
 }
 
+class OrderCheckingLog : public Log {
+public:
+  using Log::Log;
+  std::map<pthread_t, int> last;
+  std::size_t count = 0;
+  bool in_order = true;
+
+protected:
+  void _flush(EntryVector& q, bool crash) override {
+    for (auto& e : q) {
+      int n = std::stoi(std::string(e.strv()));
+      auto [it, first] = last.try_emplace(e.m_thread, n);
+      if (!first) {
+        in_order = in_order && n > it->second;
+        it->second = n;
+      }
+      ++count;
+    }
+    Log::_flush(q, crash);
+  }
+};
+
+TEST(Log, ThreadRings)
+{
+  SubsystemMap subs;
+  subs.set_log_level(1, 20);
+  subs.set_gather_level(1, 20);
+  OrderCheckingLog log(&subs);
+  log.set_thread_ring_size(64);
+  log.start();
+
+  constexpr int threads = 8, entries = 10000;
+  std::vector<std::thread> ts;
+  for (int t = 0; t < threads; ++t) {
+    ts.emplace_back([&log] {
+      for (int i = 0; i < entries; ++i) {
+        MutableEntry e(1, 1);
+        e.get_ostream() << i;
+        log.submit_entry(std::move(e));
+      }
+    });
+  }
+  for (auto& t : ts) {
+    t.join();
+  }
+  log.flush();
+  log.stop();
+
+  ASSERT_TRUE(log.in_order);
+  ASSERT_EQ(uint64_t(threads * entries), log.count + log.get_ring_dropped());
+}
+
+TEST(Log, ThreadRingsTwoLogs)
+{
+  SubsystemMap subs;
+  subs.set_log_level(1, 20);
+  subs.set_gather_level(1, 20);
+  OrderCheckingLog a(&subs), b(&subs);
+  for (auto* log : {&a, &b}) {
+    log->set_thread_ring_size(64);
+    log->start();
+  }
+
+  // each thread alternates between the two Logs, keeping a ring in each
+  constexpr int threads = 4, entries = 10000;
+  std::vector<std::thread> ts;
+  for (int t = 0; t < threads; ++t) {
+    ts.emplace_back([&a, &b] {
+      for (int i = 0; i < entries; ++i) {
+        for (auto* log : {&a, &b}) {
+          MutableEntry e(1, 1);
+          e.get_ostream() << i;
+          log->submit_entry(std::move(e));
+        }
+      }
+    });
+  }
+  for (auto& t : ts) {
+    t.join();
+  }
+  for (auto* log : {&a, &b}) {
+    log->flush();
+    log->stop();
+    ASSERT_TRUE(log->in_order);
+    ASSERT_EQ(uint64_t(threads * entries), log->count + log->get_ring_dropped());
+  }
+}
+
 TEST(Log, GarbleRecovery)
 {
   static const char* test_file="log_for_moment";
@@ -35,7 +35,7 @@
 
 class MOSDOpReply final : public Message {
 private:
-  static constexpr int HEAD_VERSION = 8;
+  static constexpr int HEAD_VERSION = 9;
   static constexpr int COMPAT_VERSION = 2;
 
   object_t oid;
@@ -51,6 +51,9 @@ private:
   int32_t retry_attempt = -1;
   bool do_redirect;
   request_redirect_t redirect;
+  // load of the replying osd when it sent this, 0 if unknown
+  uint32_t load_queue_depth = 0;
+  uint32_t load_latency_us = 0;
 
 public:
   const object_t& get_oid() const { return oid; }
@@ -66,6 +69,14 @@ public:
   
   void set_result(int r) { result = r; }
 
+  /// ops queued on the osd, and its recent client op latency
+  void set_load_hint(uint32_t queue_depth, uint32_t latency_us) {
+    load_queue_depth = queue_depth;
+    load_latency_us = latency_us;
+  }
+  uint32_t get_load_queue_depth() const { return load_queue_depth; }
+  uint32_t get_load_latency_us() const { return load_latency_us; }
+
   void set_reply_versions(eversion_t v, version_t uv) {
     replay_version = v;
     user_version = uv;
@@ -227,6 +238,10 @@ public:
         }
       }
       encode_trace(payload, features);
+      if (header.version == HEAD_VERSION) {
+        encode(load_queue_depth, payload);
+        encode(load_latency_us, payload);
+      }
     }
   }
   void decode_payload() override {
@@ -260,6 +275,8 @@ public:
       if (do_redirect)
 	decode(redirect, p);
       decode_trace(p);
+      decode(load_queue_depth, p);
+      decode(load_latency_us, p);
     } else if (header.version < 2) {
       ceph_osd_reply_head head;
       decode(head, p);
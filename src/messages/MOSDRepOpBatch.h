@@ -0,0 +1,99 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "msg/Message.h"
+
+/*
+ * MOSDRepOpBatch - several MOSDRepOp or MOSDRepOpReply for one peer
+ *
+ * The wrapped messages are encoded whole, as MForward does, and are
+ * dispatched on the receiver one by one, in order, as if each had
+ * arrived on the batch's connection.
+ */
+class MOSDRepOpBatch final : public Message {
+private:
+  static constexpr int HEAD_VERSION = 1;
+  static constexpr int COMPAT_VERSION = 1;
+
+  std::vector<Message*> msgs;
+
+public:
+  MOSDRepOpBatch()
+    : Message{MSG_OSD_REPOP_BATCH, HEAD_VERSION, COMPAT_VERSION} {}
+  /// takes the references of msgs
+  explicit MOSDRepOpBatch(std::vector<Message*>&& m)
+    : Message{MSG_OSD_REPOP_BATCH, HEAD_VERSION, COMPAT_VERSION},
+      msgs(std::move(m)) {
+    // a batch is as urgent as the most urgent op in it
+    for (auto i : msgs) {
+      if (i->get_priority() > get_priority()) {
+        set_priority(i->get_priority());
+      }
+    }
+  }
+
+private:
+  ~MOSDRepOpBatch() final {
+    for (auto i : msgs) {
+      i->put();
+    }
+  }
+
+public:
+  size_t size() const {
+    return msgs.size();
+  }
+  /// hand the wrapped messages, and their references, to the caller
+  std::vector<Message*> claim_messages() {
+    return std::move(msgs);
+  }
+
+  void encode_payload(uint64_t features) override {
+    using ceph::encode;
+    encode((uint32_t)msgs.size(), payload);
+    for (auto i : msgs) {
+      encode_message(i, features, payload);
+    }
+  }
+  void decode_payload() override {
+    using ceph::decode;
+    auto p = payload.cbegin();
+    uint32_t n;
+    decode(n, p);
+    msgs.reserve(n);
+    while (n--) {
+      Message *m = decode_message(nullptr, 0, p);
+      if (!m) {
+        throw ceph::buffer::malformed_input("MOSDRepOpBatch: bad message");
+      }
+      msgs.push_back(m);
+    }
+  }
+
+  std::string_view get_type_name() const override { return "osd_repop_batch"; }
+  void print(std::ostream& out) const override {
+    out << "osd_repop_batch(" << msgs.size() << " ops";
+    if (!msgs.empty()) {
+      out << " " << *msgs.front() << "..";
+    }
+    out << ")";
+  }
+
+private:
+  template<class T, typename... Args>
+  friend boost::intrusive_ptr<T> ceph::make_message(Args&&... args);
+};
@@ -822,6 +822,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
   // walk through incrementals
   MonitorDBStore::TransactionRef t;
   size_t tx_size = 0;
+  mapping_inc.reset();
   while (version > osdmap.epoch) {
     bufferlist inc_bl;
     int err = get_version(osdmap.epoch+1, inc_bl);
@@ -844,6 +845,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     OSDMap::Incremental inc(inc_bl);
     err = osdmap.apply_incremental(inc);
     ceph_assert(err == 0);
+    bool resynced = false;
 
     if (!t)
       t.reset(new MonitorDBStore::Transaction);
@@ -891,6 +893,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
 
 	osdmap = OSDMap();
 	osdmap.decode(orig_full_bl);
+	resynced = true;
 
 	dout(20) << __func__ << " canonical full osdmap:\n";
 	JSONFormatter jf(true);
@@ -925,6 +928,11 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
 	osd_epochs.erase(osd);
       }
     }
+    if (resynced) {
+      mapping_inc.reset();
+    } else {
+      mapping_inc = std::move(inc);
+    }
   }
 
   if (t) {
@@ -1089,8 +1097,18 @@ void OSDMonitor::start_mapping()
   }
   if (!osdmap.get_pools().empty()) {
     auto fin = new C_UpdateCreatingPGs(this, osdmap.get_epoch());
-    mapping_job = mapping.start_update(osdmap, mapper,
-				       g_conf()->mon_osd_mapping_pgs_per_chunk);
+    if (mapping_inc &&
+	g_conf().get_val<bool>("mon_osd_mapping_incremental")) {
+      // only remaps the pgs the incremental touched, if mapping is at
+      // the epoch right before it
+      mapping_job = mapping.start_update(
+	osdmap, *mapping_inc, mapper,
+	g_conf()->mon_osd_mapping_pgs_per_chunk);
+    } else {
+      mapping_job = mapping.start_update(
+	osdmap, mapper,
+	g_conf()->mon_osd_mapping_pgs_per_chunk);
+    }
     dout(10) << __func__ << " started mapping job " << mapping_job.get()
 	     << " at " << fin->start << dendl;
     mapping_job->set_finish_event(fin);
@@ -1098,6 +1116,8 @@ void OSDMonitor::start_mapping()
     dout(10) << __func__ << " no pools, no mapping job" << dendl;
     mapping_job = nullptr;
   }
+  // an incremental only describes the step to the epoch right after it
+  mapping_inc.reset();
 }
 
 void OSDMonitor::update_msgr_features()
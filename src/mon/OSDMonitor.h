@@ -23,6 +23,7 @@
 #define CEPH_OSDMONITOR_H
 
 #include <map>
+#include <optional>
 #include <set>
 #include <utility>
 #include <sstream>
@@ -393,6 +394,8 @@ private:
   ParallelPGMapper mapper;                        ///< for background pg work
   OSDMapMapping mapping;                          ///< pg <-> osd mappings
   std::unique_ptr<ParallelPGMapper::Job> mapping_job;  ///< background mapping job
+  /// the incremental that produced osdmap, if mapping may follow it
+  std::optional<OSDMap::Incremental> mapping_inc;
   void start_mapping();
 
   void update_logger();
@@ -223,6 +223,7 @@
 #include "messages/MOSDPGUpdateLogMissingReply.h"
 
 #include "messages/MOSDPGPCT.h"
+#include "messages/MOSDRepOpBatch.h"
 
 #include "messages/MNVMeofGwBeacon.h"
 #include "messages/MNVMeofGwMap.h"
@@ -557,6 +558,9 @@ Message *decode_message(CephContext *cct,
   case MSG_OSD_PG_PCT:
     m = make_message<MOSDPGPCT>();
     break;
+  case MSG_OSD_REPOP_BATCH:
+    m = make_message<MOSDRepOpBatch>();
+    break;
   case CEPH_MSG_OSD_BACKOFF:
     m = make_message<MOSDBackoff>();
     break;
@@ -143,6 +143,7 @@
 #define MSG_OSD_PG_UPDATE_LOG_MISSING_REPLY  115
 
 #define MSG_OSD_PG_PCT 136
+#define MSG_OSD_REPOP_BATCH 137
 
 #define MSG_OSD_PG_CREATED      116
 #define MSG_OSD_REP_SCRUBMAP    117
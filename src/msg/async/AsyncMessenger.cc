@@ -183,6 +183,14 @@ void Processor::accept()
   opts.nodelay = msgr->cct->_conf->ms_tcp_nodelay;
   opts.rcbuf_size = msgr->cct->_conf->ms_tcp_rcvbuf;
   opts.priority = msgr->get_socket_priority();
+  Worker *w = nullptr;
+  if (!msgr->get_stack()->support_local_listen_table()) {
+    // steer before the socket is set up, so that it is set up (and
+    // counted) for the worker it ends up on
+    opts.steer = [this, &w](int sd) {
+      return w = msgr->get_stack()->steer_accepted(w, sd);
+    };
+  }
 
   for (auto& listen_socket : listen_sockets) {
     ldout(msgr->cct, 10) << __func__ << " listen_fd=" << listen_socket.fd()
@@ -192,7 +200,7 @@ void Processor::accept()
     while (true) {
       entity_addr_t addr;
       ConnectedSocket cli_socket;
-      Worker *w = worker;
+      w = worker;
       if (!msgr->get_stack()->support_local_listen_table())
 	w = msgr->get_stack()->get_worker();
       else
@@ -201,7 +209,6 @@ void Processor::accept()
       if (r == 0) {
 	ldout(msgr->cct, 10) << __func__ << " accepted incoming on sd "
 			     << cli_socket.fd() << dendl;
-
 	msgr->add_accept(
 	  w, std::move(cli_socket),
 	  msgr->get_myaddrs().v[listen_socket.get_addr_slot()],
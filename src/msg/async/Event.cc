@@ -162,6 +162,12 @@ int EventCenter::init(int nevent, unsigned center_id, const std::string &type)
   file_events.resize(nevent);
   this->nevent = nevent;
 
+  if (type != "dpdk") {
+    // dpdk has pollers and never sleeps in its driver
+    busy_poll_max_us = busy_poll_budget_us =
+      cct->_conf->ms_async_busy_poll_us;
+  }
+
   if (!driver->need_wakeup())
     return 0;
 
@@ -449,7 +455,11 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
 
   ldout(cct, 30) << __func__ << " wait second " << tv.tv_sec << " usec " << tv.tv_usec << dendl;
   std::vector<FiredFileEvent> fired_events;
-  numevents = driver->event_wait(fired_events, &tv);
+  if (blocking && busy_poll_max_us && timeout_microseconds > 0) {
+    numevents = busy_poll_wait(fired_events, timeout_microseconds);
+  } else {
+    numevents = driver->event_wait(fired_events, &tv);
+  }
   auto working_start = ceph::mono_clock::now();
   for (int event_id = 0; event_id < numevents; event_id++) {
     int rfired = 0;
@@ -505,6 +515,55 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
   return numevents;
 }
 
+int EventCenter::busy_poll_wait(std::vector<FiredFileEvent> &fired_events,
+                                unsigned timeout_microseconds)
+{
+  // Poll the driver without sleeping for up to the budget, so an event
+  // arriving soon is picked up without the cost of a sleep and wakeup,
+  // then sleep for the rest of the timeout.  A wait the budget covered
+  // doubles it, one that spun out halves it, and a sleep an event ended
+  // within ms_async_busy_poll_us grows it to twice that gap: the budget
+  // follows the gaps between events, and idle workers stop burning CPU.
+  struct timeval tv = {0, 0};
+  auto start = ceph::mono_clock::now();
+  auto until = start + std::chrono::microseconds(
+    std::min(busy_poll_budget_us, timeout_microseconds));
+  int numevents;
+  auto now = start;
+  do {
+    numevents = driver->event_wait(fired_events, &tv);
+    now = ceph::mono_clock::now();
+    if (numevents != 0) {
+      busy_poll_stats.spin_time += now - start;
+      ++busy_poll_stats.hits;
+      busy_poll_budget_us = std::min(busy_poll_max_us, busy_poll_budget_us * 2);
+      return numevents;
+    }
+  } while (now < until);
+  busy_poll_stats.spin_time += now - start;
+  ++busy_poll_stats.misses;
+  busy_poll_budget_us = std::max(1u, busy_poll_budget_us / 2);
+
+  unsigned spun_us = std::chrono::duration_cast<std::chrono::microseconds>(
+    now - start).count();
+  if (spun_us >= timeout_microseconds) {
+    return 0;
+  }
+  unsigned left_us = timeout_microseconds - spun_us;
+  tv.tv_sec = left_us / 1000000;
+  tv.tv_usec = left_us % 1000000;
+  numevents = driver->event_wait(fired_events, &tv);
+  if (numevents > 0) {
+    auto gap_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      ceph::mono_clock::now() - start).count();
+    if (gap_us < busy_poll_max_us) {
+      busy_poll_budget_us = std::max<unsigned>(
+        busy_poll_budget_us, std::min<unsigned>(busy_poll_max_us, gap_us * 2));
+    }
+  }
+  return numevents;
+}
+
 void EventCenter::dispatch_event_external(EventCallbackRef e)
 {
   uint64_t num = 0;
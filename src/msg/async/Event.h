@@ -177,7 +177,25 @@ class EventCenter {
   unsigned center_id;
   AssociatedCenters *global_centers = nullptr;
 
+ public:
+  /// what spinning for events has cost and found, see take_busy_poll_stats()
+  struct busy_poll_stats_t {
+    uint64_t hits = 0;       ///< waits an event ended while spinning
+    uint64_t misses = 0;     ///< waits that spun out and went to sleep
+    ceph::timespan spin_time = ceph::timespan::zero();
+    unsigned budget_us = 0;  ///< the current spin budget
+  };
+
+ private:
+  // spin in the driver for up to busy_poll_budget_us before sleeping in
+  // it; the budget adapts between 1us and ms_async_busy_poll_us
+  unsigned busy_poll_max_us = 0;
+  unsigned busy_poll_budget_us = 0;
+  busy_poll_stats_t busy_poll_stats;
+
   int process_time_events();
+  int busy_poll_wait(std::vector<FiredFileEvent> &fired_events,
+                     unsigned timeout_microseconds);
   FileEvent *_get_file_event(int fd) {
     ceph_assert(fd < nevent);
     return &file_events[fd];
@@ -207,6 +225,17 @@ class EventCenter {
   void delete_time_event(uint64_t id);
   int process_events(unsigned timeout_microseconds, ceph::timespan *working_dur = nullptr);
   void wakeup();
+  /// hand over the busy-poll stats gathered since the last call, false if
+  /// busy polling is off
+  bool take_busy_poll_stats(busy_poll_stats_t *stats) {
+    if (!busy_poll_max_us) {
+      return false;
+    }
+    *stats = busy_poll_stats;
+    stats->budget_us = busy_poll_budget_us;
+    busy_poll_stats = busy_poll_stats_t();
+    return true;
+  }
 
   // Used by external thread
   void dispatch_event_external(EventCallbackRef e);
@@ -20,8 +20,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -30,6 +34,7 @@
 #include "common/errno.h"
 #include "common/strtol.h"
 #include "common/dout.h"
+#include "common/perf_counters.h"
 #include "msg/Messenger.h"
 #include "include/compat.h"
 #include "include/sock_compat.h"
@@ -38,16 +43,105 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define HAVE_MSG_ZEROCOPY
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   ceph::NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
+  PerfCounters *logger;
+
+  /// smallest send to do with MSG_ZEROCOPY, 0 if we don't
+  uint64_t zerocopy_min_bytes = 0;
+#ifdef HAVE_MSG_ZEROCOPY
+  /// bytes handed to the kernel by MSG_ZEROCOPY sendmsg() calls
+  /// [first, first + count), held until it has notified all of them
+  struct zerocopy_pin_t {
+    uint32_t first;
+    uint32_t count;
+    uint32_t remaining;
+    ceph::buffer::list bl;
+  };
+  std::deque<zerocopy_pin_t> zerocopy_pinned;
+  /// the kernel numbers MSG_ZEROCOPY sendmsg() calls from 0 per socket
+  uint32_t zerocopy_next_id = 0;
+
+  void enable_zerocopy(CephContext *cct) {
+    if (!cct->_conf->ms_async_zerocopy) {
+      return;
+    }
+    int one = 1;
+    if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+      int r = -ceph_sock_errno();
+      ldout(cct, 1) << __func__ << " SO_ZEROCOPY on fd " << _fd << ": "
+                    << cpp_strerror(r) << ", sending with copies" << dendl;
+      return;
+    }
+    zerocopy_min_bytes = cct->_conf->ms_async_zerocopy_min_bytes;
+  }
+
+  void zerocopy_done(uint32_t lo, uint32_t hi) {
+    // completions come in order but for rare exceptions, so the pin
+    // each one belongs to is nearly always the first
+    for (uint32_t id = lo; ; ++id) {
+      for (auto& p : zerocopy_pinned) {
+        if (id - p.first < p.count) {
+          --p.remaining;
+          break;
+        }
+      }
+      if (id == hi) {
+        break;
+      }
+    }
+    while (!zerocopy_pinned.empty() &&
+           zerocopy_pinned.front().remaining == 0) {
+      zerocopy_pinned.pop_front();
+    }
+  }
+
+  /// release what the kernel has notified us it is done with
+  void reap_zerocopy() {
+    while (!zerocopy_pinned.empty()) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+      struct msghdr msg = {};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(_fd, &msg, MSG_ERRQUEUE) < 0) {
+        // EAGAIN: nothing more yet
+        break;
+      }
+      for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+            !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+          continue;
+        }
+        auto ee = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+        if (ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+          continue;
+        }
+        if ((ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && logger) {
+          logger->inc(l_msgr_send_zerocopy_copied);
+        }
+        zerocopy_done(ee->ee_info, ee->ee_data);
+      }
+    }
+  }
+#else
+  void enable_zerocopy(CephContext *cct) {}
+  void reap_zerocopy() {}
+#endif
 
  public:
   explicit PosixConnectedSocketImpl(ceph::NetHandler &h, const entity_addr_t &sa,
-				    int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+				    int f, bool connected, Worker *w)
+      : handler(h), _fd(f), sa(sa), connected(connected),
+        logger(w->get_perf_counter()) {
+    enable_zerocopy(w->cct);
+  }
 
   int is_connected() override {
     if (connected)
@@ -65,6 +159,8 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t read(char *buf, size_t len) override {
+    // an error queue notification wakes us up as readable
+    reap_zerocopy();
     #ifdef _WIN32
     ssize_t r = ::recv(_fd, buf, len, 0);
     #else
@@ -77,24 +173,42 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   // return the sent length
   // < 0 means error occurred
+  // *zerocopy_calls counts the sendmsg() calls made with MSG_ZEROCOPY
   #ifndef _WIN32
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+                     bool zerocopy, uint32_t *zerocopy_calls)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+#ifdef HAVE_MSG_ZEROCOPY
+      if (zerocopy) {
+        flags |= MSG_ZEROCOPY;
+      }
+#endif
+      r = ::sendmsg(fd, &msg, flags);
       if (r < 0) {
         int err = ceph_sock_errno();
         if (err == EINTR) {
           continue;
         } else if (err == EAGAIN) {
           break;
+        } else if (err == ENOBUFS && zerocopy) {
+          // out of optmem for notifications, copy the rest of this one
+          zerocopy = false;
+          if (logger) {
+            logger->inc(l_msgr_send_zerocopy_fallbacks);
+          }
+          continue;
         }
         return -err;
       }
 
+      if (zerocopy) {
+        ++*zerocopy_calls;
+      }
       sent += r;
       if (len == sent) break;
 
@@ -115,6 +229,15 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t send(ceph::buffer::list &bl, bool more) override {
+    reap_zerocopy();
+    bool zerocopy = false;
+    if (zerocopy_min_bytes) {
+      zerocopy = bl.length() >= zerocopy_min_bytes;
+      if (!zerocopy && logger) {
+        logger->inc(l_msgr_send_zerocopy_fallbacks);
+      }
+    }
+
     size_t sent_bytes = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = bl.get_num_buffers();
@@ -134,10 +257,26 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      uint32_t zerocopy_calls = 0;
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more,
+                             zerocopy, &zerocopy_calls);
       if (r < 0)
         return r;
 
+#ifdef HAVE_MSG_ZEROCOPY
+      if (zerocopy_calls) {
+        // the kernel may still read these pages, keep them from being
+        // freed and reused until it tells us it is done
+        zerocopy_pin_t pin{zerocopy_next_id, zerocopy_calls, zerocopy_calls};
+        pin.bl.substr_of(bl, sent_bytes, r);
+        zerocopy_pinned.push_back(std::move(pin));
+        zerocopy_next_id += zerocopy_calls;
+        if (logger) {
+          logger->inc(l_msgr_send_zerocopy_bytes, r);
+        }
+      }
+#endif
+
       // "r" is the remaining length
       sent_bytes += r;
       if (static_cast<unsigned>(r) < msglen)
@@ -263,7 +402,10 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  if (opt.steer) {
+    w = opt.steer(sd);
+  }
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true, w));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -332,7 +474,7 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock, this)));
   return 0;
 }
 
@@ -48,6 +48,7 @@ class PosixNetworkStack : public NetworkStack {
 
  public:
   explicit PosixNetworkStack(CephContext *c, bool try_smc);
+  bool support_steer_accepted() const override { return true; }
 
   void spawn_worker(std::function<void ()> &&func) override {
     threads.emplace_back(std::move(func));
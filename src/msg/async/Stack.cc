@@ -19,6 +19,8 @@
 #include "include/compat.h"
 #include "common/Cond.h"
 #include "common/errno.h"
+#include "common/numa.h"
+#include "common/pick_address.h"
 #include "PosixStack.h"
 #ifdef HAVE_RDMA
 #include "rdma/RDMAStack.h"
@@ -38,6 +40,20 @@ std::function<void ()> NetworkStack::add_thread(Worker* w)
 {
   return [this, w]() {
       rename_thread(w->id);
+#ifdef __linux__
+      if (w->cpu >= 0) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(w->cpu, &cpu_set);
+        int r = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
+                                       &cpu_set);
+        if (r) {
+          lderr(cct) << __func__ << " unable to pin worker " << w->id
+                     << " to cpu " << w->cpu << ": " << cpp_strerror(r)
+                     << dendl;
+        }
+      }
+#endif
       const unsigned EventMaxWaitUs = 30000000;
       w->center.set_owner();
       ldout(cct, 10) << __func__ << " starting" << dendl;
@@ -54,6 +70,13 @@ std::function<void ()> NetworkStack::add_thread(Worker* w)
           // TODO do something?
         }
         w->perf_logger->tinc(l_msgr_running_total_time, dur);
+        EventCenter::busy_poll_stats_t bp;
+        if (w->center.take_busy_poll_stats(&bp)) {
+          w->perf_logger->inc(l_msgr_busy_poll_hits, bp.hits);
+          w->perf_logger->inc(l_msgr_busy_poll_misses, bp.misses);
+          w->perf_logger->tinc(l_msgr_busy_poll_spin_time, bp.spin_time);
+          w->perf_logger->set(l_msgr_busy_poll_budget, bp.budget_us);
+        }
       }
       w->reset();
       w->destroy();
@@ -102,10 +125,77 @@ std::shared_ptr<NetworkStack> NetworkStack::create(CephContext *c,
       throw std::system_error(-ret, std::generic_category());
     stack->workers.push_back(w);
   }
+  if (t != "dpdk") {
+    // dpdk places its own threads
+    stack->place_workers(t);
+  }
 
   return stack;
 }
 
+void NetworkStack::place_workers(const std::string &type)
+{
+  size_t cpu_set_size = 0;
+  cpu_set_t cpu_set;
+  const auto& cpus = cct->_conf->ms_async_worker_cpus;
+  const auto& iface = cct->_conf->ms_async_worker_iface;
+  if (!cpus.empty()) {
+    int r = parse_cpu_set_list(cpus.c_str(), &cpu_set_size, &cpu_set);
+    if (r < 0) {
+      lderr(cct) << __func__ << " bad ms_async_worker_cpus '" << cpus
+                 << "': " << cpp_strerror(r) << dendl;
+      return;
+    }
+  } else if (!iface.empty()) {
+    int node = -1;
+    int r = get_iface_numa_node(iface, &node);
+    if (r == 0) {
+      r = get_numa_node_cpu_set(node, &cpu_set_size, &cpu_set);
+    }
+    if (r < 0) {
+      lderr(cct) << __func__ << " unable to find the cpus local to " << iface
+                 << ": " << cpp_strerror(r) << dendl;
+      return;
+    }
+  } else {
+    return;
+  }
+
+  // learn which node each cpu is on, for the workers and for steering
+  for (int node = 0; ; ++node) {
+    size_t node_cpu_set_size;
+    cpu_set_t node_cpu_set;
+    if (get_numa_node_cpu_set(node, &node_cpu_set_size, &node_cpu_set) < 0) {
+      break;
+    }
+    for (int cpu : cpu_set_to_set(node_cpu_set_size, &node_cpu_set)) {
+      if (cpu >= (int)cpu_numa_node.size()) {
+        cpu_numa_node.resize(cpu + 1, -1);
+      }
+      cpu_numa_node[cpu] = node;
+    }
+  }
+
+  // one cpu per worker, so that a cpu the kernel reports for a socket
+  // names a worker
+  auto cpu_list = cpu_set_to_set(cpu_set_size, &cpu_set);
+  if (cpu_list.empty()) {
+    return;
+  }
+  auto cpu = cpu_list.begin();
+  for (Worker *w : workers) {
+    w->cpu = *cpu;
+    if (w->cpu < (int)cpu_numa_node.size()) {
+      w->numa_node = cpu_numa_node[w->cpu];
+    }
+    ldout(cct, 1) << __func__ << " worker " << w->id << " on cpu " << w->cpu
+                  << " numa node " << w->numa_node << dendl;
+    if (++cpu == cpu_list.end()) {
+      cpu = cpu_list.begin();
+    }
+  }
+}
+
 NetworkStack::NetworkStack(CephContext *c)
   : cct(c)
 {}
@@ -157,6 +247,53 @@ Worker* NetworkStack::get_worker()
   return current_best;
 }
 
+Worker* NetworkStack::steer_accepted(Worker *w, int sd)
+{
+#ifdef SO_INCOMING_CPU
+  if (!support_steer_accepted() ||
+      !cct->_conf->ms_async_steer_incoming_cpu ||
+      cpu_numa_node.empty()) {
+    return w;
+  }
+  int cpu = -1;
+  socklen_t len = sizeof(cpu);
+  if (::getsockopt(sd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0 ||
+      cpu < 0) {
+    return w;
+  }
+  int node = cpu < (int)cpu_numa_node.size() ? cpu_numa_node[cpu] : -1;
+
+  // the least loaded worker on that cpu, or else on its node
+  Worker *best = nullptr;
+  bool best_on_cpu = false;
+  pool_spin.lock();
+  for (Worker *worker : workers) {
+    bool on_cpu = worker->cpu == cpu;
+    if (!on_cpu && (node < 0 || worker->numa_node != node)) {
+      continue;
+    }
+    if (!best ||
+        (on_cpu && !best_on_cpu) ||
+        (on_cpu == best_on_cpu &&
+         worker->references.load() < best->references.load())) {
+      best = worker;
+      best_on_cpu = on_cpu;
+    }
+  }
+  pool_spin.unlock();
+  if (!best || best == w) {
+    return w;
+  }
+  ldout(cct, 20) << __func__ << " sd " << sd << " received on cpu " << cpu
+                 << ", worker " << w->id << " -> " << best->id << dendl;
+  ++best->references;
+  --w->references;
+  return best;
+#else
+  return w;
+#endif
+}
+
 void NetworkStack::stop()
 {
   std::lock_guard lk(pool_spin);
@@ -32,6 +32,7 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -56,6 +57,9 @@ struct SocketOptions {
   int rcbuf_size = 0;
   int priority = -1;
   entity_addr_t connect_bind_addr;
+  /// on accept, called with the new socket's fd before it is set up;
+  /// returns the worker to set it up for (see NetworkStack::steer_accepted())
+  std::function<Worker*(int sd)> steer;
 };
 
 /// \cond internal
@@ -225,6 +229,15 @@ enum {
   l_msgr_recv_encrypted_bytes,
   l_msgr_send_encrypted_bytes,
 
+  l_msgr_send_zerocopy_bytes,
+  l_msgr_send_zerocopy_copied,
+  l_msgr_send_zerocopy_fallbacks,
+
+  l_msgr_busy_poll_hits,
+  l_msgr_busy_poll_misses,
+  l_msgr_busy_poll_spin_time,
+  l_msgr_busy_poll_budget,
+
   l_msgr_last,
 };
 
@@ -252,6 +265,8 @@ class Worker {
 
   std::atomic_uint references;
   EventCenter center;
+  int cpu = -1;        ///< the CPU the thread is pinned to, -1 if not pinned
+  int numa_node = -1;  ///< cpu's NUMA node
 
   Worker(const Worker&) = delete;
   Worker& operator=(const Worker&) = delete;
@@ -283,6 +298,15 @@ class Worker {
     plb.add_u64_counter(l_msgr_recv_encrypted_bytes, "msgr_recv_encrypted_bytes", "Network received encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_send_encrypted_bytes, "msgr_send_encrypted_bytes", "Network sent encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
 
+    plb.add_u64_counter(l_msgr_send_zerocopy_bytes, "msgr_send_zerocopy_bytes", "Network bytes sent with MSG_ZEROCOPY", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_zerocopy_copied, "msgr_send_zerocopy_copied", "MSG_ZEROCOPY sends the kernel copied anyway");
+    plb.add_u64_counter(l_msgr_send_zerocopy_fallbacks, "msgr_send_zerocopy_fallbacks", "Sends copied as too small for MSG_ZEROCOPY or refused it");
+
+    plb.add_u64_counter(l_msgr_busy_poll_hits, "msgr_busy_poll_hits", "Waits for events that spinning ended, saving a sleep and wakeup");
+    plb.add_u64_counter(l_msgr_busy_poll_misses, "msgr_busy_poll_misses", "Waits for events that spun out and slept");
+    plb.add_time(l_msgr_busy_poll_spin_time, "msgr_busy_poll_spin_time", "The total time spent spinning for events");
+    plb.add_u64(l_msgr_busy_poll_budget, "msgr_busy_poll_budget", "Current spin budget in microseconds");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
 
@@ -358,6 +382,7 @@ class NetworkStack {
   bool started = false;
 
   std::function<void ()> add_thread(Worker* w);
+  void place_workers(const std::string &type);
 
   virtual Worker* create_worker(CephContext *c, unsigned i) = 0;
   virtual void rename_thread(unsigned id) {
@@ -370,6 +395,8 @@ class NetworkStack {
  protected:
   CephContext *cct;
   std::vector<Worker*> workers;
+  /// NUMA node by CPU, filled if accepted sockets are steered
+  std::vector<int> cpu_numa_node;
 
   explicit NetworkStack(CephContext *c);
  public:
@@ -391,6 +418,9 @@ class NetworkStack {
   // need to let each thread do binding port.
   virtual bool support_local_listen_table() const { return false; }
   virtual bool nonblock_connect_need_writable_event() const { return true; }
+  // whether an accepted socket can be handed to a worker other than the
+  // one it was accepted for; see steer_accepted()
+  virtual bool support_steer_accepted() const { return false; }
 
   void start();
   void stop();
@@ -398,6 +428,10 @@ class NetworkStack {
   Worker *get_worker(unsigned worker_id) {
     return workers[worker_id];
   }
+  /// with ms_async_steer_incoming_cpu, the worker on (or else on the NUMA
+  /// node of) the CPU the kernel received the socket's packets on; moves
+  /// the reference taken on w to it
+  Worker *steer_accepted(Worker *w, int sd);
   void drain();
   unsigned get_num_worker() const {
     return workers.size();
@@ -21,6 +21,16 @@ static constexpr const std::size_t AESGCM_KEY_LEN{16};
 static constexpr const std::size_t AESGCM_IV_LEN{12};
 static constexpr const std::size_t AESGCM_TAG_LEN{16};
 static constexpr const std::size_t AESGCM_BLOCK_LEN{16};
+// plaintext fragments shorter than this are copied into the ciphertext
+// buffer and encrypted in place together with their neighbours.
+//
+// This stays on OpenSSL EVP rather than isa-l_crypto: ISA-L is only
+// built into the ceph_crypto_isal plugin (x86 with NASM/AVX2), whose
+// CryptoAccel interface does one-shot AES-256 for RGW, while a frame
+// here is AES-128-GCM fed segment by segment.  EVP already runs AES-NI
+// or VAES and PCLMULQDQ for it, so the per-call overhead is what
+// gathering saves.
+static constexpr const std::size_t AESGCM_GATHER_LEN{4096};
 
 struct nonce_t {
   ceph_le32 fixed;
@@ -47,6 +57,13 @@ class AES128GCM_OnWireTxHandler : public ceph::crypto::onwire::TxHandler {
   bool new_nonce_format;  // 64-bit counter?
   static_assert(sizeof(nonce) == AESGCM_IV_LEN);
 
+  // gathered plaintext in buffer, not yet encrypted
+  char* pending = nullptr;
+  unsigned pending_len = 0;
+
+  void encrypt(char* out, const char* in, unsigned len);
+  void flush_pending();
+
 public:
   AES128GCM_OnWireTxHandler(CephContext* const cct,
 			    const key_t& key,
@@ -102,6 +119,8 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
 
   ceph_assert(buffer.get_append_buffer_unused_tail_length() == 0);
   buffer.reserve(std::accumulate(first, last, AESGCM_TAG_LEN));
+  pending = nullptr;
+  pending_len = 0;
 
   if (!new_nonce_format) {
     // msgr2.0: 32-bit counter followed by 64-bit fixed field,
@@ -112,6 +131,30 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
   }
 }
 
+void AES128GCM_OnWireTxHandler::encrypt(char* out, const char* in,
+                                        unsigned len)
+{
+  int update_len = 0;
+
+  if(1 != EVP_EncryptUpdate(ectx.get(),
+      reinterpret_cast<unsigned char*>(out),
+      &update_len,
+      reinterpret_cast<const unsigned char*>(in),
+      len)) {
+    throw std::runtime_error("EVP_EncryptUpdate failed");
+  }
+  ceph_assert_always(update_len >= 0);
+  ceph_assert(static_cast<unsigned>(update_len) == len);
+}
+
+void AES128GCM_OnWireTxHandler::flush_pending()
+{
+  if (pending_len) {
+    encrypt(pending, pending, pending_len);
+    pending_len = 0;
+  }
+}
+
 void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
   const ceph::bufferlist& plaintext)
 {
@@ -119,19 +162,23 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
               plaintext.length());
   auto filler = buffer.append_hole(plaintext.length());
 
+  // The ciphertext of a whole frame lands in one buffer.  Small
+  // fragments -- the preamble, message header, front and epilogue
+  // usually -- are copied there and encrypted in place as one run,
+  // even across calls, rather than with an EVP call each.
   for (const auto& plainbuf : plaintext.buffers()) {
-    int update_len = 0;
-
-    if(1 != EVP_EncryptUpdate(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
-	&update_len,
-	reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
-	plainbuf.length())) {
-      throw std::runtime_error("EVP_EncryptUpdate failed");
+    if (plainbuf.length() < AESGCM_GATHER_LEN) {
+      if (!pending_len) {
+        pending = filler.c_str();
+      }
+      ceph_assert(pending + pending_len == filler.c_str());
+      ::memcpy(filler.c_str(), plainbuf.c_str(), plainbuf.length());
+      pending_len += plainbuf.length();
+    } else {
+      flush_pending();
+      encrypt(filler.c_str(), plainbuf.c_str(), plainbuf.length());
     }
-    ceph_assert_always(update_len >= 0);
-    ceph_assert(static_cast<unsigned>(update_len) == plainbuf.length());
-    filler.advance(update_len);
+    filler.advance(plainbuf.length());
   }
 
   ldout(cct, 15) << __func__
@@ -142,6 +189,7 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
 
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
+  flush_pending();
   int final_len = 0;
   ceph_assert(buffer.get_append_buffer_unused_tail_length() ==
               AESGCM_BLOCK_LEN);
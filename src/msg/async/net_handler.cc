@@ -134,6 +134,19 @@ int NetHandler::set_socket_options(int sd, bool nodelay, int size)
     }
   }
 
+#ifdef SO_BUSY_POLL
+  // let the kernel poll the device queue too while a worker spins
+  if (cct->_conf->ms_async_busy_poll_socket &&
+      cct->_conf->ms_async_busy_poll_us) {
+    int usec = cct->_conf->ms_async_busy_poll_us;
+    r = ::setsockopt(sd, SOL_SOCKET, SO_BUSY_POLL, (SOCKOPT_VAL_TYPE)&usec, sizeof(usec));
+    if (r < 0) {
+      r = ceph_sock_errno();
+      ldout(cct, 0) << "couldn't set SO_BUSY_POLL to " << usec << ": " << cpp_strerror(r) << dendl;
+    }
+  }
+#endif
+
   // block ESIGPIPE
 #ifdef CEPH_USE_SO_NOSIGPIPE
   int val = 1;
@@ -705,6 +705,16 @@ public:
     return collection_list(c, start, end, max, ls, next);
   }
 
+  /**
+   * load the metadata of objects that are about to be read
+   *
+   * A hint, e.g. for a backfill scan that will getattr each object it
+   * just listed: stores that cache per-object metadata can load it for
+   * the whole batch at once.  The default does nothing.
+   */
+  virtual void prefetch_object_meta(CollectionHandle &c,
+                                    const std::vector<ghobject_t>& oids) {}
+
   /// OMAP
   /// Get omap contents
   virtual int omap_get(
@@ -77,6 +77,11 @@ BlueStore::SocketHook::SocketHook(BlueStore& store)
       this,
       "clear static fragmentation score, per collection");
     ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore buffer cache stats",
+      this,
+      "print buffer cache hit, miss and eviction history stats, per shard");
+    ceph_assert(r == 0);
     r = admin_socket->register_command(
       "bluestore show sharding ",
       this,
@@ -215,6 +220,18 @@ int BlueStore::SocketHook::call(
     }
     f->close_section();
     return 0;
+  } else if (command == "bluestore buffer cache stats") {
+    f->open_object_section("buffer_cache");
+    f->dump_string("cache_type", store.cct->_conf->bluestore_cache_type);
+    f->open_array_section("shards");
+    for (auto* shard : store.buffer_cache_shards) {
+      f->open_object_section("shard");
+      shard->dump_stats(f);
+      f->close_section();
+    }
+    f->close_section();
+    f->close_section();
+    return 0;
   } else if (command == "bluestore show sharding") {
     int r = 0;
     std::string sharding;
@@ -226,6 +226,7 @@ BlueFS::BlueFS(CephContext* cct)
     alloc(MAX_BDEV),
     alloc_size(MAX_BDEV, 0),
     locked_alloc(MAX_BDEV),
+    log_compactor_thread(this),
     spillover_cleaner_thread(this)
 {
   dirty.pending_release.resize(MAX_BDEV);
@@ -437,6 +438,13 @@ void BlueFS::_init_logger()
                     "Average lock duration while compacting bluefs log",
                     "c_lt",
                     PerfCountersBuilder::PRIO_INTERESTING);
+  b.add_u64(l_bluefs_compaction_runway, "compact_runway",
+	    "Log runway reserved for writers during async log compaction",
+	    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_time_avg   (l_bluefs_log_expand_wait_lat, "log_expand_wait_lat",
+                    "Average time log flush waited for compaction to permit log expansion",
+                    "lewt",
+                    PerfCountersBuilder::PRIO_USEFUL);
   b.add_time_avg   (l_bluefs_fsync_lat, "fsync_lat",
                     "Average bluefs fsync latency",
                     "fs_t",
@@ -556,6 +564,16 @@ int BlueFS::add_block_device(unsigned id, const string& path, bool trim,
     delete b;
     return r;
   }
+  if (b->is_smr()) {
+    // BlueFS rewrites its log and files in place, see
+    // BlueStore::_open_bdev
+    derr << __func__ << " " << path << " is a zoned device (zone size 0x"
+         << std::hex << b->get_zone_size() << std::dec
+         << "), not supported as the " << dev_name << " device" << dendl;
+    b->close();
+    delete b;
+    return -EOPNOTSUPP;
+  }
   if (trim) {
     interval_set<uint64_t> whole_device;
     whole_device.insert(0, b->get_size());
@@ -1220,6 +1238,9 @@ int BlueFS::mount()
            << dendl;
   // update log size
   logger->set(l_bluefs_log_bytes, log.writer->file->fnode.size);
+  if (cct->_conf->bluefs_compact_log_background) {
+    log_compactor_thread.init();
+  }
   return 0;
 
  out:
@@ -1248,6 +1269,8 @@ void BlueFS::umount(bool avoid_compact)
 {
   dout(1) << __func__ << dendl;
 
+  // wait for a background compaction in flight, further ones run inline
+  log_compactor_thread.shutdown();
   sync_metadata(avoid_compact);
   if (cct->_conf->bluefs_check_volume_selector_on_mount) {
     _check_vselector_LNF();
@@ -3477,14 +3500,20 @@ void BlueFS::_compact_log_async_LD_LNF_D() //also locks FW for new_writer
   // We need to sync log, because we are injecting discontinuity, and writer is not prepared for that.
 
   // 1.1 allocate new log extents and store them at fnode_tail
+  // Log can't be extended until compaction is over, so reserve as much
+  // runway as writers consumed during the previous compaction (with some
+  // headroom) to keep them from stalling in _extend_log.
   File *log_file = log.writer->file.get();
 
   old_log_jump_to = log_file->fnode.get_allocated();
+  uint64_t runway = std::max<uint64_t>(cct->_conf->bluefs_max_log_runway,
+                                       log_compact_runway.load());
   bluefs_fnode_t fnode_tail;
   dout(10) << __func__ << " old_log_jump_to 0x" << std::hex << old_log_jump_to
-           << " need 0x" << cct->_conf->bluefs_max_log_runway << std::dec << dendl;
+           << " need 0x" << runway << std::dec << dendl;
+  logger->set(l_bluefs_compaction_runway, runway);
   int r = _allocate(vselector->select_prefer_bdev(log_file->vselector_hint),
-		    cct->_conf->bluefs_max_log_runway,
+		    runway,
                     0,
                     &fnode_tail);
   ceph_assert(r == 0);
@@ -3504,12 +3533,7 @@ void BlueFS::_compact_log_async_LD_LNF_D() //also locks FW for new_writer
   // 1.4 jump to new position should mean next seq
   log.t.op_jump(log.seq_live + 1, old_log_jump_to);
   uint64_t seq_now = log.seq_live;
-  // we need to flush all bdev because we will be streaming all dirty files to log
-  // TODO - think - if _flush_and_sync_log_jump will not add dirty files nor release pending allocations
-  // then flush_bdev() will not be necessary
   tracepoint_async_compact(1);
-  _flush_bdev();
-  tracepoint_async_compact(2);
   _flush_and_sync_log_jump_D(old_log_jump_to);
 
   //
@@ -3550,6 +3574,12 @@ void BlueFS::_compact_log_async_LD_LNF_D() //also locks FW for new_writer
   logger->tinc_with_max(l_bluefs_compaction_lock_lat, mono_clock::now() - t0);
   log.lock.unlock();
 
+  // We need to flush all bdevs because compacted meta refers to data of
+  // all the files captured above. It only has to be stable before the new
+  // log is written out, so do it off the log lock to not block writers.
+  _flush_bdev();
+  tracepoint_async_compact(2);
+
   // 2.2 Allocate the space required for the compacted meta transaction
   uint64_t compacted_meta_need = _estimate_transaction_size(&compacted_meta_t);
   dout(20) << __func__ << " compacted_meta_need " << compacted_meta_need
@@ -3651,6 +3681,15 @@ void BlueFS::_compact_log_async_LD_LNF_D() //also locks FW for new_writer
 
   // we need to acquire log's lock back at this point
   log.lock.lock();
+  // Remember how much log writers appended while compacting, that is
+  // the runway the next compaction should reserve. Cap it so that it
+  // can't trigger compaction on its own.
+  {
+    uint64_t grown = log.writer->get_pos() - old_log_jump_to;
+    log_compact_runway = std::min<uint64_t>(
+      round_up_to(grown * 2, super.block_size),
+      cct->_conf->bluefs_log_compact_min_size);
+  }
   // Reconstruct actual log object from the new one.
   vselector->sub_usage(log_file->vselector_hint, log_file->fnode);
   log_file->fnode.size =
@@ -3705,6 +3744,28 @@ void BlueFS::_compact_log_async_LD_LNF_D() //also locks FW for new_writer
   ceph_assert(old_is_comp);
 }
 
+void *BlueFS::LogCompactorThread::entry()
+{
+  auto cct = bluefs->cct;
+  dout(10) << __func__ << " starting" << dendl;
+  std::unique_lock l(lock);
+  while (!stop) {
+    if (!pending) {
+      cond.wait(l);
+      continue;
+    }
+    pending = false;
+    l.unlock();
+    auto t0 = mono_clock::now();
+    bluefs->_compact_log_async_LD_LNF_D();
+    bluefs->logger->tinc_with_max(l_bluefs_compaction_lat,
+                                  mono_clock::now() - t0);
+    l.lock();
+  }
+  dout(10) << __func__ << " exiting" << dendl;
+  return nullptr;
+}
+
 void BlueFS::_pad_bl(bufferlist& bl, uint64_t pad_size)
 {
   pad_size = std::max(pad_size, uint64_t(super.block_size));
@@ -3779,8 +3840,14 @@ int64_t BlueFS::_maybe_extend_log() {
 void BlueFS::_extend_log(uint64_t amount) {
   ceph_assert(ceph_mutex_is_locked(log.lock));
   std::unique_lock<ceph::mutex> ll(log.lock, std::adopt_lock);
-  while (log_forbidden_to_expand.load() == true) {
-    log_cond.wait(ll);
+  if (log_forbidden_to_expand.load() == true) {
+    // async compaction is in progress and the runway reserved for it
+    // ran out; this stalls the writer until compaction finishes
+    auto t0 = mono_clock::now();
+    while (log_forbidden_to_expand.load() == true) {
+      log_cond.wait(ll);
+    }
+    logger->tinc_with_max(l_bluefs_log_expand_wait_lat, mono_clock::now() - t0);
   }
   ll.release();
   uint64_t allocated_before_extension = log.writer->file->fnode.get_allocated();
@@ -4754,6 +4821,10 @@ void BlueFS::_maybe_compact_log_LNF_NF_LD_D()
 {
   if (!cct->_conf->bluefs_replay_recovery_disable_compact &&
       _should_start_compact_log_L_N()) {
+    if (!cct->_conf->bluefs_compact_log_sync &&
+        log_compactor_thread.kick()) {
+      return;
+    }
     auto t0 = mono_clock::now();
     if (cct->_conf->bluefs_compact_log_sync) {
       _compact_log_sync_LNF_LD();
@@ -77,6 +77,8 @@ enum {
   l_bluefs_write_bytes,
   l_bluefs_compaction_lat,
   l_bluefs_compaction_lock_lat,
+  l_bluefs_compaction_runway,
+  l_bluefs_log_expand_wait_lat,
   l_bluefs_fsync_lat,
   l_bluefs_flush_lat,
   l_bluefs_unlink_lat,
@@ -640,6 +642,8 @@ private:
   std::atomic<bool> log_is_compacting{false};                    ///< signals that bluefs log is already ongoing compaction
   std::atomic<bool> log_forbidden_to_expand{false};              ///< used to signal that async compaction is in state
                                                                  ///  that prohibits expansion of bluefs log
+  std::atomic<uint64_t> log_compact_runway{0};                   ///< log runway to reserve for writers on next
+                                                                 ///  async compaction, learned from the last one
   /*
    * There are up to 3 block devices:
    *
@@ -1011,6 +1015,56 @@ private:
     const std::string& name
   );
 
+  // Runs async log compaction off the fsync path: writers that find the
+  // log due for compaction only kick this thread and carry on.
+  struct LogCompactorThread : public Thread {
+  public:
+    explicit LogCompactorThread(BlueFS* fs)
+      : bluefs(fs) {}
+    void* entry() override;
+    void init() {
+      std::lock_guard l(lock);
+      if (created) {
+        return;
+      }
+      stop = false;
+      pending = false;
+      create("bluefs_compact");
+      created = true;
+    }
+    void shutdown() {
+      {
+        std::lock_guard l(lock);
+        if (!created) {
+          return;
+        }
+        stop = true;
+        cond.notify_all();
+      }
+      join();
+      std::lock_guard l(lock);
+      created = false;
+    }
+    /// request a compaction; false if the thread is not running
+    bool kick() {
+      std::lock_guard l(lock);
+      if (!created || stop) {
+        return false;
+      }
+      pending = true;
+      cond.notify_all();
+      return true;
+    }
+  private:
+    BlueFS* bluefs;
+    ceph::mutex lock = ceph::make_mutex("LogCompactorThread::lock");
+    ceph::condition_variable cond;
+
+    bool stop = false;
+    bool pending = false;
+    bool created = false;
+  } log_compactor_thread;
+
   enum class SpillOverCleanerAction {
     CONTINUE,
     SLEEP,
@@ -50,6 +50,7 @@
 #include "common/PriorityCache.h"
 #include "common/url_escape.h"
 #include "Allocator.h"
+#include "CpuCachedAllocator.h"
 #include "FreelistManager.h"
 #include "BlueFS.h"
 #include "BlueRocksEnv.h"
@@ -84,6 +85,8 @@ using bid_t = decltype(BlueStore::Blob::id);
 // bluestore_cache_onode
 MEMPOOL_DEFINE_OBJECT_FACTORY(BlueStore::Onode, bluestore_onode,
 			      bluestore_cache_onode);
+MEMPOOL_DEFINE_OBJECT_FACTORY(BlueStore::ColdOnode, bluestore_cold_onode,
+			      bluestore_cache_onode_cold);
 
 MEMPOOL_DEFINE_OBJECT_FACTORY(BlueStore::Buffer, bluestore_buffer,
 			      bluestore_cache_buffer);
@@ -1192,6 +1195,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
 	ceph_assert(num);
         --num;
         o->clear_cached();
+        _add_cold(o);
         o->c->onode_space._remove(o->oid);
       }
     }
@@ -1231,6 +1235,54 @@ BlueStore::OnodeCacheShard *BlueStore::OnodeCacheShard::create(
   return c;
 }
 
+void BlueStore::OnodeCacheShard::_add_cold(BlueStore::Onode *o)
+{
+  if (!cold_max || !o->exists || o->flushing_count.load()) {
+    return;
+  }
+  if (o->onode.extent_map_shards.empty() &&
+      o->extent_map.inline_bl.length() == 0) {
+    // inline extents are dirty or were never persisted
+    return;
+  }
+  auto& space = o->c->onode_space;
+  ceph_assert(space.cache == this);
+  space._rm_cold(o->oid);
+
+  bufferlist bl;
+  Onode::encode_raw(o, bl, o->c->store->segment_size != 0);
+  // exact sized copy, the encode buffer is allocated to the bound
+  ceph::buffer::ptr v = ceph::buffer::create(bl.length());
+  bl.begin().copy(bl.length(), v.c_str());
+  v.reassign_to_mempool(mempool::mempool_bluestore_cache_onode_cold);
+
+  ColdOnode *co = new ColdOnode(&space, o->oid, std::move(v));
+  space.cold_map.insert(*co);
+  cold_lru.push_front(*co);
+  cold_bytes += co->get_bytes();
+  dout(20) << __func__ << " " << this << " " << o->oid << " "
+           << co->v.length() << " bytes, cold_bytes=" << cold_bytes << dendl;
+  _trim_cold(cold_max);
+}
+
+void BlueStore::OnodeCacheShard::_rm_cold(BlueStore::ColdOnode *co)
+{
+  dout(20) << __func__ << " " << this << " " << co->oid << dendl;
+  auto& cold_map = co->space->cold_map;
+  cold_map.erase(cold_map.iterator_to(*co));
+  cold_lru.erase(cold_lru.iterator_to(*co));
+  ceph_assert(cold_bytes >= co->get_bytes());
+  cold_bytes -= co->get_bytes();
+  delete co;
+}
+
+void BlueStore::OnodeCacheShard::_trim_cold(uint64_t max_bytes)
+{
+  while (cold_bytes > max_bytes && !cold_lru.empty()) {
+    _rm_cold(&cold_lru.back());
+  }
+}
+
 // LruBufferCacheShard
 struct LruBufferCacheShard : public BlueStore::BufferCacheShard {
   typedef boost::intrusive::list<
@@ -1408,6 +1460,8 @@ public:
         break;
       case BUFFER_WARM_OUT:
         b->cache_private = BUFFER_HOT;
+        ++ghost_hits;
+        logger->inc(l_bluestore_buffer_ghost_hits);
         // move to hot.  fall-thru
       case BUFFER_HOT:
         dout(20) << __func__ << " move to front of hot " << *b << dendl;
@@ -1676,6 +1730,333 @@ public:
 #endif
 };
 
+// ArcBufferCacheShard
+//
+// Adaptive replacement (ARC) in bytes.  Resident buffers live on t1 (seen
+// once) or t2 (seen again); evicted ones are kept as empty ghosts on b1/b2
+// and a ghost hit moves the t1 target toward the list that would have kept
+// the buffer.  Sequential scans are admitted at the cold end of t1 and leave
+// no ghost behind, so scrub or recovery reads can neither flush t2 nor skew
+// the target.
+
+struct ArcBufferCacheShard : public BlueStore::BufferCacheShard {
+  typedef boost::intrusive::list<
+    BlueStore::Buffer,
+    boost::intrusive::member_hook<
+      BlueStore::Buffer,
+      boost::intrusive::list_member_hook<>,
+      &BlueStore::Buffer::lru_item> > list_t;
+  list_t t1;  ///< "T1" buffers referenced once
+  list_t t2;  ///< "T2" buffers referenced more than once
+  list_t b1;  ///< "B1" empty buffers evicted from t1
+  list_t b2;  ///< "B2" empty buffers evicted from t2
+
+  enum {
+    BUFFER_NEW = 0,
+    BUFFER_SCAN,  ///< in t1, admitted by a sequential scan
+    BUFFER_T1,    ///< in t1
+    BUFFER_B1,    ///< in b1
+    BUFFER_T2,    ///< in t2
+    BUFFER_B2,    ///< in b2
+    BUFFER_TYPE_MAX
+  };
+
+  uint64_t list_bytes[BUFFER_TYPE_MAX] = {0}; ///< bytes per type, incl. ghosts
+  uint64_t t1_target = 0;  ///< adaptive target for t1 bytes ("p")
+  uint64_t last_max = 0;   ///< cache size seen by the last trim
+
+public:
+  explicit ArcBufferCacheShard(BlueStore* store) : BufferCacheShard(store) {}
+
+  list_t& _list(uint16_t cache_private) {
+    switch (cache_private) {
+    case BUFFER_SCAN:
+    case BUFFER_T1:
+      return t1;
+    case BUFFER_B1:
+      return b1;
+    case BUFFER_T2:
+      return t2;
+    case BUFFER_B2:
+      return b2;
+    default:
+      ceph_abort_msg("bad cache_private");
+    }
+  }
+
+  void _account(BlueStore::Buffer *b, int64_t delta) {
+    ceph_assert((int64_t)list_bytes[b->cache_private] + delta >= 0);
+    list_bytes[b->cache_private] += delta;
+    if (!b->is_empty()) {
+      ceph_assert((int64_t)buffer_bytes + delta >= 0);
+      buffer_bytes += delta;
+      ceph_assert(*(b->cache_age_bin) + delta >= 0);
+      *(b->cache_age_bin) += delta;
+    }
+  }
+
+  // move a resident buffer to the front of another list
+  void _relink(BlueStore::Buffer *b, uint16_t to) {
+    auto& from = _list(b->cache_private);
+    from.erase(from.iterator_to(*b));
+    ceph_assert(list_bytes[b->cache_private] >= b->length);
+    list_bytes[b->cache_private] -= b->length;
+    b->cache_private = to;
+    list_bytes[to] += b->length;
+    _list(to).push_front(*b);
+  }
+
+  void _ghost_hit(uint16_t ghost, uint32_t length) {
+    ++ghost_hits;
+    logger->inc(l_bluestore_buffer_ghost_hits);
+    // grow the list that would have kept the buffer, faster when its
+    // ghost list is the smaller of the two
+    if (ghost == BUFFER_B1) {
+      uint64_t delta = length * std::max<uint64_t>(
+        1, list_bytes[BUFFER_B2] / std::max<uint64_t>(1, list_bytes[BUFFER_B1]));
+      t1_target = std::min(t1_target + delta, last_max);
+    } else {
+      uint64_t delta = length * std::max<uint64_t>(
+        1, list_bytes[BUFFER_B1] / std::max<uint64_t>(1, list_bytes[BUFFER_B2]));
+      t1_target = t1_target > delta ? t1_target - delta : 0;
+    }
+    dout(20) << __func__ << " ghost " << ghost << " t1_target " << t1_target
+             << dendl;
+  }
+
+  void _add(BlueStore::Buffer *b, int level, BlueStore::Buffer *near) override
+  {
+    dout(20) << __func__ << " level " << level << " near " << near
+             << " on " << *b
+             << " which has cache_private " << b->cache_private << dendl;
+    ceph_assert(b->is_clean() || b->is_empty());
+    if (near) {
+      b->cache_private = near->cache_private;
+    }
+    if (near && !near->is_writing()) {
+      auto& l = _list(b->cache_private);
+      l.insert(l.iterator_to(*near), *b);
+    } else {
+      switch (b->cache_private) {
+      case BUFFER_NEW:
+      case BUFFER_SCAN:
+        if (level > 0) {
+          b->cache_private = BUFFER_T1;
+          t1.push_front(*b);
+        } else {
+          b->cache_private = BUFFER_SCAN;
+          t1.push_back(*b);
+        }
+        break;
+      case BUFFER_T1:
+        if (level > 0) {
+          // second reference
+          b->cache_private = BUFFER_T2;
+          t2.push_front(*b);
+        } else {
+          t1.push_back(*b);
+        }
+        break;
+      case BUFFER_B1:
+      case BUFFER_B2:
+        if (level > 0) {
+          _ghost_hit(b->cache_private, b->length);
+          b->cache_private = BUFFER_T2;
+          t2.push_front(*b);
+        } else {
+          b->cache_private = BUFFER_SCAN;
+          t1.push_back(*b);
+        }
+        break;
+      case BUFFER_T2:
+        if (level > 0) {
+          t2.push_front(*b);
+        } else {
+          t2.push_back(*b);
+        }
+        break;
+      default:
+        ceph_abort_msg("bad cache_private");
+      }
+    }
+    b->cache_age_bin = age_bins.front();
+    _account(b, b->length);
+    num = t1.size() + t2.size();
+  }
+
+  void _rm(BlueStore::Buffer *b) override
+  {
+    dout(20) << __func__ << " " << *b << dendl;
+    _account(b, -(int64_t)b->length);
+    auto& l = _list(b->cache_private);
+    l.erase(l.iterator_to(*b));
+    num = t1.size() + t2.size();
+  }
+
+  void _move(BlueStore::BufferCacheShard *srcc, BlueStore::Buffer *b) override
+  {
+    ArcBufferCacheShard *src = static_cast<ArcBufferCacheShard*>(srcc);
+    src->_rm(b);
+
+    // preserve which list we're on (even if we can't preserve the order!)
+    ceph_assert(b->is_empty() ==
+                (b->cache_private == BUFFER_B1 ||
+                 b->cache_private == BUFFER_B2));
+    _list(b->cache_private).push_back(*b);
+    b->cache_age_bin = age_bins.front();
+    _account(b, b->length);
+    num = t1.size() + t2.size();
+  }
+
+  void _adjust_size(BlueStore::Buffer *b, int64_t delta) override
+  {
+    dout(20) << __func__ << " delta " << delta << " on " << *b << dendl;
+    _account(b, delta);
+  }
+
+  void _touch(BlueStore::Buffer *b) override {
+    switch (b->cache_private) {
+    case BUFFER_SCAN:
+      // first reference outside of a scan
+      _relink(b, BUFFER_T1);
+      break;
+    case BUFFER_T1:
+    case BUFFER_T2:
+      _relink(b, BUFFER_T2);
+      break;
+    default:
+      ceph_abort_msg("touching a buffer that is not resident");
+    }
+    *(b->cache_age_bin) -= b->length;
+    b->cache_age_bin = age_bins.front();
+    *(b->cache_age_bin) += b->length;
+    num = t1.size() + t2.size();
+    _audit("_touch_buffer end");
+  }
+
+  void _evict_ghost(list_t& l) {
+    BlueStore::Buffer *b = &*l.rbegin();
+    ceph_assert(b->is_empty());
+    dout(20) << __func__ << " rm " << *b << dendl;
+    b->space->_rm_buffer(this, b);
+  }
+
+  void _trim_to(uint64_t max) override
+  {
+    if (max != last_max) {
+      if (!last_max) {
+        // start balanced and let ghost hits move the split
+        t1_target = max / 2;
+      }
+      last_max = max;
+    }
+    t1_target = std::min(t1_target, max);
+
+    uint64_t evicted = 0;
+    while (buffer_bytes > max) {
+      if (t1.empty() && t2.empty()) {
+        break;
+      }
+      bool from_t1 = !t1.empty() &&
+        (t2.empty() ||
+         list_bytes[BUFFER_SCAN] > 0 ||
+         list_bytes[BUFFER_SCAN] + list_bytes[BUFFER_T1] > t1_target);
+      list_t& l = from_t1 ? t1 : t2;
+      BlueStore::Buffer *b = &*l.rbegin();
+      ceph_assert(b->is_clean());
+      evicted += b->length;
+      if (b->cache_private == BUFFER_SCAN) {
+        // scans leave no history
+        dout(20) << __func__ << " scan rm " << *b << dendl;
+        b->space->_rm_buffer(this, b);
+        continue;
+      }
+      uint16_t ghost = from_t1 ? BUFFER_B1 : BUFFER_B2;
+      dout(20) << __func__ << " " << *b << " -> ghost " << ghost << dendl;
+      _account(b, -(int64_t)b->length);
+      l.erase(l.iterator_to(*b));
+      b->state = BlueStore::Buffer::STATE_EMPTY;
+      b->data.clear();
+      b->cache_private = ghost;
+      list_bytes[ghost] += b->length;
+      _list(ghost).push_front(*b);
+    }
+    if (evicted > 0) {
+      dout(20) << __func__ << " evicted " << byte_u_t(evicted)
+               << " t1_target " << byte_u_t(t1_target) << dendl;
+    }
+
+    // bound history: t1 + b1 and b1 + b2 each within the cache size
+    while (!b1.empty() &&
+           list_bytes[BUFFER_SCAN] + list_bytes[BUFFER_T1] +
+           list_bytes[BUFFER_B1] > max) {
+      _evict_ghost(b1);
+    }
+    while (list_bytes[BUFFER_B1] + list_bytes[BUFFER_B2] > max) {
+      if (!b2.empty()) {
+        _evict_ghost(b2);
+      } else if (!b1.empty()) {
+        _evict_ghost(b1);
+      } else {
+        break;
+      }
+    }
+    num = t1.size() + t2.size();
+  }
+
+  void add_stats(uint64_t *extents,
+                 uint64_t *blobs,
+                 uint64_t *buffers,
+                 uint64_t *bytes) override {
+    std::lock_guard l(lock);
+    *extents += num_extents;
+    *blobs += num_blobs;
+    *buffers += num;
+    *bytes += buffer_bytes;
+  }
+
+  void _dump_stats(ceph::Formatter *f) override {
+    BufferCacheShard::_dump_stats(f);
+    f->dump_unsigned("t1_target_bytes", t1_target);
+    f->dump_unsigned("t1_bytes",
+                     list_bytes[BUFFER_SCAN] + list_bytes[BUFFER_T1]);
+    f->dump_unsigned("t1_scan_bytes", list_bytes[BUFFER_SCAN]);
+    f->dump_unsigned("t2_bytes", list_bytes[BUFFER_T2]);
+    f->dump_unsigned("b1_bytes", list_bytes[BUFFER_B1]);
+    f->dump_unsigned("b2_bytes", list_bytes[BUFFER_B2]);
+  }
+
+#ifdef DEBUG_CACHE
+  void _audit(const char *when) override
+  {
+    dout(10) << __func__ << " " << when << " start" << dendl;
+    uint64_t bytes[BUFFER_TYPE_MAX] = {0};
+    for (auto* l : {&t1, &t2, &b1, &b2}) {
+      for (auto i = l->begin(); i != l->end(); ++i) {
+        ceph_assert(&_list(i->cache_private) == l);
+        ceph_assert(i->is_empty() == (l == &b1 || l == &b2));
+        bytes[i->cache_private] += i->length;
+      }
+    }
+    for (unsigned i = 0; i < BUFFER_TYPE_MAX; ++i) {
+      if (bytes[i] != list_bytes[i]) {
+        derr << __func__ << " list_bytes[" << i << "] " << list_bytes[i]
+             << " != actual " << bytes[i] << dendl;
+        ceph_assert(bytes[i] == list_bytes[i]);
+      }
+    }
+    uint64_t s = bytes[BUFFER_SCAN] + bytes[BUFFER_T1] + bytes[BUFFER_T2];
+    if (s != buffer_bytes) {
+      derr << __func__ << " buffer_bytes " << buffer_bytes << " actual " << s
+           << dendl;
+      ceph_assert(s == buffer_bytes);
+    }
+    dout(20) << __func__ << " " << when << " buffer_bytes " << buffer_bytes
+             << " ok" << dendl;
+  }
+#endif
+};
+
 // BuferCacheShard
 
 BlueStore::BufferCacheShard *BlueStore::BufferCacheShard::create(
@@ -1688,6 +2069,8 @@ BlueStore::BufferCacheShard *BlueStore::BufferCacheShard::create(
     c = new LruBufferCacheShard(store);
   else if (type == "2q")
     c = new TwoQBufferCacheShard(store);
+  else if (type == "arc")
+    c = new ArcBufferCacheShard(store);
   else
     ceph_abort_msg("unrecognized cache type");
   c->logger = logger;
@@ -1870,6 +2253,7 @@ void BlueStore::BufferSpace::read(
   res_intervals.clear();
   uint32_t want_bytes = length;
   uint32_t end = offset + length;
+  uint64_t hit_bytes = 0;
 
   {
     std::lock_guard l(cache->lock);
@@ -1891,7 +2275,7 @@ void BlueStore::BufferSpace::read(
 	  res_intervals.insert(offset, l);
 	  offset += l;
 	  length -= l;
-	  if (!b->is_writing()) {
+	  if (!b->is_writing() && !(flags & SCAN_READ)) {
 	    cache->_touch(b);
           }
 	  continue;
@@ -1904,7 +2288,7 @@ void BlueStore::BufferSpace::read(
 	  offset += gap;
 	  length -= gap;
         }
-        if (!b->is_writing()) {
+        if (!b->is_writing() && !(flags & SCAN_READ)) {
 	  cache->_touch(b);
         }
         if (b->length > length) {
@@ -1921,10 +2305,12 @@ void BlueStore::BufferSpace::read(
         }
       }
     }
+    hit_bytes = res_intervals.size();
+    ceph_assert(hit_bytes <= want_bytes);
+    cache->hit_bytes += hit_bytes;
+    cache->miss_bytes += want_bytes - hit_bytes;
   }
 
-  uint64_t hit_bytes = res_intervals.size();
-  ceph_assert(hit_bytes <= want_bytes);
   uint64_t miss_bytes = want_bytes - hit_bytes;
   cache->logger->inc(l_bluestore_buffer_hit_bytes, hit_bytes);
   cache->logger->inc(l_bluestore_buffer_miss_bytes, miss_bytes);
@@ -2074,6 +2460,7 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add_onode(const ghobject_t& oid,
     return p.first->second;
   }
   ldout(cache->cct, 20) << __func__ << " " << oid << " " << o << dendl;
+  _rm_cold(oid);
   cache->_add(o.get(), 1);
   cache->_trim_some();
   return o;
@@ -2085,6 +2472,29 @@ void BlueStore::OnodeSpace::_remove(const ghobject_t& oid)
   onode_map.erase(oid);
 }
 
+void BlueStore::OnodeSpace::_rm_cold(const ghobject_t& oid)
+{
+  auto p = cold_map.find(oid);
+  if (p != cold_map.end()) {
+    cache->_rm_cold(&*p);
+  }
+}
+
+bool BlueStore::OnodeSpace::take_cold(const ghobject_t& oid, bufferlist *v)
+{
+  std::lock_guard l(cache->lock);
+  auto p = cold_map.find(oid);
+  if (p == cold_map.end()) {
+    return false;
+  }
+  ldout(cache->cct, 30) << __func__ << " " << oid << " "
+                        << p->v.length() << " bytes" << dendl;
+  v->append(p->v);
+  cache->_rm_cold(&*p);
+  cache->logger->inc(l_bluestore_onode_cold_hits);
+  return true;
+}
+
 BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 {
   ldout(cache->cct, 30) << __func__ << dendl;
@@ -2120,6 +2530,9 @@ void BlueStore::OnodeSpace::clear()
     cache->_rm(p.second.get());
   }
   onode_map.clear();
+  while (!cold_map.empty()) {
+    cache->_rm_cold(&*cold_map.begin());
+  }
 }
 
 bool BlueStore::OnodeSpace::empty()
@@ -2148,6 +2561,7 @@ void BlueStore::OnodeSpace::rename(
     cache->_rm(pn->second.get());
     onode_map.erase(pn);
   }
+  _rm_cold(new_oid);
   OnodeRef o = po->second;
 
   // install a non-existent onode at old location
@@ -4950,6 +5364,43 @@ void BlueStore::Onode::decode_raw(
   }
 }
 
+void BlueStore::Onode::encode_raw(
+  BlueStore::Onode* on,
+  bufferlist& bl,
+  bool use_onode_segmentation,
+  unsigned* onode_part,
+  unsigned* blob_part,
+  unsigned* extent_part)
+{
+  // bound encode
+  size_t bound = 0;
+  uint64_t flag = use_onode_segmentation ? 0 : bluestore_onode_t::FLAG_DEBUG_FORCE_V2;
+  denc(on->onode, bound, flag);
+  on->extent_map.bound_encode_spanning_blobs(bound);
+  if (on->onode.extent_map_shards.empty()) {
+    denc(on->extent_map.inline_bl, bound);
+  }
+
+  // encode
+  auto p = bl.get_contiguous_appender(bound, true);
+  denc(on->onode, p, flag);
+  unsigned onode_end = p.get_logical_offset();
+  on->extent_map.encode_spanning_blobs(p);
+  unsigned blob_end = p.get_logical_offset();
+  if (on->onode.extent_map_shards.empty()) {
+    denc(on->extent_map.inline_bl, p);
+  }
+  if (onode_part) {
+    *onode_part = onode_end;
+  }
+  if (blob_part) {
+    *blob_part = blob_end - onode_end;
+  }
+  if (extent_part) {
+    *extent_part = p.get_logical_offset() - blob_end;
+  }
+}
+
 BlueStore::Onode* BlueStore::Onode::create_decode(
   CollectionRef c,
   const ghobject_t& oid,
@@ -5185,7 +5636,7 @@ void BlueStore::DeferredBatch::_discard(
 {
   generic_dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
 		   << std::dec << dendl;
-  [[maybe_unused]] uint64_t delta;
+  uint64_t delta;
   auto p = iomap.lower_bound(offset);
   if (p != iomap.begin()) {
     --p;
@@ -5217,6 +5668,7 @@ void BlueStore::DeferredBatch::_discard(
       ceph_assert(i->second >= 0);
 #endif
       p->second.bl.swap(head);
+      bytes_overwritten += delta;
     }
     ++p;
   }
@@ -5249,10 +5701,39 @@ void BlueStore::DeferredBatch::_discard(
       i->second -= delta;
     ceph_assert(i->second >= 0);
 #endif
+    bytes_overwritten += delta;
     p = iomap.erase(p);
   }
 }
 
+bool BlueStore::DeferredAggregate::can_merge(const DeferredBatch& b) const
+{
+  for (auto& [off, io] : b.iomap) {
+    auto p = iomap.lower_bound(off);
+    if (p != iomap.end() && p->first < off + io.bl.length()) {
+      return false;
+    }
+    if (p != iomap.begin()) {
+      --p;
+      if (p->first + p->second.bl.length() > off) {
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+void BlueStore::DeferredAggregate::merge(DeferredBatch *b)
+{
+  for (auto& [off, io] : b->iomap) {
+    auto& n = iomap[off];
+    n.seq = io.seq;
+    n.bl.claim_append(io.bl);
+  }
+  b->iomap.clear();
+  batches.push_back(b);
+}
+
 #if defined(DEBUG_DEFERRED)
 void BlueStore::DeferredBatch::_audit(CephContext *cct)
 {
@@ -5413,10 +5894,17 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
 
   bufferlist v;
   int r = -ENOENT;
+  bool cold = false;
   Onode *on;
   if (!is_createop) {
-    r = store->db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
-    ldout(store->cct, 20) << " r " << r << " v.len " << v.length() << dendl;
+    cold = onode_space.take_cold(oid, &v);
+    if (cold) {
+      r = 0;
+      ldout(store->cct, 20) << " cold v.len " << v.length() << dendl;
+    } else {
+      r = store->db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
+      ldout(store->cct, 20) << " r " << r << " v.len " << v.length() << dendl;
+    }
   }
   if (v.length() == 0) {
     ceph_assert(r == -ENOENT);
@@ -5427,7 +5915,12 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   }
 
   // new object, load onode if available
+  auto start = mono_clock::now();
   on = Onode::create_decode(this, oid, key, v, true, store->segment_size != 0);
+  if (cold) {
+    store->logger->tinc(l_bluestore_onode_cold_decode_lat,
+                        mono_clock::now() - start);
+  }
   o.reset(on);
   return onode_space.add_onode(oid, o);
 }
@@ -5452,6 +5945,16 @@ void BlueStore::Collection::split_cache(
   bool is_pg = dest->cid.is_pg(&destpg);
   ceph_assert(is_pg);
 
+  // encoded onodes are not worth rehoming, drop the ones that move
+  auto cp = onode_space.cold_map.begin();
+  while (cp != onode_space.cold_map.end()) {
+    ColdOnode *co = &*cp;
+    ++cp;
+    if (co->oid.match(destbits, destpg.pgid.ps())) {
+      ocache->_rm_cold(co);
+    }
+  }
+
   auto p = onode_space.onode_map.begin();
   while (p != onode_space.onode_map.end()) {
     OnodeRef o = p->second;
@@ -5747,15 +6250,23 @@ void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
                    << " data_used: " << data_used << dendl;
   }
 
+  // the cold tier takes its share of the meta budget in bytes, the
+  // rest is turned into a decoded onode count
+  int64_t cold_alloc = static_cast<int64_t>(
+    store->cache_onode_cold_ratio * meta_alloc);
   uint64_t max_shard_onodes = static_cast<uint64_t>(
-      (meta_alloc / (double) onode_shards) / meta_cache->get_bytes_per_onode());
+      ((meta_alloc - cold_alloc) / (double) onode_shards) /
+      meta_cache->get_bytes_per_onode());
+  uint64_t max_shard_cold = static_cast<uint64_t>(cold_alloc / onode_shards);
   uint64_t max_shard_buffer = static_cast<uint64_t>(data_alloc / buffer_shards);
 
   dout(30) << __func__ << " max_shard_onodes: " << max_shard_onodes
+                 << " max_shard_cold: " << max_shard_cold
                  << " max_shard_buffer: " << max_shard_buffer << dendl;
 
   for (auto i : store->onode_cache_shards) {
     i->set_max(max_shard_onodes);
+    i->set_cold_max(max_shard_cold);
   }
   for (auto i : store->buffer_cache_shards) {
     i->set_max(max_shard_buffer);
@@ -5883,6 +6394,8 @@ std::vector<std::string> BlueStore::get_tracked_keys() const noexcept
     "bluestore_deferred_batch_ops"s,
     "bluestore_deferred_batch_ops_hdd"s,
     "bluestore_deferred_batch_ops_ssd"s,
+    "bluestore_deferred_aggregate"s,
+    "bluestore_deferred_aggregate_max_bytes"s,
     "bluestore_throttle_bytes"s,
     "bluestore_throttle_deferred_bytes"s,
     "bluestore_throttle_cost_per_io_hdd"s,
@@ -5958,7 +6471,9 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
       changed.count("bluestore_max_alloc_size") ||
       changed.count("bluestore_deferred_batch_ops") ||
       changed.count("bluestore_deferred_batch_ops_hdd") ||
-      changed.count("bluestore_deferred_batch_ops_ssd")) {
+      changed.count("bluestore_deferred_batch_ops_ssd") ||
+      changed.count("bluestore_deferred_aggregate") ||
+      changed.count("bluestore_deferred_aggregate_max_bytes")) {
     if (bdev) {
       // only after startup
       _set_alloc_sizes();
@@ -6223,6 +6738,14 @@ int BlueStore::_set_cache_sizes()
     return -EINVAL;
   }
 
+  cache_onode_cold_ratio =
+    cct->_conf.get_val<double>("bluestore_cache_onode_cold_ratio");
+  if (cache_onode_cold_ratio < 0 || cache_onode_cold_ratio > 1.0) {
+    derr << __func__ << " bluestore_cache_onode_cold_ratio ("
+         << cache_onode_cold_ratio << ") must be in range [0,1.0]" << dendl;
+    return -EINVAL;
+  }
+
   cache_data_ratio = (double)1.0 - 
                      (double)cache_meta_ratio - 
                      (double)cache_kv_ratio - 
@@ -6237,6 +6760,7 @@ int BlueStore::_set_cache_sizes()
 	  << " kv " << cache_kv_ratio
 	  << " kv_onode " << cache_kv_onode_ratio
 	  << " data " << cache_data_ratio
+	  << " onode_cold " << cache_onode_cold_ratio
 	  << dendl;
   return 0;
 }
@@ -6515,6 +7039,18 @@ void BlueStore::_init_logger()
 		    NULL,
 		    PerfCountersBuilder::PRIO_DEBUGONLY,
 		    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_deferred_aggregated_batches,
+		    "deferred_aggregated_batches",
+		    "Deferred batches submitted together with other sequencers'");
+  b.add_u64_counter(l_bluestore_deferred_merged_writes,
+		    "deferred_merged_writes",
+		    "Deferred writes merged into an adjacent one before submit");
+  b.add_u64_counter(l_bluestore_deferred_write_bytes_saved,
+		    "deferred_write_bytes_saved",
+		    "Deferred bytes overwritten before reaching the disk",
+		    NULL,
+		    PerfCountersBuilder::PRIO_DEBUGONLY,
+		    unit_t(UNIT_BYTES));
 
   b.add_u64_counter(l_bluestore_write_big_skipped_blobs,
       "write_big_skipped_blobs",
@@ -6565,6 +7101,17 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_onode_misses, "onode_misses",
 		    "Count of onode cache lookup misses",
 		    "o_ms", PerfCountersBuilder::PRIO_USEFUL);
+  b.add_u64(l_bluestore_onode_cold_onodes, "onodes_cold",
+            "Number of encoded onodes in the cold tier of the cache");
+  b.add_u64(l_bluestore_onode_cold_bytes, "onodes_cold_bytes",
+            "Memory used by the cold tier of the onode cache",
+            NULL,
+            PerfCountersBuilder::PRIO_DEBUGONLY,
+            unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_onode_cold_hits, "onode_cold_hits",
+                    "Count of onode cache misses served from the cold tier");
+  b.add_time_avg(l_bluestore_onode_cold_decode_lat, "onode_cold_decode_lat",
+                 "Average time to decode an onode taken from the cold tier");
   b.add_u64_counter(l_bluestore_onode_shard_hits, "onode_shard_hits",
 		    "Count of onode shard cache lookups hits");
   b.add_u64_counter(l_bluestore_onode_shard_misses,
@@ -6597,6 +7144,8 @@ void BlueStore::_init_logger()
 	    NULL,
 	    PerfCountersBuilder::PRIO_DEBUGONLY,
 	    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_buffer_ghost_hits, "buffer_ghost_hits",
+	    "Number of writes or reads hitting recently evicted buffer history");
   //****************************************
 
   // internal stats
@@ -6732,6 +7281,20 @@ void BlueStore::_init_logger()
     "sfl",
     PerfCountersBuilder::PRIO_USEFUL);
 
+  // fsck and allocation recovery progress
+  //****************************************
+  b.add_u64(l_bluestore_fsck_objects, "fsck_objects",
+    "Objects checked by the running (or last) fsck");
+  b.add_u64(l_bluestore_fsck_deep_read_objects, "fsck_deep_read_objects",
+    "Objects whose data was verified by the running (or last) deep fsck");
+  b.add_u64(l_bluestore_fsck_deep_read_bytes, "fsck_deep_read_bytes",
+    "Bytes verified by the running (or last) deep fsck",
+    NULL,
+    PerfCountersBuilder::PRIO_DEBUGONLY,
+    unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_alloc_recovery_onodes, "alloc_recovery_onodes",
+    "Onode keys scanned by the running (or last) allocation recovery");
+
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -7241,6 +7804,9 @@ void BlueStore::_set_alloc_sizes(void)
       deferred_batch_ops = cct->_conf->bluestore_deferred_batch_ops_ssd;
     }
   }
+  deferred_aggregate = cct->_conf.get_val<bool>("bluestore_deferred_aggregate");
+  deferred_aggregate_max_bytes =
+    cct->_conf.get_val<Option::size_t>("bluestore_deferred_aggregate_max_bytes");
 
   dout(10) << __func__ << " min_alloc_size 0x" << std::hex << min_alloc_size
 	   << std::dec << " order " << (int)min_alloc_size_order
@@ -7268,6 +7834,17 @@ int BlueStore::_open_bdev(bool create)
   if (r < 0)
     goto fail;
 
+  if (bdev->is_smr()) {
+    // BlueStore overwrites in place and has no zone cleaner, it can't
+    // keep to a host-managed device's sequential zones.  Zoned support
+    // stops at reporting and emulating zones in the block device layer.
+    derr << __func__ << " " << p << " is a zoned device (zone size 0x"
+         << std::hex << bdev->get_zone_size() << std::dec
+         << "), not supported as the main device" << dendl;
+    r = -EOPNOTSUPP;
+    goto fail_close;
+  }
+
   if (create &&
       cct->_conf.get_val<bool>("bluestore_discard_on_mkfs")) {
     interval_set<uint64_t> whole_device;
@@ -7491,6 +8068,11 @@ int BlueStore::_create_alloc()
 	       << dendl;
     return -EINVAL;
   }
+  uint64_t cpu_cache_size =
+    cct->_conf.get_val<Option::size_t>("bluestore_allocator_cpu_cache_size");
+  if (cpu_cache_size) {
+    alloc = new CpuCachedAllocator(cct, alloc, cpu_cache_size);
+  }
 
   // BlueFS will share the same allocator
   shared_alloc.set(alloc, alloc_size);
@@ -10755,6 +11337,9 @@ void BlueStore::_fsck_check_objects(
   mempool::bluestore_fsck::list<string> expecting_shards;
   if (it) {
     const size_t thread_count = cct->_conf->bluestore_fsck_quick_fix_threads;
+    // object data is verified by a separate, parallel pass if requested
+    const size_t deep_read_threads = depth == FSCK_DEEP ?
+      cct->_conf.get_val<uint64_t>("bluestore_fsck_deep_read_threads") : 0;
     typedef ShallowFSCKThreadPool::FSCKWorkQueue<256> WQ;
     std::unique_ptr<WQ> wq(
       new WQ(
@@ -10828,6 +11413,7 @@ void BlueStore::_fsck_check_objects(
         continue;
       }
 
+      logger->inc(l_bluestore_fsck_objects);
       ghobject_t oid;
       int r = get_key_object(it->key(), &oid);
       if (r < 0) {
@@ -10961,7 +11547,7 @@ void BlueStore::_fsck_check_objects(
             ctx.used_omap_head->insert(o->onode.nid);
           }
         } // if (o->onode.has_omap())
-        if (depth == FSCK_DEEP) {
+        if (depth == FSCK_DEEP && !deep_read_threads) {
           bufferlist bl;
           uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
           uint64_t offset = 0;
@@ -10978,11 +11564,18 @@ void BlueStore::_fsck_check_objects(
                 << dendl;
               break;
             }
+            logger->inc(l_bluestore_fsck_deep_read_bytes, l);
             offset += l;
           } while (offset < o->onode.size);
+          logger->inc(l_bluestore_fsck_deep_read_objects);
         } // deep
       } //if (depth != FSCK_SHALLOW)
     } // for (it->lower_bound(string()); it->valid(); it->next())
+    if (deep_read_threads) {
+      dout(1) << __func__ << " verifying object data with "
+              << deep_read_threads << " threads" << dendl;
+      errors += _fsck_deep_read_mt(deep_read_threads);
+    }
     if (depth == FSCK_SHALLOW && thread_count > 0) {
       wq->finalize(thread_pool, ctx);
       if (processed_myself) {
@@ -11357,6 +11950,9 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
       per_pool_fsck_stats,
       repair ? &repairer : nullptr);
 
+    logger->set(l_bluestore_fsck_objects, 0);
+    logger->set(l_bluestore_fsck_deep_read_objects, 0);
+    logger->set(l_bluestore_fsck_deep_read_bytes, 0);
     _fsck_check_objects(depth, ctx);
   }
 
@@ -12574,8 +13170,9 @@ BlueStore::CollectionRef BlueStore::_get_collection_by_oid(const ghobject_t& oid
 void BlueStore::_queue_reap_collection(CollectionRef& c)
 {
   dout(10) << __func__ << " " << c << " " << c->cid << dendl;
-  // _reap_collections and this in the same thread,
-  // so no need a lock.
+  // _reap_collections and this run in the finalize thread, or in any
+  // of the kv commit lanes.
+  std::lock_guard l(reap_lock);
   removed_collections.push_back(c);
 }
 
@@ -12584,8 +13181,7 @@ void BlueStore::_reap_collections()
 
   list<CollectionRef> removed_colls;
   {
-    // _queue_reap_collection and this in the same thread.
-    // So no need a lock.
+    std::lock_guard l(reap_lock);
     if (!removed_collections.empty())
       removed_colls.swap(removed_collections);
     else
@@ -12615,6 +13211,7 @@ void BlueStore::_reap_collections()
   if (removed_colls.empty()) {
     dout(10) << __func__ << " all reaped" << dendl;
   } else {
+    std::lock_guard l(reap_lock);
     removed_collections.splice(removed_collections.begin(), removed_colls);
   }
 }
@@ -12627,8 +13224,11 @@ void BlueStore::refresh_perf_counters()
   uint64_t num_blobs = 0;
   uint64_t num_buffers = 0;
   uint64_t num_buffer_bytes = 0;
+  uint64_t num_cold_onodes = 0;
+  uint64_t num_cold_bytes = 0;
   for (auto c : onode_cache_shards) {
     c->add_stats(&num_onodes, &num_pinned_onodes);
+    c->add_cold_stats(&num_cold_onodes, &num_cold_bytes);
   }
   for (auto c : buffer_cache_shards) {
     c->add_stats(&num_extents, &num_blobs,
@@ -12636,6 +13236,8 @@ void BlueStore::refresh_perf_counters()
   }
   logger->set(l_bluestore_onodes, num_onodes);
   logger->set(l_bluestore_pinned_onodes, num_pinned_onodes);
+  logger->set(l_bluestore_onode_cold_onodes, num_cold_onodes);
+  logger->set(l_bluestore_onode_cold_bytes, num_cold_bytes);
   logger->set(l_bluestore_extents, num_extents);
   logger->set(l_bluestore_blobs, num_blobs);
   logger->set(l_bluestore_buffers, num_buffers);
@@ -13046,9 +13648,13 @@ int BlueStore::_generate_read_result_bl(
   vector<bufferlist>& compressed_blob_bls,
   blobs2read_t& blobs2read,
   bool buffered,
+  int read_cache_policy,
   bool* csum_error,
   bufferlist& bl)
 {
+  // sequential scans are admitted at low priority so they do not flush
+  // the working set
+  int buffer_level = (read_cache_policy & BufferSpace::SCAN_READ) ? 0 : 1;
  // enumerate and decompress desired blobs
   auto p = compressed_blob_bls.begin();
   blobs2read_t::iterator b2r_it = blobs2read.begin();
@@ -13074,7 +13680,8 @@ int BlueStore::_generate_read_result_bl(
       if (buffered) {
         bufferlist region_buffer;
         region_buffer.substr_of(raw_bl, blob_offset, length);
-        o->bc.did_read(o->c->cache, offset, std::move(region_buffer));
+        o->bc.did_read(o->c->cache, offset, std::move(region_buffer),
+                       buffer_level);
       }
       for (auto& req : r2r) {
         for (auto& r : req.regs) {
@@ -13096,7 +13703,8 @@ int BlueStore::_generate_read_result_bl(
             bufferlist region_buffer;
             region_buffer.substr_of(req.bl, r.front, r.length);
             // need offset before padding
-            o->bc.did_read(o->c->cache, r.logical_offset, std::move(region_buffer));
+            o->bc.did_read(o->c->cache, r.logical_offset,
+                           std::move(region_buffer), buffer_level);
           }
           ready_regions[r.logical_offset].substr_of(req.bl, r.front, r.length);
         }
@@ -13234,6 +13842,11 @@ int BlueStore::_do_read(
     dout(20) << __func__ << " will bypass cache and do direct read" << dendl;
     read_cache_policy = BufferSpace::BYPASS_CLEAN_CACHE;
   }
+  if ((op_flags & CEPH_OSD_OP_FLAG_FADVISE_SEQUENTIAL) &&
+      cct->_conf->bluestore_cache_scan_resistant) {
+    dout(20) << __func__ << " sequential scan, low priority caching" << dendl;
+    read_cache_policy |= BufferSpace::SCAN_READ;
+  }
 
   // build blob-wise list to of stuff read (that isn't cached)
   ready_regions_t ready_regions;
@@ -13301,7 +13914,7 @@ int BlueStore::_do_read(
   r = _generate_read_result_bl(o, offset, length, ready_regions,
                               compressed_blob_bls, blobs2read,
                               buffered && !ioc.skip_cache(),
-                              &csum_error, bl);
+                              read_cache_policy, &csum_error, bl);
   if (csum_error) {
     // Handles spurious read errors caused by a kernel bug.
     // We sometimes get all-zero pages as a result of the read under
@@ -13632,6 +14245,11 @@ int BlueStore::_do_readv(
     dout(20) << __func__ << " defaulting to buffered read" << dendl;
     buffered = true;
   }
+  if ((op_flags & CEPH_OSD_OP_FLAG_FADVISE_SEQUENTIAL) &&
+      cct->_conf->bluestore_cache_scan_resistant) {
+    dout(20) << __func__ << " sequential scan, low priority caching" << dendl;
+    read_cache_policy |= BufferSpace::SCAN_READ;
+  }
   // this method must be idempotent since we may call it several times
   // before we finally read the expected result.
   bl.clear();
@@ -13722,7 +14340,8 @@ int BlueStore::_do_readv(
                                  std::get<0>(raw_results[i]),
                                  std::get<1>(raw_results[i]),
                                  std::get<2>(raw_results[i]),
-                                 buffered, &csum_error, t);
+                                 buffered, read_cache_policy,
+                                 &csum_error, t);
     if (csum_error) {
       // Handles spurious read errors caused by a kernel bug.
       // We sometimes get all-zero pages as a result of the read under
@@ -13939,6 +14558,23 @@ int BlueStore::collection_list_legacy(
   return r;
 }
 
+void BlueStore::prefetch_object_meta(
+  CollectionHandle &c_, const vector<ghobject_t>& oids)
+{
+  Collection *c = static_cast<Collection *>(c_.get());
+  dout(15) << __func__ << " " << c->cid << " " << oids.size() << " objects"
+           << dendl;
+  // one pass under the collection lock; onodes already cached are only
+  // touched, the rest come from the cold tier or the db
+  std::shared_lock l(c->lock);
+  if (!c->exists) {
+    return;
+  }
+  for (auto& oid : oids) {
+    c->get_onode(oid, false);
+  }
+}
+
 int BlueStore::_collection_list(
   Collection *c, const ghobject_t& start, const ghobject_t& end, int max,
   bool legacy, vector<ghobject_t> *ls, ghobject_t *pnext)
@@ -15260,6 +15896,10 @@ void BlueStore::_osr_drain_all()
     std::lock_guard l(kv_finalize_lock);
     kv_finalize_cond.notify_one();
   }
+  for (auto& lane : kv_lanes) {
+    std::lock_guard l(lane->lock);
+    lane->finalize_cond.notify_one();
+  }
   for (auto osr : s) {
     dout(20) << __func__ << " drain " << osr << dendl;
     osr->drain();
@@ -15292,8 +15932,60 @@ void BlueStore::_kv_start()
   dout(10) << __func__ << dendl;
 
   finisher.start();
+  _init_kv_lanes();
   kv_sync_thread.create("bstore_kv_sync");
-  kv_finalize_thread.create("bstore_kv_final");
+  if (kv_lanes.empty()) {
+    kv_finalize_thread.create("bstore_kv_final");
+  } else {
+    for (auto& lane : kv_lanes) {
+      lane->submit_thread.create(
+	("bstore_kv_ln" + stringify(lane->idx)).c_str());
+      lane->finalize_thread.create(
+	("bstore_kv_lf" + stringify(lane->idx)).c_str());
+    }
+  }
+}
+
+void BlueStore::_init_kv_lanes()
+{
+  ceph_assert(kv_lanes.empty());
+  uint64_t num = cct->_conf.get_val<uint64_t>("bluestore_kv_commit_lanes");
+  if (num <= 1) {
+    return;
+  }
+  dout(1) << __func__ << " using " << num << " kv commit lanes" << dendl;
+  for (uint32_t i = 0; i < num; ++i) {
+    auto lane = std::make_unique<KVCommitLane>(this, i);
+    PerfCountersBuilder b(cct, "bluestore-kv-lane-" + stringify(i),
+			  l_bluestore_kv_lane_first, l_bluestore_kv_lane_last);
+    b.add_u64(l_bluestore_kv_lane_submit_queue, "submit_queue",
+	      "Transactions waiting for async submit on this lane");
+    b.add_u64_counter(l_bluestore_kv_lane_submitted, "submitted",
+		      "Transactions submitted to kv by this lane");
+    b.add_time_avg(l_bluestore_kv_lane_submit_lat, "submit_lat",
+		   "Average lane batch submit latency");
+    b.add_u64(l_bluestore_kv_lane_final_queue, "final_queue",
+	      "Transactions and deferred batches pending finalization");
+    b.add_u64_counter(l_bluestore_kv_lane_finalized, "finalized",
+		      "Transactions finalized by this lane");
+    b.add_time_avg(l_bluestore_kv_lane_final_lat, "final_lat",
+		   "Average lane batch finalize latency");
+    b.add_time_avg(l_bluestore_kv_lane_commit_lat, "commit_lat",
+		   "Average commit latency of transactions on this lane");
+    lane->logger = b.create_perf_counters();
+    cct->get_perfcounters_collection()->add(lane->logger);
+    kv_lanes.emplace_back(std::move(lane));
+  }
+}
+
+void BlueStore::_shutdown_kv_lanes()
+{
+  for (auto& lane : kv_lanes) {
+    cct->get_perfcounters_collection()->remove(lane->logger);
+    delete lane->logger;
+    lane->logger = nullptr;
+  }
+  kv_lanes.clear();
 }
 
 void BlueStore::_kv_stop()
@@ -15307,7 +15999,7 @@ void BlueStore::_kv_stop()
     kv_stop = true;
     kv_cond.notify_all();
   }
-  {
+  if (kv_lanes.empty()) {
     std::unique_lock l{kv_finalize_lock};
     while (!kv_finalize_started) {
       kv_finalize_cond.wait(l);
@@ -15316,8 +16008,29 @@ void BlueStore::_kv_stop()
     kv_finalize_cond.notify_all();
   }
   kv_sync_thread.join();
-  kv_finalize_thread.join();
+  if (kv_lanes.empty()) {
+    kv_finalize_thread.join();
+  } else {
+    // the sync thread is gone, nothing more can be queued to the lanes
+    for (auto& lane : kv_lanes) {
+      std::unique_lock l{lane->lock};
+      while (!lane->submit_started) {
+	lane->submit_cond.wait(l);
+      }
+      while (!lane->finalize_started) {
+	lane->finalize_cond.wait(l);
+      }
+      lane->stop = true;
+      lane->submit_cond.notify_all();
+      lane->finalize_cond.notify_all();
+    }
+    for (auto& lane : kv_lanes) {
+      lane->submit_thread.join();
+      lane->finalize_thread.join();
+    }
+  }
   ceph_assert(removed_collections.empty());
+  _shutdown_kv_lanes();
   {
     std::lock_guard l(kv_lock);
     kv_stop = false;
@@ -15467,12 +16180,17 @@ void BlueStore::_kv_sync_thread()
 	dout(10) << __func__ << " new_blobid_max " << new_blobid_max << dendl;
       }
 
+      deque<TransContext*> lane_submitting;
       for (auto txc : kv_committing) {
 	throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_queued_lat);
 	if (txc->get_state() == TransContext::STATE_KV_QUEUED) {
 	  ++kv_submitted;
-	  _txc_apply_kv(txc, false);
-	  --txc->osr->kv_committing_serially;
+	  if (kv_lanes.empty()) {
+	    _txc_apply_kv(txc, false);
+	    --txc->osr->kv_committing_serially;
+	  } else {
+	    lane_submitting.push_back(txc);
+	  }
 	} else {
 	  ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
 	}
@@ -15480,6 +16198,10 @@ void BlueStore::_kv_sync_thread()
 	  --txc->osr->txc_with_unstable_io;
 	}
       }
+      if (!lane_submitting.empty()) {
+	// lanes submit in parallel; all of it must be in before the sync
+	_kv_lanes_submit(lane_submitting);
+      }
 
       // release throttle *before* we commit.  this allows new ops
       // to be prepared and enter pipeline while we are waiting on
@@ -15537,7 +16259,9 @@ void BlueStore::_kv_sync_thread()
       }
 #endif
 
-      {
+      if (!kv_lanes.empty()) {
+	_kv_lanes_queue_finalize(kv_committing, deferred_stable);
+      } else {
 	std::unique_lock m{kv_finalize_lock};
 	if (kv_committing_to_finalize.empty()) {
 	  kv_committing_to_finalize.swap(kv_committing);
@@ -15633,45 +16357,209 @@ void BlueStore::_kv_finalize_thread()
       dout(20) << __func__ << " kv_committed " << kv_committed << dendl;
       dout(20) << __func__ << " deferred_stable " << deferred_stable << dendl;
 
-      auto start = mono_clock::now();
+      _kv_finalize(kv_committed, deferred_stable);
 
-      while (!kv_committed.empty()) {
-	TransContext *txc = kv_committed.front();
-	ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
-	_txc_state_proc(txc);
-	kv_committed.pop_front();
-      }
+      l.lock();
+    }
+  }
+  dout(10) << __func__ << " finish" << dendl;
+  kv_finalize_started = false;
+}
 
-      for (auto b : deferred_stable) {
-	auto p = b->txcs.begin();
-	while (p != b->txcs.end()) {
-	  TransContext *txc = &*p;
-	  p = b->txcs.erase(p); // unlink here because
-	  _txc_state_proc(txc); // this may destroy txc
-	}
-	delete b;
-      }
-      deferred_stable.clear();
+void BlueStore::_kv_finalize(
+  deque<TransContext*>& kv_committed,
+  deque<DeferredBatch*>& deferred_stable)
+{
+  auto start = mono_clock::now();
 
-      if (!deferred_aggressive) {
-	if (deferred_queue_size >= deferred_batch_ops.load() ||
-	    throttle.should_submit_deferred()) {
-	  deferred_try_submit();
-	}
+  while (!kv_committed.empty()) {
+    TransContext *txc = kv_committed.front();
+    ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
+    _txc_state_proc(txc);
+    kv_committed.pop_front();
+  }
+
+  for (auto b : deferred_stable) {
+    auto p = b->txcs.begin();
+    while (p != b->txcs.end()) {
+      TransContext *txc = &*p;
+      p = b->txcs.erase(p); // unlink here because
+      _txc_state_proc(txc); // this may destroy txc
+    }
+    delete b;
+  }
+  deferred_stable.clear();
+
+  if (!deferred_aggressive) {
+    if (deferred_queue_size >= deferred_batch_ops.load() ||
+	throttle.should_submit_deferred()) {
+      deferred_try_submit();
+    }
+  }
+
+  // this is as good a place as any ...
+  _reap_collections();
+  log_latency("kv_final",
+    l_bluestore_kv_final_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age);
+}
+
+void BlueStore::_kv_lanes_submit(deque<TransContext*>& kv_submitting)
+{
+  // split by lane, keeping the per-sequencer submission order
+  vector<deque<TransContext*>> per_lane(kv_lanes.size());
+  for (auto txc : kv_submitting) {
+    per_lane[_get_kv_lane(txc->osr.get())->idx].push_back(txc);
+  }
+  size_t lanes = 0;
+  for (auto& q : per_lane) {
+    lanes += !q.empty();
+  }
+  {
+    std::lock_guard l(kv_lane_submit_lock);
+    ceph_assert(kv_lane_submit_pending == 0);
+    kv_lane_submit_pending = lanes;
+  }
+  for (auto& lane : kv_lanes) {
+    auto& q = per_lane[lane->idx];
+    if (q.empty()) {
+      continue;
+    }
+    lane->logger->inc(l_bluestore_kv_lane_submit_queue, q.size());
+    std::lock_guard l(lane->lock);
+    ceph_assert(lane->submitting.empty());
+    lane->submitting.swap(q);
+    if (!lane->submit_in_progress) {
+      lane->submit_in_progress = true;
+      lane->submit_cond.notify_one();
+    }
+  }
+  std::unique_lock l(kv_lane_submit_lock);
+  kv_lane_submit_cond.wait(l, [this] { return kv_lane_submit_pending == 0; });
+}
+
+void BlueStore::_kv_lanes_queue_finalize(
+  deque<TransContext*>& kv_committed,
+  deque<DeferredBatch*>& deferred_stable)
+{
+  vector<deque<TransContext*>> txcs(kv_lanes.size());
+  vector<deque<DeferredBatch*>> batches(kv_lanes.size());
+  for (auto txc : kv_committed) {
+    txcs[_get_kv_lane(txc->osr.get())->idx].push_back(txc);
+  }
+  for (auto b : deferred_stable) {
+    batches[_get_kv_lane(b->osr)->idx].push_back(b);
+  }
+  kv_committed.clear();
+  deferred_stable.clear();
+  for (auto& lane : kv_lanes) {
+    auto& t = txcs[lane->idx];
+    auto& d = batches[lane->idx];
+    if (t.empty() && d.empty()) {
+      continue;
+    }
+    lane->logger->inc(l_bluestore_kv_lane_final_queue, t.size() + d.size());
+    std::lock_guard l(lane->lock);
+    lane->committed.insert(lane->committed.end(), t.begin(), t.end());
+    lane->deferred_stable.insert(lane->deferred_stable.end(),
+				 d.begin(), d.end());
+    if (!lane->finalize_in_progress) {
+      lane->finalize_in_progress = true;
+      lane->finalize_cond.notify_one();
+    }
+  }
+}
+
+void BlueStore::_kv_lane_submit_thread(KVCommitLane *lane)
+{
+  deque<TransContext*> submitting;
+  dout(10) << __func__ << " lane " << lane->idx << " start" << dendl;
+  std::unique_lock l(lane->lock);
+  ceph_assert(!lane->submit_started);
+  lane->submit_started = true;
+  lane->submit_cond.notify_all();
+  while (true) {
+    if (lane->submitting.empty()) {
+      if (lane->stop)
+	break;
+      dout(20) << __func__ << " lane " << lane->idx << " sleep" << dendl;
+      lane->submit_in_progress = false;
+      lane->submit_cond.wait(l);
+      dout(20) << __func__ << " lane " << lane->idx << " wake" << dendl;
+      continue;
+    }
+    submitting.swap(lane->submitting);
+    l.unlock();
+
+    dout(20) << __func__ << " lane " << lane->idx
+	     << " submitting " << submitting << dendl;
+    auto start = mono_clock::now();
+    for (auto txc : submitting) {
+      _txc_apply_kv(txc, false);
+      --txc->osr->kv_committing_serially;
+    }
+    lane->logger->dec(l_bluestore_kv_lane_submit_queue, submitting.size());
+    lane->logger->inc(l_bluestore_kv_lane_submitted, submitting.size());
+    lane->logger->tinc(l_bluestore_kv_lane_submit_lat,
+		       mono_clock::now() - start);
+    submitting.clear();
+    {
+      std::lock_guard sl(kv_lane_submit_lock);
+      if (--kv_lane_submit_pending == 0) {
+	kv_lane_submit_cond.notify_all();
       }
+    }
+    l.lock();
+  }
+  dout(10) << __func__ << " lane " << lane->idx << " finish" << dendl;
+  lane->submit_started = false;
+}
 
-      // this is as good a place as any ...
-      _reap_collections();
-      log_latency("kv_final",
-	l_bluestore_kv_final_lat,
-	mono_clock::now() - start,
-	cct->_conf->bluestore_log_op_age);
+void BlueStore::_kv_lane_finalize_thread(KVCommitLane *lane)
+{
+  deque<TransContext*> kv_committed;
+  deque<DeferredBatch*> deferred_stable;
+  dout(10) << __func__ << " lane " << lane->idx << " start" << dendl;
+  std::unique_lock l(lane->lock);
+  ceph_assert(!lane->finalize_started);
+  lane->finalize_started = true;
+  lane->finalize_cond.notify_all();
+  while (true) {
+    if (lane->committed.empty() && lane->deferred_stable.empty()) {
+      if (lane->stop)
+	break;
+      dout(20) << __func__ << " lane " << lane->idx << " sleep" << dendl;
+      lane->finalize_in_progress = false;
+      lane->finalize_cond.wait(l);
+      dout(20) << __func__ << " lane " << lane->idx << " wake" << dendl;
+      continue;
+    }
+    kv_committed.swap(lane->committed);
+    deferred_stable.swap(lane->deferred_stable);
+    l.unlock();
 
-      l.lock();
+    dout(20) << __func__ << " lane " << lane->idx
+	     << " kv_committed " << kv_committed << dendl;
+    dout(20) << __func__ << " lane " << lane->idx
+	     << " deferred_stable " << deferred_stable << dendl;
+    auto start = mono_clock::now();
+    size_t queued = kv_committed.size() + deferred_stable.size();
+    size_t finalized = kv_committed.size();
+    for (auto txc : kv_committed) {
+      lane->logger->tinc(l_bluestore_kv_lane_commit_lat, start - txc->start);
     }
+
+    _kv_finalize(kv_committed, deferred_stable);
+
+    lane->logger->dec(l_bluestore_kv_lane_final_queue, queued);
+    lane->logger->inc(l_bluestore_kv_lane_finalized, finalized);
+    lane->logger->tinc(l_bluestore_kv_lane_final_lat,
+		       mono_clock::now() - start);
+    l.lock();
   }
-  dout(10) << __func__ << " finish" << dendl;
-  kv_finalize_started = false;
+  dout(10) << __func__ << " lane " << lane->idx << " finish" << dendl;
+  lane->finalize_started = false;
 }
 
 
@@ -15746,11 +16634,31 @@ void BlueStore::deferred_try_submit()
     }
   }
 
+  // hand all the osrs' deferred batches to the device in one go
+  bool aggregate = deferred_aggregate && osrs.size() > 1;
+  DeferredAggregate *agg = nullptr;
+  bdev->aio_plug();
   for (auto& osr : osrs) {
     osr->deferred_lock.lock();
     if (osr->deferred_pending) {
       if (!osr->deferred_running) {
-	_deferred_submit_unlock(osr.get());
+	if (!aggregate) {
+	  _deferred_submit_unlock(osr.get());
+	  continue;
+	}
+	// merge with the other osrs' batches so the device sees one sorted
+	// stream instead of one small burst per osr
+	DeferredBatch *b = _deferred_start_unlock(osr.get());
+	if (!agg) {
+	  agg = new DeferredAggregate(cct);
+	}
+	if (agg->can_merge(*b)) {
+	  agg->merge(b);
+	} else {
+	  // overlapping osr batches keep their own ios, as before
+	  _deferred_write_iomap(b->iomap, &b->ioc);
+	  bdev->aio_submit(&b->ioc);
+	}
       } else {
 	osr->deferred_lock.unlock();
 	dout(20) << __func__ << "  osr " << osr << " already has running"
@@ -15761,6 +16669,19 @@ void BlueStore::deferred_try_submit()
       dout(20) << __func__ << "  osr " << osr << " has no pending" << dendl;
     }
   }
+  if (agg) {
+    dout(10) << __func__ << " aggregate of " << agg->batches.size()
+	     << " batches, " << agg->iomap.size() << " ios" << dendl;
+    logger->inc(l_bluestore_deferred_aggregated_batches, agg->batches.size());
+    _deferred_write_iomap(agg->iomap, &agg->ioc);
+    if (agg->ioc.has_pending_aios()) {
+      bdev->aio_submit(&agg->ioc);
+    } else {
+      // nothing went to the device, e.g. bluestore_debug_omit_block_device_write
+      _deferred_aggregate_finish(agg);
+    }
+  }
+  bdev->aio_unplug();
 
   {
     std::lock_guard l(deferred_lock);
@@ -15768,7 +16689,7 @@ void BlueStore::deferred_try_submit()
   }
 }
 
-void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
+BlueStore::DeferredBatch *BlueStore::_deferred_start_unlock(OpSequencer *osr)
 {
   dout(10) << __func__ << " osr " << osr
 	   << " " << osr->deferred_pending->iomap.size() << " ios pending "
@@ -15788,11 +16709,32 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
   for (auto& txc : b->txcs) {
     throttle.log_state_latency(txc, logger, l_bluestore_state_deferred_queued_lat);
   }
+  if (b->bytes_overwritten) {
+    logger->inc(l_bluestore_deferred_write_bytes_saved, b->bytes_overwritten);
+  }
+  return b;
+}
+
+void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
+{
+  auto b = _deferred_start_unlock(osr);
+  _deferred_write_iomap(b->iomap, &b->ioc);
+  bdev->aio_submit(&b->ioc);
+}
+
+void BlueStore::_deferred_write_iomap(
+  std::map<uint64_t,DeferredBatch::deferred_io>& iomap,
+  IOContext *ioc)
+{
+  uint64_t max_bytes = deferred_aggregate_max_bytes;
   uint64_t start = 0, pos = 0;
+  size_t ios = iomap.size(), writes = 0;
   bufferlist bl;
-  auto i = b->iomap.begin();
+  auto i = iomap.begin();
   while (true) {
-    if (i == b->iomap.end() || i->first != pos) {
+    if (i == iomap.end() || i->first != pos ||
+	(max_bytes && bl.length() &&
+	 bl.length() + i->second.bl.length() > max_bytes)) {
       if (bl.length()) {
 	dout(20) << __func__ << " write 0x" << std::hex
 		 << start << "~" << bl.length()
@@ -15800,11 +16742,12 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
 	if (!g_conf()->bluestore_debug_omit_block_device_write) {
 	  logger->inc(l_bluestore_submitted_deferred_writes);
 	  logger->inc(l_bluestore_submitted_deferred_write_bytes, bl.length());
-	  int r = bdev->aio_write(start, bl, &b->ioc, false);
+	  int r = bdev->aio_write(start, bl, ioc, false);
 	  ceph_assert(r == 0);
 	}
+	++writes;
       }
-      if (i == b->iomap.end()) {
+      if (i == iomap.end()) {
 	break;
       }
       start = 0;
@@ -15821,8 +16764,9 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
     bl.claim_append(i->second.bl);
     ++i;
   }
-
-  bdev->aio_submit(&b->ioc);
+  if (ios > writes) {
+    logger->inc(l_bluestore_deferred_merged_writes, ios - writes);
+  }
 }
 
 struct C_DeferredTrySubmit : public Context {
@@ -15889,6 +16833,15 @@ void BlueStore::_deferred_aio_finish(OpSequencer *osr)
   }
 }
 
+void BlueStore::_deferred_aggregate_finish(DeferredAggregate *agg)
+{
+  dout(10) << __func__ << " " << agg->batches.size() << " batches" << dendl;
+  for (auto b : agg->batches) {
+    _deferred_aio_finish(b->osr);
+  }
+  delete agg;
+}
+
 int BlueStore::_deferred_replay()
 {
   dout(10) << __func__ << " start" << dendl;
@@ -19671,29 +20624,10 @@ void BlueStore::_record_onode(OnodeRef& o, KeyValueDB::Transaction &txn)
     logger->inc(l_bluestore_onode_reshard);
   }
 
-  // bound encode
-  size_t bound = 0;
-  uint64_t flag = segment_size != 0 ? 0 : bluestore_onode_t::FLAG_DEBUG_FORCE_V2;
-  denc(o->onode, bound, flag);
-  o->extent_map.bound_encode_spanning_blobs(bound);
-  if (o->onode.extent_map_shards.empty()) {
-    denc(o->extent_map.inline_bl, bound);
-  }
-
-  // encode
   bufferlist bl;
   unsigned onode_part, blob_part, extent_part;
-  {
-    auto p = bl.get_contiguous_appender(bound, true);
-    denc(o->onode, p, flag);
-    onode_part = p.get_logical_offset();
-    o->extent_map.encode_spanning_blobs(p);
-    blob_part = p.get_logical_offset() - onode_part;
-    if (o->onode.extent_map_shards.empty()) {
-      denc(o->extent_map.inline_bl, p);
-    }
-    extent_part = p.get_logical_offset() - onode_part - blob_part;
-  }
+  Onode::encode_raw(o.get(), bl, segment_size != 0,
+                    &onode_part, &blob_part, &extent_part);
 
   dout(20) << __func__  << " onode " << o->oid << " is " << bl.length()
 	    << " (" << onode_part << " bytes onode + "
@@ -157,6 +157,9 @@ enum {
   l_bluestore_issued_deferred_write_bytes,
   l_bluestore_submitted_deferred_writes,
   l_bluestore_submitted_deferred_write_bytes,
+  l_bluestore_deferred_aggregated_batches,
+  l_bluestore_deferred_merged_writes,
+  l_bluestore_deferred_write_bytes_saved,
 
   l_bluestore_write_big_skipped_blobs,
   l_bluestore_write_big_skipped_bytes,
@@ -186,6 +189,10 @@ enum {
   l_bluestore_extents,
   l_bluestore_blobs,
   l_bluestore_spanning_blobs,
+  l_bluestore_onode_cold_onodes,
+  l_bluestore_onode_cold_bytes,
+  l_bluestore_onode_cold_hits,
+  l_bluestore_onode_cold_decode_lat,
   //****************************************
 
   // buffer cache stats
@@ -194,6 +201,7 @@ enum {
   l_bluestore_buffer_bytes,
   l_bluestore_buffer_hit_bytes,
   l_bluestore_buffer_miss_bytes,
+  l_bluestore_buffer_ghost_hits,
   //****************************************
 
   // internal stats
@@ -250,9 +258,29 @@ enum {
   l_bluestore_runtime_frag_lat,
   l_bluestore_static_frag_lat,
   //****************************************
+
+  // fsck and allocation recovery progress
+  //****************************************
+  l_bluestore_fsck_objects,
+  l_bluestore_fsck_deep_read_objects,
+  l_bluestore_fsck_deep_read_bytes,
+  l_bluestore_alloc_recovery_onodes,
+  //****************************************
   l_bluestore_last
 };
 
+enum {
+  l_bluestore_kv_lane_first = 732900,
+  l_bluestore_kv_lane_submit_queue,
+  l_bluestore_kv_lane_submitted,
+  l_bluestore_kv_lane_submit_lat,
+  l_bluestore_kv_lane_final_queue,
+  l_bluestore_kv_lane_finalized,
+  l_bluestore_kv_lane_final_lat,
+  l_bluestore_kv_lane_commit_lat,
+  l_bluestore_kv_lane_last
+};
+
 #define META_POOL_ID ((uint64_t)-1ull)
 using bptr_c_it_t = buffer::ptr::const_iterator;
 
@@ -427,6 +455,7 @@ public:
   struct BufferSpace {
     enum {
       BYPASS_CLEAN_CACHE = 0x1,  // bypass clean cache
+      SCAN_READ = 0x2,           // sequential scan: no promotion, low priority admit
     };
 
     struct BufferKey {
@@ -512,13 +541,17 @@ public:
     void _finish_write(BufferCacheShard* cache, TransContext* txc,
                        uint32_t offset, uint32_t length);
     void did_read(BufferCacheShard* cache,
-                  uint32_t offset, ceph::buffer::list&& bl) {
+                  uint32_t offset, ceph::buffer::list&& bl,
+                  int level = 1) {
       std::lock_guard l(cache->lock);
       uint16_t cache_private = _discard(cache, offset, bl.length());
+      if (level == 0) {
+        cache->scan_admit_bytes += bl.length();
+      }
       _add_buffer(
           cache,
           new Buffer(this, Buffer::STATE_CLEAN, 0, offset, std::move(bl), 0),
-          cache_private, 1, nullptr);
+          cache_private, level, nullptr);
       cache->_trim();
     }
 
@@ -1445,6 +1478,15 @@ public:
       ExtentMap::ExtentDecoder& dencoder,
       bool use_onode_segmentation);
 
+    /// encode the value stored under PREFIX_OBJ; extent map must be clean
+    static void encode_raw(
+      BlueStore::Onode* on,
+      bufferlist& bl,
+      bool use_onode_segmentation,
+      unsigned* onode_part = nullptr,
+      unsigned* blob_part = nullptr,
+      unsigned* extent_part = nullptr);
+
     static Onode* create_decode(
       CollectionRef c,
       const ghobject_t& oid,
@@ -1516,6 +1558,32 @@ public:
     }
   };
 
+  /// an onode evicted from the cache, kept in its encoded form
+  struct ColdOnode {
+    MEMPOOL_CLASS_HELPERS();
+
+    OnodeSpace *space;
+    ghobject_t oid;
+    ceph::buffer::ptr v;  ///< value as stored under PREFIX_OBJ
+
+    boost::intrusive::list_member_hook<> lru_item;
+    boost::intrusive::set_member_hook<> set_item;
+
+    ColdOnode(OnodeSpace *space, const ghobject_t& oid, ceph::buffer::ptr&& v)
+      : space(space), oid(oid), v(std::move(v)) {}
+
+    size_t get_bytes() const {
+      return sizeof(*this) + v.length();
+    }
+
+    struct Key {
+      using type = ghobject_t;
+      const type& operator() (const ColdOnode& co) {
+        return co.oid;
+      }
+    };
+  };
+
   /// A generic Cache Shard
   struct CacheShard {
     CephContext *cct;
@@ -1610,8 +1678,23 @@ public:
   struct OnodeCacheShard : public CacheShard {
     std::array<std::pair<ghobject_t, ceph::mono_clock::time_point>, 64> dumped_onodes;
 
+    /// cold tier: onodes trimmed from the cache are kept encoded, in
+    /// lru order, up to cold_max bytes and decoded again on lookup
+    typedef boost::intrusive::list<
+      ColdOnode,
+      boost::intrusive::member_hook<
+        ColdOnode,
+        boost::intrusive::list_member_hook<>,
+        &ColdOnode::lru_item> > cold_list_t;
+    cold_list_t cold_lru;
+    uint64_t cold_bytes = 0;
+    std::atomic<uint64_t> cold_max = {0};
+
   public:
     OnodeCacheShard(CephContext* cct) : CacheShard(cct) {}
+    virtual ~OnodeCacheShard() {
+      ceph_assert(cold_lru.empty());
+    }
     static OnodeCacheShard *create(CephContext* cct, std::string type,
                                    PerfCounters *logger);
 
@@ -1626,6 +1709,21 @@ public:
     bool empty() {
       return _get_num() == 0;
     }
+
+    void set_cold_max(uint64_t max_) {
+      cold_max = max_;
+      std::lock_guard l(lock);
+      _trim_cold(max_);
+    }
+    /// keep the encoded form of an onode that is being trimmed
+    void _add_cold(Onode *o);
+    void _rm_cold(ColdOnode *co);
+    void _trim_cold(uint64_t max_bytes);
+    void add_cold_stats(uint64_t *onodes, uint64_t *bytes) {
+      std::lock_guard l(lock);
+      *onodes += cold_lru.size();
+      *bytes += cold_bytes;
+    }
   };
 
   /// A Generic buffer Cache Shard
@@ -1633,6 +1731,12 @@ public:
     std::atomic<uint64_t> num_extents = {0};
     std::atomic<uint64_t> num_blobs = {0};
     uint64_t buffer_bytes = 0;
+
+    // per-shard accounting, protected by lock
+    uint64_t hit_bytes = 0;
+    uint64_t miss_bytes = 0;
+    uint64_t ghost_hits = 0;       ///< re-reference of an evicted (empty) buffer
+    uint64_t scan_admit_bytes = 0; ///< bytes admitted at low priority
   public:
     BufferCacheShard(BlueStore* store)
       : CacheShard(store->cct) {
@@ -1672,6 +1776,20 @@ public:
                            uint64_t *buffers,
                            uint64_t *bytes) = 0;
 
+    void dump_stats(ceph::Formatter *f) {
+      std::lock_guard l(lock);
+      _dump_stats(f);
+    }
+    virtual void _dump_stats(ceph::Formatter *f) {
+      f->dump_unsigned("max_bytes", max);
+      f->dump_unsigned("buffers", num);
+      f->dump_unsigned("buffer_bytes", buffer_bytes);
+      f->dump_unsigned("hit_bytes", hit_bytes);
+      f->dump_unsigned("miss_bytes", miss_bytes);
+      f->dump_unsigned("ghost_hits", ghost_hits);
+      f->dump_unsigned("scan_admit_bytes", scan_admit_bytes);
+    }
+
     bool empty() {
       std::lock_guard l(lock);
       return _get_bytes() == 0;
@@ -1685,10 +1803,22 @@ public:
     /// forward lookups
     mempool::bluestore_cache_meta::unordered_map<ghobject_t,OnodeRef> onode_map;
 
+    typedef boost::intrusive::set<
+      ColdOnode,
+      boost::intrusive::member_hook<
+        ColdOnode,
+        boost::intrusive::set_member_hook<>,
+        &ColdOnode::set_item>,
+      boost::intrusive::key_of_value<ColdOnode::Key> > cold_map_t;
+    /// encoded onodes of this space in the cache's cold tier
+    cold_map_t cold_map;
+
     friend struct Collection; // for split_cache()
     friend struct Onode; // for put()
     friend struct LruOnodeCacheShard;
+    friend struct OnodeCacheShard; // for cold_map
     void _remove(const ghobject_t& oid);
+    void _rm_cold(const ghobject_t& oid);
   public:
     OnodeSpace(OnodeCacheShard *c) : cache(c) {}
     ~OnodeSpace() {
@@ -1697,6 +1827,8 @@ public:
 
     OnodeRef add_onode(const ghobject_t& oid, OnodeRef& o);
     OnodeRef lookup(const ghobject_t& o);
+    /// move the encoded onode out of the cold tier, if it is there
+    bool take_cold(const ghobject_t& oid, ceph::buffer::list *v);
     void rename(OnodeRef& o, const ghobject_t& old_oid,
 		const ghobject_t& new_oid,
 		const mempool::bluestore_cache_meta::string& new_okey);
@@ -2208,6 +2340,7 @@ public:
     std::map<uint64_t,deferred_io> iomap; ///< map of ios in this batch
     deferred_queue_t txcs;           ///< txcs in this batch
     IOContext ioc;                   ///< our aios
+    uint64_t bytes_overwritten = 0;  ///< bytes dropped by later writes
 #if defined(DEBUG_DEFERRED)
     /// bytes of pending io for each deferred seq (may be 0)
     std::map<uint64_t,int> seq_bytes;
@@ -2228,6 +2361,25 @@ public:
     }
   };
 
+  /// deferred batches of several sequencers, written as one LBA sorted
+  /// set of ios
+  struct DeferredAggregate final : public AioContext {
+    std::vector<DeferredBatch*> batches;
+    std::map<uint64_t,DeferredBatch::deferred_io> iomap; ///< merged ios
+    IOContext ioc;
+
+    explicit DeferredAggregate(CephContext *cct)
+      : ioc(cct, this) {}
+
+    /// true if none of b's ios overlaps the ones already merged
+    bool can_merge(const DeferredBatch& b) const;
+    void merge(DeferredBatch *b);
+
+    void aio_finish(BlueStore *store) override {
+      store->_deferred_aggregate_finish(this);
+    }
+  };
+
   class OpSequencer : public RefCountedObject {
   public:
     ceph::mutex qlock = ceph::make_mutex("BlueStore::OpSequencer::qlock");
@@ -2383,6 +2535,53 @@ public:
     }
   };
 
+  /// One of bluestore_kv_commit_lanes commit lanes.  OpSequencers are
+  /// mapped to a lane by sequencer id; a lane submits (async) and finalizes
+  /// the transactions of its sequencers independently of the other lanes.
+  /// Lanes only meet at the kv_sync_thread's synchronous WAL commit.  Each
+  /// lane submits and finalizes on threads of its own, so that the sync
+  /// thread, which waits for every lane's submit, never waits on a finalize.
+  struct KVCommitLane {
+    struct SubmitThread : public Thread {
+      BlueStore *store;
+      KVCommitLane *lane;
+      SubmitThread(BlueStore *s, KVCommitLane *l) : store(s), lane(l) {}
+      void *entry() override {
+	store->_kv_lane_submit_thread(lane);
+	return NULL;
+      }
+    };
+    struct FinalizeThread : public Thread {
+      BlueStore *store;
+      KVCommitLane *lane;
+      FinalizeThread(BlueStore *s, KVCommitLane *l) : store(s), lane(l) {}
+      void *entry() override {
+	store->_kv_lane_finalize_thread(lane);
+	return NULL;
+      }
+    };
+
+    const uint32_t idx;
+    SubmitThread submit_thread;
+    FinalizeThread finalize_thread;
+    PerfCounters *logger = nullptr;
+
+    ceph::mutex lock = ceph::make_mutex("BlueStore::KVCommitLane::lock");
+    ceph::condition_variable submit_cond;
+    ceph::condition_variable finalize_cond;
+    bool submit_started = false;
+    bool finalize_started = false;
+    bool stop = false;
+    bool submit_in_progress = false;
+    bool finalize_in_progress = false;
+    std::deque<TransContext*> submitting;      ///< need async kv submit
+    std::deque<TransContext*> committed;       ///< pending finalization
+    std::deque<DeferredBatch*> deferred_stable; ///< pending finalization
+
+    KVCommitLane(BlueStore *s, uint32_t i)
+      : idx(i), submit_thread(s, this), finalize_thread(s, this) {}
+  };
+
   struct BigDeferredWriteContext {
     uint64_t off = 0;     // original logical offset
     uint32_t b_off = 0;   // blob relative offset
@@ -2484,6 +2683,16 @@ private:
   std::deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
   bool kv_finalize_in_progress = false;
 
+  /// commit lanes, empty unless bluestore_kv_commit_lanes > 1
+  std::vector<std::unique_ptr<KVCommitLane>> kv_lanes;
+  ceph::mutex kv_lane_submit_lock =
+    ceph::make_mutex("BlueStore::kv_lane_submit_lock");
+  ceph::condition_variable kv_lane_submit_cond;
+  size_t kv_lane_submit_pending = 0; ///< lanes still submitting for kv_sync
+
+  /// protect removed_collections if finalization runs on several lanes
+  ceph::mutex reap_lock = ceph::make_mutex("BlueStore::reap_lock");
+
   PerfCounters *logger = nullptr;
 
   std::list<CollectionRef> removed_collections;
@@ -2523,6 +2732,11 @@ private:
   ///< number threshold for forced deferred writes
   std::atomic<int> deferred_batch_ops = {0};
 
+  ///< merge deferred batches across sequencers on submit
+  std::atomic<bool> deferred_aggregate = {true};
+  ///< max length of a merged deferred write, 0 for no limit
+  std::atomic<uint64_t> deferred_aggregate_max_bytes = {0};
+
   ///< size threshold for forced deferred writes
   std::atomic<uint64_t> prefer_deferred_size = {0};
 
@@ -2551,6 +2765,7 @@ private:
   double cache_kv_ratio = 0;     ///< cache ratio dedicated to kv (e.g., rocksdb)
   double cache_kv_onode_ratio = 0; ///< cache ratio dedicated to kv onodes (e.g., rocksdb onode CF)
   double cache_data_ratio = 0;   ///< cache ratio dedicated to object data
+  double cache_onode_cold_ratio = 0; ///< share of meta cache kept as encoded onodes
   bool cache_autotune = false;   ///< cache autotune setting
   double cache_age_bin_interval = 0; ///< time to wait between cache age bin rotations
   double cache_autotune_interval = 0; ///< time to wait between cache rebalancing
@@ -2735,6 +2950,7 @@ private:
           mempool::bluestore_cache_meta::allocated_bytes() +
           mempool::bluestore_cache_other::allocated_bytes() +
 	   mempool::bluestore_cache_onode::allocated_bytes() +
+	   mempool::bluestore_cache_onode_cold::allocated_bytes() +
           mempool::bluestore_shared_blob::allocated_bytes() +
           mempool::bluestore_inline_bl::allocated_bytes();
       }
@@ -2759,7 +2975,10 @@ private:
         return (2 > onode_num) ? 2 : onode_num;
       }
       double get_bytes_per_onode() const {
-        return (double)_get_used_bytes() / (double)_get_num_onodes();
+        // decoded onodes only, the cold tier is budgeted in bytes
+        int64_t used = _get_used_bytes() -
+          mempool::bluestore_cache_onode_cold::allocated_bytes();
+        return (double)std::max<int64_t>(used, 0) / (double)_get_num_onodes();
       }
     };
     std::shared_ptr<MetaCache> meta_cache;
@@ -2985,14 +3204,31 @@ private:
   void _kv_stop();
   void _kv_sync_thread();
   void _kv_finalize_thread();
+  void _kv_finalize(std::deque<TransContext*>& kv_committed,
+		    std::deque<DeferredBatch*>& deferred_stable);
+  void _kv_lane_submit_thread(KVCommitLane *lane);
+  void _kv_lane_finalize_thread(KVCommitLane *lane);
+  KVCommitLane *_get_kv_lane(const OpSequencer *osr) {
+    return kv_lanes[osr->get_sequencer_id() % kv_lanes.size()].get();
+  }
+  void _kv_lanes_submit(std::deque<TransContext*>& kv_submitting);
+  void _kv_lanes_queue_finalize(std::deque<TransContext*>& kv_committed,
+				std::deque<DeferredBatch*>& deferred_stable);
+  void _init_kv_lanes();
+  void _shutdown_kv_lanes();
 
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, uint64_t len);
   void _deferred_queue(TransContext *txc);
 public:
   void deferred_try_submit();
 private:
+  DeferredBatch *_deferred_start_unlock(OpSequencer *osr);
   void _deferred_submit_unlock(OpSequencer *osr);
+  void _deferred_write_iomap(
+    std::map<uint64_t,DeferredBatch::deferred_io>& iomap,
+    IOContext *ioc);
   void _deferred_aio_finish(OpSequencer *osr);
+  void _deferred_aggregate_finish(DeferredAggregate *agg);
   int _deferred_replay();
   bool _eliminate_outdated_deferred(bluestore_deferred_transaction_t* deferred_txn,
 				    interval_set<uint64_t>& bluefs_extents);
@@ -3369,6 +3605,7 @@ private:
     std::vector<ceph::buffer::list>& compressed_blob_bls,
     blobs2read_t& blobs2read,
     bool buffered,
+    int read_cache_policy,
     bool* csum_error,
     ceph::buffer::list& bl);
 
@@ -3448,6 +3685,9 @@ public:
                              std::vector<ghobject_t> *ls,
                              ghobject_t *next) override;
 
+  void prefetch_object_meta(CollectionHandle &c,
+                            const std::vector<ghobject_t>& oids) override;
+
   int omap_get(
     CollectionHandle &c,     ///< [in] Collection containing oid
     const ghobject_t &oid,   ///< [in] Object containing omap
@@ -4246,6 +4486,9 @@ private:
   int  read_allocation_from_onodes_mt(SimpleBitmap *smbmp, read_alloc_stats_t& stats);
   class OnodeScanMT;
   friend OnodeScanMT;
+  class FsckDeepReadMT;
+  friend FsckDeepReadMT;
+  int64_t _fsck_deep_read_mt(size_t num_threads);
   int  commit_freelist_type();
   int  commit_to_null_manager();
   int  commit_to_real_manager();
@@ -0,0 +1,290 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include <thread>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "CpuCachedAllocator.h"
+#include "common/debug.h"
+#include "include/intarith.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef dout_prefix
+#define dout_prefix *_dout << "cpucachedalloc 0x" << this << " "
+
+CpuCachedAllocator::CpuCachedAllocator(CephContext* cct,
+                                       Allocator* _backend,
+                                       uint64_t _refill_size)
+  : Allocator(_backend->get_name(), _backend->get_capacity(),
+              _backend->get_block_size()),
+    cct(cct),
+    backend(_backend),
+    refill_size(std::max(p2roundup<uint64_t>(_refill_size, block_size),
+                         (uint64_t)block_size)),
+    // a request must leave most of a refill for the next ones
+    max_request(std::max(p2align<uint64_t>(refill_size / 4, block_size),
+                         (uint64_t)block_size)),
+    num_slots(std::max(1u, std::thread::hardware_concurrency()))
+{
+  slots.reset(new slot_t[num_slots]);
+  ldout(cct, 1) << __func__ << " " << backend->get_type()
+                << " slots " << num_slots
+                << " refill_size 0x" << std::hex << refill_size
+                << " max_request 0x" << max_request << std::dec
+                << dendl;
+}
+
+CpuCachedAllocator::~CpuCachedAllocator()
+{
+  ldout(cct, 1) << __func__ << " hits " << hits << " misses " << misses
+                << " refills " << refills << dendl;
+}
+
+CpuCachedAllocator::slot_t& CpuCachedAllocator::_get_slot()
+{
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return slots[cpu % num_slots];
+  }
+#endif
+  static thread_local size_t tid =
+    std::hash<std::thread::id>()(std::this_thread::get_id());
+  return slots[tid % num_slots];
+}
+
+// carve want bytes out of one of the extents, most recently added first,
+// that is what was freed or fetched last
+static bool carve(std::vector<bluestore_pextent_t>& v, uint64_t want,
+                  PExtentVector *extents)
+{
+  for (auto p = v.rbegin(); p != v.rend(); ++p) {
+    if (p->length < want) {
+      continue;
+    }
+    extents->emplace_back(p->offset, want);
+    p->offset += want;
+    p->length -= want;
+    if (p->length == 0) {
+      *p = v.back();
+      v.pop_back();
+    }
+    return true;
+  }
+  return false;
+}
+
+bool CpuCachedAllocator::_take(slot_t& s, uint64_t want,
+                               PExtentVector *extents)
+{
+  if (!carve(s.extents, want, extents)) {
+    return false;
+  }
+  s.bytes -= want;
+  cached_bytes -= want;
+  return true;
+}
+
+void CpuCachedAllocator::_detach(slot_t& s, release_set_t *rs)
+{
+  for (auto& e : s.extents) {
+    rs->insert(e.offset, e.length);
+  }
+  cached_bytes -= s.bytes;
+  s.bytes = 0;
+  s.extents.clear();
+}
+
+void CpuCachedAllocator::_drain_all()
+{
+  for (size_t i = 0; i < num_slots; ++i) {
+    auto& s = slots[i];
+    release_set_t rs;
+    {
+      std::lock_guard l(s.lock);
+      _detach(s, &rs);
+    }
+    if (!rs.empty()) {
+      backend->release(rs);
+    }
+  }
+}
+
+int64_t CpuCachedAllocator::allocate(
+  uint64_t want_size,
+  uint64_t alloc_unit,
+  uint64_t max_alloc_size,
+  int64_t hint,
+  PExtentVector *extents)
+{
+  uint64_t want = p2roundup(want_size, alloc_unit);
+  if (alloc_unit == (uint64_t)block_size &&
+      want <= max_request &&
+      (max_alloc_size == 0 || max_alloc_size >= want)) {
+    auto& s = _get_slot();
+    std::unique_lock l(s.lock, std::try_to_lock);
+    if (l.owns_lock()) {
+      if (_take(s, want, extents)) {
+        ++hits;
+        return want;
+      }
+      // leftovers are too small to serve this, hand them back and
+      // take a fresh batch
+      release_set_t leftovers;
+      _detach(s, &leftovers);
+      l.unlock();
+      if (!leftovers.empty()) {
+        backend->release(leftovers);
+      }
+      PExtentVector fresh;
+      int64_t r = backend->allocate(refill_size, alloc_unit, 0, hint, &fresh);
+      if (r > 0) {
+        ++refills;
+        std::vector<bluestore_pextent_t> batch(fresh.begin(), fresh.end());
+        bool took = carve(batch, want, extents);
+        uint64_t rest = took ? r - want : r;
+        // cache the rest if the slot is still ours to fill
+        release_set_t unused;
+        l.try_lock();
+        if (l.owns_lock() && s.bytes + rest <= refill_size) {
+          s.extents.insert(s.extents.end(), batch.begin(), batch.end());
+          s.bytes += rest;
+          cached_bytes += rest;
+        } else {
+          for (auto& e : batch) {
+            unused.insert(e.offset, e.length);
+          }
+        }
+        if (l.owns_lock()) {
+          l.unlock();
+        }
+        if (!unused.empty()) {
+          backend->release(unused);
+        }
+        if (took) {
+          ++misses;
+          return want;
+        }
+      }
+    }
+  }
+  ++misses;
+  int64_t r = backend->allocate(want_size, alloc_unit, max_alloc_size, hint,
+                                extents);
+  if (r >= (int64_t)want || cached_bytes == 0) {
+    return r;
+  }
+  // running short, pull back what the other cpus are holding
+  ldout(cct, 10) << __func__ << " short allocation 0x" << std::hex << want
+                 << " got 0x" << (r > 0 ? r : 0) << ", draining 0x"
+                 << cached_bytes << std::dec << dendl;
+  _drain_all();
+  uint64_t got = r > 0 ? r : 0;
+  int64_t r2 = backend->allocate(want - got, alloc_unit, max_alloc_size, hint,
+                                 extents);
+  if (r2 > 0) {
+    got += r2;
+  }
+  return got ? (int64_t)got : r;
+}
+
+void CpuCachedAllocator::release(const release_set_t& release_set)
+{
+  auto& s = _get_slot();
+  std::unique_lock l(s.lock, std::try_to_lock);
+  if (!l.owns_lock()) {
+    backend->release(release_set);
+    return;
+  }
+  // keep what fits for reuse on this cpu, the rest goes back
+  release_set_t rest;
+  for (auto p = release_set.begin(); p != release_set.end(); ++p) {
+    uint64_t len = p.get_len();
+    if (p2aligned(p.get_start(), (uint64_t)block_size) &&
+        p2aligned(len, (uint64_t)block_size) &&
+        len <= max_request &&
+        s.bytes + len <= refill_size) {
+      s.extents.emplace_back(p.get_start(), len);
+      s.bytes += len;
+      cached_bytes += len;
+    } else {
+      rest.insert(p.get_start(), len);
+    }
+  }
+  l.unlock();
+  if (!rest.empty()) {
+    backend->release(rest);
+  }
+}
+
+void CpuCachedAllocator::dump()
+{
+  ldout(cct, 0) << __func__ << " cached 0x" << std::hex << cached_bytes
+                << std::dec << " hits " << hits << " misses " << misses
+                << " refills " << refills << dendl;
+  backend->dump();
+}
+
+void CpuCachedAllocator::foreach(
+  std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  backend->foreach(notify);
+  std::vector<bluestore_pextent_t> cached;
+  for (size_t i = 0; i < num_slots; ++i) {
+    auto& s = slots[i];
+    {
+      std::lock_guard l(s.lock);
+      cached.assign(s.extents.begin(), s.extents.end());
+    }
+    for (auto& e : cached) {
+      notify(e.offset, e.length);
+    }
+  }
+}
+
+void CpuCachedAllocator::init_add_free(uint64_t offset, uint64_t length)
+{
+  // nothing is cached while the free list is being loaded
+  if (cached_bytes) {
+    _drain_all();
+  }
+  backend->init_add_free(offset, length);
+}
+
+void CpuCachedAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  if (cached_bytes) {
+    _drain_all();
+  }
+  backend->init_rm_free(offset, length);
+}
+
+uint64_t CpuCachedAllocator::get_free()
+{
+  return backend->get_free() + cached_bytes;
+}
+
+double CpuCachedAllocator::get_fragmentation()
+{
+  return backend->get_fragmentation();
+}
+
+double CpuCachedAllocator::get_fragmentation_score()
+{
+  return backend->get_fragmentation_score();
+}
+
+void CpuCachedAllocator::expand(int64_t new_size)
+{
+  backend->expand(new_size);
+  Allocator::expand(new_size);
+}
+
+void CpuCachedAllocator::shutdown()
+{
+  _drain_all();
+  backend->shutdown();
+}
@@ -0,0 +1,106 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_OS_BLUESTORE_CPUCACHEDALLOCATOR_H
+#define CEPH_OS_BLUESTORE_CPUCACHEDALLOCATOR_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Allocator.h"
+#include "common/ceph_mutex.h"
+
+/*
+ * Per-cpu front end for any Allocator implementation.
+ *
+ * Each cpu owns a slot with a few free extents taken from the backend in
+ * one batch. Small allocations, in multiples of the backend's block size,
+ * are carved from the current cpu's slot without touching the backend
+ * lock. The allocation path only try-locks a slot: if it is busy (the
+ * thread migrated, or another thread runs on the same cpu) the request
+ * goes to the backend, never waits. The backend is never called with a
+ * slot locked, so draining and foreach() wait at most for a few vector
+ * operations.
+ * Cached extents are still free space: get_free() and foreach() report
+ * them, and all slots are given back to the backend when it runs short.
+ */
+class CpuCachedAllocator : public Allocator {
+  // one slot per cpu, kept on its own cache line
+  struct alignas(64) slot_t {
+    ceph::mutex lock = ceph::make_mutex("CpuCachedAllocator::slot_t::lock");
+    uint64_t bytes = 0;
+    std::vector<bluestore_pextent_t> extents;
+  };
+
+  CephContext* cct;
+  std::unique_ptr<Allocator> backend;
+  const uint64_t refill_size;   ///< bytes fetched from backend at once
+  const uint64_t max_request;   ///< larger requests bypass the cache
+  std::unique_ptr<slot_t[]> slots;
+  const size_t num_slots;
+
+  std::atomic<uint64_t> cached_bytes = {0};
+  std::atomic<uint64_t> hits = {0};
+  std::atomic<uint64_t> misses = {0};
+  std::atomic<uint64_t> refills = {0};
+
+  slot_t& _get_slot();
+  /// carve want bytes from the slot, slot must be locked
+  bool _take(slot_t& s, uint64_t want, PExtentVector *extents);
+  /// empty the slot into rs, slot must be locked
+  void _detach(slot_t& s, release_set_t *rs);
+  void _drain_all();
+
+public:
+  CpuCachedAllocator(CephContext* cct,
+                     Allocator* backend,
+                     uint64_t refill_size);
+  ~CpuCachedAllocator() override;
+
+  const char* get_type() const override {
+    return backend->get_type();
+  }
+  const std::string& get_name() const override {
+    return backend->get_name();
+  }
+
+  int64_t allocate(
+    uint64_t want_size, uint64_t alloc_unit, uint64_t max_alloc_size,
+    int64_t hint, PExtentVector *extents) override;
+  void release(const release_set_t& release_set) override;
+
+  void dump() override;
+  void foreach(
+    std::function<void(uint64_t offset, uint64_t length)> notify) override;
+
+  void init_add_free(uint64_t offset, uint64_t length) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+
+  uint64_t get_free() override;
+  double get_fragmentation() override;
+  double get_fragmentation_score() override;
+  void expand(int64_t new_size) override;
+  void shutdown() override;
+
+  uint64_t get_hit_count() const {
+    return hits;
+  }
+  uint64_t get_miss_count() const {
+    return misses;
+  }
+  uint64_t get_cached_bytes() const {
+    return cached_bytes;
+  }
+};
+
+#endif
@@ -14,6 +14,7 @@
 #include "common/pretty_binary.h"
 #include "simple_bitmap.h"
 #include "common/debug.h"
+#include "common/errno.h"
 using namespace std;
 
 // kv store prefixes, copied from BlueStore.cc
@@ -201,6 +202,7 @@ class BlueStore::OnodeScanMT {
   ceph::mutex lock = ceph::make_mutex("BlueStore::OnodeScanMT::lock");
   void report_progress(uint32_t thread_no, uint64_t no_completed) {
     auto &cct = store.cct;
+    store.logger->inc(l_bluestore_alloc_recovery_onodes, no_completed);
     std::lock_guard l(lock);
     if (total / interval != (total + no_completed) / interval) {
       dout(5) << __func__ << " processed objects count = "
@@ -357,8 +359,158 @@ public:
 
 int BlueStore::read_allocation_from_onodes_mt(SimpleBitmap *sbmap, read_alloc_stats_t& stats)
 {
+  logger->set(l_bluestore_alloc_recovery_onodes, 0);
   OnodeScanMT scaner(*this, sbmap, stats);
   scaner.scan();
   return 0;
 }
 
+
+/*
+ * Deep fsck data verification.
+ * The onode key space is range-partitioned; every worker decodes the onodes
+ * of the ranges it picks up and reads back (and so checksums) all of their
+ * data.  Errors are accumulated per thread and summed up at the end.
+ */
+class BlueStore::FsckDeepReadMT {
+  BlueStore& store;
+  vector<KeyValueDB::keyrange_t> chunks;
+  uint32_t chunk_pos = 0;
+  ceph::mutex lock = ceph::make_mutex("BlueStore::FsckDeepReadMT::lock");
+
+  bool ask_for_work(
+    string& start_key,
+    string& upper_bound_key) {
+    std::lock_guard l(lock);
+    if (chunk_pos < chunks.size()) {
+      start_key = chunks[chunk_pos].first_key;
+      upper_bound_key = chunks[chunk_pos].upper_bound;
+      chunk_pos++;
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  CollectionRef find_collection(const ghobject_t& oid, CollectionRef c) {
+    if (c && c->contains(oid)) {
+      return c;
+    }
+    // coll_map is not modified while fsck runs
+    for (auto& p : store.coll_map) {
+      if (p.second->contains(oid)) {
+        return p.second;
+      }
+    }
+    return CollectionRef();
+  }
+
+  int64_t read_range(
+    const string& start_key,
+    const string& upper_bound_key)
+  {
+    auto& db = store.db;
+    auto& cct = store.cct;
+    int64_t errors = 0;
+    auto it = db->get_iterator(PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE);
+    if (!it) {
+      derr << "failed getting onode's iterator" << dendl;
+      return 1;
+    }
+    uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
+    CollectionRef c;
+    for (it->lower_bound(start_key); it->valid(); it->next()) {
+      if (is_extent_shard_key(it->key())) {
+        continue;
+      }
+      if (it->key() >= upper_bound_key) {
+        break;
+      }
+      ghobject_t oid;
+      if (get_key_object(it->key(), &oid) < 0) {
+        // reported by the metadata pass
+        continue;
+      }
+      c = find_collection(oid, c);
+      if (!c) {
+        // stray object, reported by the metadata pass
+        continue;
+      }
+      OnodeRef o;
+      o.reset(Onode::create_decode(c, oid, it->key(), it->value(), false,
+                                   store.segment_size != 0));
+      o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+
+      bufferlist bl;
+      uint64_t offset = 0;
+      do {
+        uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
+        int r = store._do_read(c.get(), o, offset, l, bl,
+                               CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+        if (r < 0) {
+          ++errors;
+          derr << "fsck error: " << oid << std::hex
+               << " error during read: "
+               << " " << offset << "~" << l
+               << " " << cpp_strerror(r) << std::dec
+               << dendl;
+          break;
+        }
+        store.logger->inc(l_bluestore_fsck_deep_read_bytes, l);
+        offset += l;
+      } while (offset < o->onode.size);
+      store.logger->inc(l_bluestore_fsck_deep_read_objects);
+    }
+    return errors;
+  }
+
+  void reader_thread(
+    uint32_t thread_no,
+    int64_t& errors)
+  {
+    [[maybe_unused]] auto& cct = store.cct;
+    string start_key;
+    string upper_bound_key;
+    while(ask_for_work(start_key, upper_bound_key)) {
+      dout(10) << "thread " << thread_no << " reads: " << pretty_binary_string(start_key)
+        << "..." << pretty_binary_string(upper_bound_key) << dendl;
+      errors += read_range(start_key, upper_bound_key);
+    }
+  }
+
+public:
+  explicit FsckDeepReadMT(BlueStore& store)
+  : store(store) {}
+
+  int64_t run(size_t num_threads) {
+    [[maybe_unused]] auto& cct = store.cct;
+    ceph_assert(num_threads > 0);
+    // a few chunks per thread, so that threads finishing early can help out
+    store.db->util_divide_key_range(
+      PREFIX_OBJ, "", string(100, '\377'), num_threads * 4, 1'000'000, 0.1, chunks);
+    for (size_t i = 0; i < chunks.size(); i++) {
+      dout(10) << i << ": " << pretty_binary_string(chunks[i].first_key)
+        << "..." << pretty_binary_string(chunks[i].upper_bound) << dendl;
+    }
+
+    num_threads = std::min(num_threads, chunks.size());
+    std::vector<int64_t> thr_errors(num_threads, 0);
+    std::vector<thread> thr(num_threads);
+    for (size_t i = 0; i < num_threads; i++) {
+      thr[i] = std::thread(
+        &BlueStore::FsckDeepReadMT::reader_thread, this, i, std::ref(thr_errors[i]));
+    }
+    int64_t errors = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+      thr[i].join();
+      errors += thr_errors[i];
+    }
+    return errors;
+  }
+};
+
+int64_t BlueStore::_fsck_deep_read_mt(size_t num_threads)
+{
+  FsckDeepReadMT reader(*this);
+  return reader.run(num_threads);
+}
@@ -0,0 +1,145 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "BackfillReadahead.h"
+
+#include "common/Finisher.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "include/Context.h"
+#include "osd/PGBackend.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix *_dout << "backfill_readahead "
+
+bool BackfillReadahead::scan(params_t& p, PrimaryBackfillInterval *bi)
+{
+  CephContext *cct = p.store->cct;
+  std::vector<hobject_t> ls;
+  int r = PGBackend::list_partial(
+    p.store, p.ch, p.shard, p.fixed_collection_list,
+    bi->begin, p.min, p.max, &ls, &bi->end);
+  if (r < 0) {
+    dout(10) << __func__ << " list from " << bi->begin << " got "
+             << cpp_strerror(r) << dendl;
+    return false;
+  }
+  dout(20) << __func__ << " " << ls.size() << " objects " << bi->begin
+           << "-" << bi->end << dendl;
+
+  std::vector<ghobject_t> oids;
+  oids.reserve(ls.size());
+  for (auto& hoid : ls) {
+    oids.emplace_back(hoid, ghobject_t::NO_GEN, p.shard);
+  }
+  p.store->prefetch_object_meta(p.ch, oids);
+
+  for (auto& oid : oids) {
+    ceph::buffer::ptr bp;
+    r = p.store->getattr(p.ch, oid, OI_ATTR, bp);
+    if (r == -ENOENT) {
+      // removed since the listing, the log has it
+      continue;
+    }
+    if (r < 0) {
+      dout(10) << __func__ << " getattr " << oid << " got "
+               << cpp_strerror(r) << dendl;
+      return false;
+    }
+    ceph::buffer::list bl;
+    bl.push_back(std::move(bp));
+    object_info_t oi(bl);
+    bi->add(oid.hobj, oi.version, oi.shard_versions, p.backfill_targets);
+  }
+  return true;
+}
+
+void BackfillReadahead::scan_ahead(std::shared_ptr<state_t> s, uint64_t gen)
+{
+  std::unique_lock l{s->lock};
+  while (s->gen == gen &&
+         s->ready.size() < s->window &&
+         !s->next.is_max()) {
+    PrimaryBackfillInterval bi;
+    bi.begin = s->next;
+    bi.version = s->version;
+    auto params = s->params;
+    s->scanning = true;
+    l.unlock();
+    bool ok = scan(*params, &bi);
+    l.lock();
+    if (s->gen != gen) {
+      return;
+    }
+    s->scanning = false;
+    if (!ok) {
+      // leave it to the scan in place, which reports the error
+      break;
+    }
+    s->next = bi.end;
+    s->ready.push_back(std::move(bi));
+    s->cond.notify_all();
+  }
+  if (s->gen == gen) {
+    s->queued = false;
+    s->cond.notify_all();
+  }
+}
+
+void BackfillReadahead::kick(Finisher *f, const hobject_t& from,
+                             eversion_t version, unsigned window,
+                             params_t&& p)
+{
+  std::lock_guard l{state->lock};
+  const hobject_t& at = state->ready.empty() ?
+    state->next : state->ready.front().begin;
+  if (at != from) {
+    ++state->gen;
+    state->ready.clear();
+    state->next = from;
+    state->queued = false;
+    state->scanning = false;
+  }
+  state->window = window;
+  state->version = version;
+  state->params = std::make_shared<params_t>(std::move(p));
+  if (!state->queued &&
+      state->ready.size() < window &&
+      !state->next.is_max()) {
+    state->queued = true;
+    f->queue(new LambdaContext([s = state, gen = state->gen](int) {
+      scan_ahead(s, gen);
+    }));
+  }
+}
+
+bool BackfillReadahead::take(const hobject_t& begin,
+                             PrimaryBackfillInterval *bi)
+{
+  std::unique_lock l{state->lock};
+  while (state->ready.empty()) {
+    if (!state->scanning || state->next != begin) {
+      return false;
+    }
+    state->cond.wait(l);
+  }
+  if (state->ready.front().begin != begin) {
+    return false;
+  }
+  *bi = std::move(state->ready.front());
+  state->ready.pop_front();
+  return true;
+}
+
+void BackfillReadahead::reset()
+{
+  std::lock_guard l{state->lock};
+  ++state->gen;
+  state->ready.clear();
+  state->next = hobject_t();
+  state->queued = false;
+  state->scanning = false;
+  state->cond.notify_all();
+}
@@ -0,0 +1,122 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <set>
+
+#include "common/ceph_mutex.h"
+#include "os/ObjectStore.h"
+#include "osd/recovery_types.h"
+
+class Finisher;
+
+/**
+ * BackfillReadahead - scan the primary's objects ahead of backfill
+ *
+ * recover_backfill() walks the local PG one PrimaryBackfillInterval at
+ * a time.  With osd_backfill_scan_readahead set, the intervals after
+ * the current one are listed and stat'ed on a backfill scan thread, off
+ * the PG lock, while the current one is being pushed.
+ *
+ * A scan only reads the ObjectStore.  It is stamped with the
+ * last_update_applied of the PG when it was queued: every write up to
+ * that version is in the store, while later ones, logged or not, may
+ * not be.  update_range() replays the log past the stamp, so a taken
+ * interval picks up the writes that were in flight during the scan
+ * like one scanned in place.  revalidate() additionally takes versions
+ * from the object contexts that are still cached.
+ *
+ * Every method is called under the PG lock.
+ */
+class BackfillReadahead {
+public:
+  /// what a scan needs, captured under the PG lock
+  struct params_t {
+    ObjectStore *store = nullptr;
+    ObjectStore::CollectionHandle ch;
+    shard_id_t shard;
+    bool fixed_collection_list = true;
+    std::set<pg_shard_t> backfill_targets;
+    int min = 0;
+    int max = 0;
+  };
+
+private:
+  struct state_t {
+    ceph::mutex lock = ceph::make_mutex("BackfillReadahead::state_t::lock");
+    ceph::condition_variable cond;
+    uint64_t gen = 0;      ///< bumped to drop scans that are in flight
+    unsigned window = 0;
+    std::shared_ptr<params_t> params;
+    eversion_t version;    ///< stamp for the scans queued from now on
+    /// scanned intervals, in order, the first one starting at the
+    /// interval backfill will want next
+    std::deque<PrimaryBackfillInterval> ready;
+    hobject_t next;        ///< where the next scan starts
+    bool queued = false;   ///< a scan task is queued or running
+    bool scanning = false; ///< ... and is scanning next right now
+  };
+  std::shared_ptr<state_t> state = std::make_shared<state_t>();
+
+  static void scan_ahead(std::shared_ptr<state_t> s, uint64_t gen);
+  /// fill bi from bi->begin, false on a store error
+  static bool scan(params_t& p, PrimaryBackfillInterval *bi);
+
+public:
+  /**
+   * keep up to window intervals scanned ahead from from
+   *
+   * Starts over at from if the readahead is somewhere else.  Scans
+   * queued from here on are stamped with version.
+   */
+  void kick(Finisher *f, const hobject_t& from, eversion_t version,
+            unsigned window, params_t&& p);
+  /**
+   * move the interval starting at begin into bi
+   *
+   * Waits if it is being scanned right now.  Returns false, leaving bi
+   * alone, if it is not ready; the caller then scans it in place.
+   */
+  bool take(const hobject_t& begin, PrimaryBackfillInterval *bi);
+  /// drop what was scanned, scans in flight are discarded
+  void reset();
+
+  /**
+   * override the versions in a taken interval with the cached object
+   * contexts, as scan_range_primary() does
+   *
+   * lookup(hoid) returns the cached ObjectContextRef or null.  Called
+   * under the PG lock, before update_range().
+   */
+  template <typename Lookup>
+  static void revalidate(PrimaryBackfillInterval *bi,
+                         const std::set<pg_shard_t>& backfill_targets,
+                         Lookup&& lookup) {
+    for (auto p = bi->objects.begin(); p != bi->objects.end(); ) {
+      const hobject_t hoid = p->first;
+      auto next = bi->objects.upper_bound(hoid);
+      auto obc = lookup(hoid);
+      if (obc) {
+        bi->objects.erase(p, next);
+        if (obc->obs.exists) {
+          bi->add(hoid, obc->obs.oi.version, obc->obs.oi.shard_versions,
+                  backfill_targets);
+        }
+      }
+      p = next;
+    }
+  }
+};
@@ -103,6 +103,7 @@
 #include "messages/MOSDPGCreate2.h"
 #include "messages/MOSDForceRecovery.h"
 #include "messages/MOSDPGCreated.h"
+#include "messages/MOSDRepOpBatch.h"
 
 #include "messages/MOSDPeeringOp.h"
 
@@ -255,6 +256,7 @@ OSDService::OSDService(OSD *osd, ceph::async::io_context_pool& poolctx) :
   monc(osd->monc),
   osd_max_object_size(cct->_conf, "osd_max_object_size"),
   osd_skip_data_digest(cct->_conf, "osd_skip_data_digest"),
+  repop_batcher(cct),
   publish_lock{ceph::make_mutex("OSDService::publish_lock")},
   pre_publish_lock{ceph::make_mutex("OSDService::pre_publish_lock")},
   m_osd_scrub{cct, *this, cct->_conf},
@@ -304,6 +306,12 @@ OSDService::OSDService(OSD *osd, ceph::async::io_context_pool& poolctx) :
     auto fin = make_unique<Finisher>(osd->client_messenger->cct, str.str(), "finisher");
     objecter_finishers.push_back(std::move(fin));
   }
+  for (unsigned i = 0; i < cct->_conf->osd_backfill_scan_threads; i++) {
+    ostringstream str;
+    str << "backfill-scan-finisher-" << i;
+    backfill_scan_finishers.push_back(
+      make_unique<Finisher>(cct, str.str(), "bf_scan"));
+  }
 }
 
 #ifdef PG_DEBUG_REFS
@@ -515,6 +523,7 @@ void OSDService::shutdown_reserver()
 
 void OSDService::shutdown()
 {
+  repop_batcher.stop();
   pg_timer.stop();
 
   mono_timer.suspend();
@@ -529,6 +538,10 @@ void OSDService::shutdown()
     f->wait_for_empty();
     f->stop();
   }
+  for (auto& f : backfill_scan_finishers) {
+    f->wait_for_empty();
+    f->stop();
+  }
 
   publish_map(OSDMapRef());
   next_osdmap = OSDMapRef();
@@ -536,6 +549,7 @@ void OSDService::shutdown()
 
 void OSDService::fast_shutdown()
 {
+  repop_batcher.stop();
   mono_timer.suspend();
   {
     std::lock_guard l(watch_lock);
@@ -549,6 +563,9 @@ void OSDService::init()
   for (auto& f : objecter_finishers) {
     f->start();
   }
+  for (auto& f : backfill_scan_finishers) {
+    f->start();
+  }
   objecter->set_client_incarnation(0);
 
   // deprioritize objecter in daemonperf output
@@ -559,6 +576,7 @@ void OSDService::init()
   mono_timer.resume();
 
   agent_thread.create("osd_srv_agent");
+  repop_batcher.start(logger);
 
   if (cct->_conf->osd_recovery_delay_start)
     defer_recovery(cct->_conf->osd_recovery_delay_start);
@@ -1135,7 +1153,10 @@ void OSDService::send_message_osd_cluster(int peer, Message *m, epoch_t from_epo
 	next_map->get_cluster_addrs(peer), false, true);
   }
   maybe_share_map(peer_con.get(), next_map);
-  peer_con->send_message(m);
+  if (!RepOpBatcher::is_batchable(m) || !repop_batcher.queue(peer_con, m)) {
+    repop_batcher.flush(peer_con.get());
+    peer_con->send_message(m);
+  }
   release_map(next_map);
 }
 
@@ -1160,10 +1181,31 @@ void OSDService::send_message_osd_cluster(std::vector<std::pair<int, Message*>>&
 	  next_map->get_cluster_addrs(iter.first), false, true);
     }
     maybe_share_map(peer_con.get(), next_map);
+    repop_batcher.flush(peer_con.get());
     peer_con->send_message(iter.second);
   }
   release_map(next_map);
 }
+
+void OSDService::send_message_osd_client(Message *m, const ConnectionRef& con)
+{
+  if (m->get_type() == CEPH_MSG_OSD_OPREPLY &&
+      cct->_conf->osd_op_reply_load_hint) {
+    static_cast<MOSDOpReply*>(m)->set_load_hint(
+      get_op_queue_depth(), op_latency_us.load(std::memory_order_relaxed));
+  }
+  con->send_message(m);
+}
+
+uint32_t OSDService::get_op_queue_depth() const
+{
+  uint64_t depth = 0;
+  for (auto shard : osd->shards) {
+    depth += shard->queue_depth.load(std::memory_order_relaxed);
+  }
+  return std::min<uint64_t>(depth, UINT32_MAX);
+}
+
 ConnectionRef OSDService::get_con_osd_cluster(int peer, epoch_t from_epoch)
 {
   dout(20) << __func__ << " to osd." << peer
@@ -1506,6 +1548,7 @@ void OSDService::send_incremental_map(epoch_t since, Connection *con,
              << ", only sending most recent" << dendl;
     since = to - cct->_conf->osd_map_share_max_epochs;
   }
+  repop_batcher.flush(con);
   con->send_message(build_incremental_map_msg(since, to, sblock));
 }
 
@@ -7714,6 +7757,8 @@ void OSD::ms_fast_dispatch(Message *m)
     return handle_fast_pg_info(static_cast<MOSDPGInfo*>(m));
   case MSG_OSD_PG_REMOVE:
     return handle_fast_pg_remove(static_cast<MOSDPGRemove*>(m));
+  case MSG_OSD_REPOP_BATCH:
+    return handle_fast_repop_batch(static_cast<MOSDRepOpBatch*>(m));
     // these are single-pg messages that handle themselves
   case MSG_OSD_PG_LOG:
   case MSG_OSD_PG_TRIM:
@@ -9453,7 +9498,7 @@ void OSD::dispatch_context(PeeringCtx &ctx, PG *pg, OSDMapRef curmap,
       }
       service.maybe_share_map(con.get(), curmap);
       for (auto m : ls) {
-	con->send_message2(m);
+	service.send_message_osd_cluster(std::move(m), con.get());
       }
       ls.clear();
     }
@@ -9596,6 +9641,31 @@ void OSD::handle_fast_pg_remove(MOSDPGRemove *m)
   m->put();
 }
 
+void OSD::handle_fast_repop_batch(MOSDRepOpBatch *m)
+{
+  dout(20) << __func__ << " " << *m << " from " << m->get_source() << dendl;
+  if (!require_osd_peer(m)) {
+    m->put();
+    return;
+  }
+  // dispatch in order, as if each had arrived on its own
+  for (auto sub : m->claim_messages()) {
+    if (!RepOpBatcher::is_batchable(sub)) {
+      dout(0) << __func__ << " unexpected " << *sub << " in batch from "
+	      << m->get_source() << ", dropping" << dendl;
+      sub->put();
+      continue;
+    }
+    sub->set_connection(m->get_connection());
+    sub->set_src(m->get_source());
+    sub->set_recv_stamp(m->get_recv_stamp());
+    sub->set_throttle_stamp(m->get_throttle_stamp());
+    sub->set_recv_complete_stamp(m->get_recv_complete_stamp());
+    ms_fast_dispatch(sub);
+  }
+  m->put();
+}
+
 void OSD::handle_fast_force_recovery(MOSDForceRecovery *m)
 {
   dout(10) << __func__ << " " << *m << dendl;
@@ -9673,7 +9743,7 @@ void OSD::handle_pg_query_nopg(const MQuery& q)
 			    std::move(notify));
     }
     service.maybe_share_map(con.get(), osdmap);
-    con->send_message(m);
+    service.send_message_osd_cluster(m, con);
   }
 }
 
@@ -10857,6 +10927,7 @@ int OSDShard::_wake_pg_slot(
   }
   slot->waiting_peering.clear();
   ++slot->requeue_seq;
+  queue_depth += count;
   return count;
 }
 
@@ -11073,6 +11144,8 @@ OSDShard::OSDShard(
     scheduler(ceph::osd::scheduler::make_scheduler(
       cct, osd->whoami, osd->num_shards, id, osd->store->is_rotational(),
       osd->store->get_type(), osd_op_queue, osd_op_queue_cut_off)),
+    staged_max(cct->_conf->osd_op_queue_staging_size),
+    staged(staged_max),
     context_queue(sdata_wait_lock, sdata_cond),
     ec_extent_cache_lru(cct->_conf.get_val<uint64_t>(
       "ec_extent_cache_size"))
@@ -11080,6 +11153,41 @@ OSDShard::OSDShard(
   dout(0) << "using op scheduler " << *scheduler << dendl;
 }
 
+OSDShard::~OSDShard()
+{
+  staged.consume_all([](staged_op_t *op) {
+    delete op;
+  });
+}
+
+bool OSDShard::stage(OpSchedulerItem&& item)
+{
+  auto op = new staged_op_t{std::move(item), ceph::real_clock::now()};
+  if (!staged.bounded_push(op)) {
+    item = std::move(op->item);
+    delete op;
+    return false;
+  }
+  return true;
+}
+
+unsigned OSDShard::_drain_staged()
+{
+  // at most a ring's worth, so that a steady stream of producers can't
+  // keep us here
+  unsigned n = 0;
+  staged_op_t *op;
+  while (n < staged_max && staged.pop(op)) {
+    scheduler->enqueue_staged(std::move(op->item), op->arrival);
+    delete op;
+    ++n;
+  }
+  if (n) {
+    dout(20) << __func__ << " " << n << " ops" << dendl;
+  }
+  return n;
+}
+
 
 // =============================================================
 
@@ -11124,11 +11232,26 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
 
   // peek at spg_t
   sdata->shard_lock.lock();
+  sdata->_drain_staged();
+  if (sdata->scheduler->empty() &&
+      (!is_smallest_thread_index || sdata->context_queue.empty()) &&
+      osd->num_shards > 1 &&
+      osd->cct->_conf->osd_op_queue_work_stealing) {
+    // nothing for us, help a backed up shard before going to sleep
+    sdata->shard_lock.unlock();
+    if (_try_steal(shard_index, hb)) {
+      return;
+    }
+    sdata->shard_lock.lock();
+    sdata->_drain_staged();
+  }
   if (sdata->scheduler->empty() &&
       (!is_smallest_thread_index || sdata->context_queue.empty())) {
     std::unique_lock wait_lock{sdata->sdata_wait_lock};
-    if (is_smallest_thread_index && !sdata->context_queue.empty()) {
-      // we raced with a context_queue addition, don't wait
+    if ((is_smallest_thread_index && !sdata->context_queue.empty()) ||
+        sdata->has_staged()) {
+      // we raced with a context_queue addition or an op being staged
+      // (_enqueue notifies under sdata_wait_lock after staging), don't wait
       wait_lock.unlock();
     } else if (!sdata->stop_waiting) {
       dout(20) << __func__ << " empty q, waiting" << dendl;
@@ -11137,6 +11260,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
       sdata->sdata_cond.wait(wait_lock);
       wait_lock.unlock();
       sdata->shard_lock.lock();
+      sdata->_drain_staged();
       if (sdata->scheduler->empty() &&
          !(is_smallest_thread_index && !sdata->context_queue.empty())) {
 	sdata->shard_lock.unlock();
@@ -11160,6 +11284,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
 
   WorkItem work_item;
   while (!std::get_if<OpSchedulerItem>(&work_item)) {
+    sdata->_drain_staged();
     if (sdata->scheduler->empty()) {
       if (osd->is_stopping()) {
         sdata->shard_lock.unlock();
@@ -11175,6 +11300,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
     }
 
     work_item = sdata->scheduler->dequeue();
+    if (std::holds_alternative<OpSchedulerItem>(work_item)) {
+      --sdata->queue_depth;
+    }
     if (osd->is_stopping()) {
       sdata->shard_lock.unlock();
       for (auto c : oncommits) {
@@ -11225,6 +11353,64 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
     return;    // OSD shutdown, discard.
   }
 
+  _process_item(sdata, std::move(item), oncommits, hb);
+}
+
+bool OSD::ShardedOpWQ::_try_steal(uint32_t shard_index, heartbeat_handle_d *hb)
+{
+  // queue depths are sampled without the shard locks, this only picks
+  // a candidate
+  const uint64_t threshold =
+    std::max<uint64_t>(1, osd->cct->_conf->osd_op_queue_steal_threshold);
+  uint32_t victim = shard_index;
+  uint64_t victim_depth = 0;
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    uint32_t s = (shard_index + i) % osd->num_shards;
+    uint64_t depth = osd->shards[s]->queue_depth.load(std::memory_order_relaxed);
+    if (depth >= threshold && depth > victim_depth) {
+      victim = s;
+      victim_depth = depth;
+    }
+  }
+  if (victim == shard_index) {
+    return false;
+  }
+
+  // the item is dequeued and run against the victim's pg slots exactly
+  // as one of its own threads would, so per-pg ordering is unchanged
+  auto& sdata = osd->shards[victim];
+  sdata->shard_lock.lock();
+  sdata->_drain_staged();
+  if (sdata->scheduler->empty() || osd->is_stopping()) {
+    sdata->shard_lock.unlock();
+    return false;
+  }
+  WorkItem work_item = sdata->scheduler->dequeue();
+  auto item = std::get_if<OpSchedulerItem>(&work_item);
+  if (!item) {
+    // nothing ready yet, the owner's threads wait for it
+    sdata->shard_lock.unlock();
+    return false;
+  }
+  --sdata->queue_depth;
+  ++sdata->num_stolen;
+  ++osd->shards[shard_index]->num_steals;
+  osd->logger->inc(l_osd_op_wq_steal);
+  dout(20) << __func__ << " shard " << shard_index << " takes " << *item
+	   << " from shard " << victim << " depth " << victim_depth << dendl;
+
+  // oncommits are left to the owner's first thread, they must stay ordered
+  list<Context*> oncommits;
+  _process_item(sdata, std::move(*item), oncommits, hb);
+  return true;
+}
+
+void OSD::ShardedOpWQ::_process_item(
+  OSDShard *sdata,
+  OpSchedulerItem&& item,
+  list<Context*>& oncommits,
+  heartbeat_handle_d *hb)
+{
   const auto token = item.get_ordering_token();
   auto r = sdata->pg_slots.emplace(token, nullptr);
   if (r.second) {
@@ -11463,10 +11649,25 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
   dout(20) << fmt::format("{} {}", __func__, item) << dendl;
 
   bool empty = true;
-  {
+  uint64_t depth = 0;
+  if (osd->cct->_conf->osd_op_queue_staging) {
+    // counted first so that a worker draining it can't take queue_depth
+    // below zero
+    depth = ++sdata->queue_depth;
+    if (sdata->stage(std::move(item))) {
+      empty = depth == 1;
+    } else {
+      --sdata->queue_depth;
+      depth = 0;
+    }
+  }
+  if (!depth) {
     std::lock_guard l{sdata->shard_lock};
+    // behind anything staged before, even if staging is full or now off
+    sdata->_drain_staged();
     empty = sdata->scheduler->empty();
     sdata->scheduler->enqueue(std::move(item));
+    depth = ++sdata->queue_depth;
   }
 
   {
@@ -11477,6 +11678,16 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
       sdata->sdata_cond.notify_one();
     }
   }
+
+  if (osd->num_shards > 1 &&
+      osd->cct->_conf->osd_op_queue_work_stealing &&
+      depth >= osd->cct->_conf->osd_op_queue_steal_threshold) {
+    // backed up: wake an idle thread of the next shard, it will look
+    // for something to steal
+    auto neighbour = osd->shards[(shard_index + 1) % osd->num_shards];
+    std::lock_guard l{neighbour->sdata_wait_lock};
+    neighbour->sdata_cond.notify_one();
+  }
 }
 
 void OSD::ShardedOpWQ::_enqueue_front(OpSchedulerItem&& item)
@@ -11507,6 +11718,7 @@ void OSD::ShardedOpWQ::_enqueue_front(OpSchedulerItem&& item)
     dout(20) << __func__ << " " << item << dendl;
   }
   sdata->scheduler->enqueue_front(std::move(item));
+  ++sdata->queue_depth;
   sdata->shard_lock.unlock();
   std::lock_guard l{sdata->sdata_wait_lock};
   sdata->sdata_cond.notify_one();
@@ -11520,9 +11732,12 @@ void OSD::ShardedOpWQ::stop_for_fast_shutdown()
     auto& sdata = osd->shards[shard_index];
     ceph_assert(sdata);
     std::lock_guard l(sdata->shard_lock);
+    while (sdata->_drain_staged()) {
+    }
     while (!sdata->scheduler->empty()) {
       sdata->scheduler->dequeue();
     }
+    sdata->queue_depth = 0;
   }
 }
 
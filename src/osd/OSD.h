@@ -38,6 +38,7 @@
 #include "include/common_fwd.h"
 
 #include "OpRequest.h"
+#include "RepOpBatcher.h"
 #include "Session.h"
 
 #include "osd/scheduler/OpScheduler.h"
@@ -48,6 +49,8 @@
 #include <string>
 #include <unordered_map>
 
+#include <boost/lockfree/queue.hpp>
+
 #include "common/intrusive_timer.h"
 #include "common/shared_cache.hpp"
 #include "common/simple_cache.hpp"
@@ -91,6 +94,7 @@ class MOSDPGCreate2;
 class MOSDPGNotify;
 class MOSDPGInfo;
 class MOSDPGRemove;
+class MOSDRepOpBatch;
 class MOSDForceRecovery;
 class MMonGetPurgedSnapsReply;
 
@@ -118,6 +122,19 @@ public:
   md_config_cacher_t<Option::size_t> osd_max_object_size;
   md_config_cacher_t<bool> osd_skip_data_digest;
 
+  RepOpBatcher repop_batcher;
+
+  /// EWMA of client op latency, in us, for the load hint on op replies
+  std::atomic<uint32_t> op_latency_us = {0};
+  void note_op_latency(const utime_t& latency) {
+    // 1/8 weight per op; racing updates may drop a sample, which is fine
+    int64_t cur = op_latency_us.load(std::memory_order_relaxed);
+    int64_t sample = std::min<int64_t>(latency.to_usec(), UINT32_MAX);
+    op_latency_us.store(cur + (sample - cur) / 8, std::memory_order_relaxed);
+  }
+  /// ops waiting in the op shards
+  uint32_t get_op_queue_depth() const;
+
   void enqueue_back(OpSchedulerItem&& qi);
   void enqueue_front(OpSchedulerItem&& qi);
   /// scheduler cost per io, only valid for mclock, asserts for wpq
@@ -235,14 +252,14 @@ public:
   void send_message_osd_cluster(int peer, Message *m, epoch_t from_epoch);
   void send_message_osd_cluster(std::vector<std::pair<int, Message*>>& messages, epoch_t from_epoch);
   void send_message_osd_cluster(MessageRef m, Connection *con) {
+    repop_batcher.flush(con);
     con->send_message2(std::move(m));
   }
   void send_message_osd_cluster(Message *m, const ConnectionRef& con) {
+    repop_batcher.flush(con.get());
     con->send_message(m);
   }
-  void send_message_osd_client(Message *m, const ConnectionRef& con) {
-    con->send_message(m);
-  }
+  void send_message_osd_client(Message *m, const ConnectionRef& con);
   entity_name_t get_cluster_msgr_name() const;
 
 
@@ -438,6 +455,13 @@ public:
   int m_objecter_finishers;
   std::vector<std::unique_ptr<Finisher>> objecter_finishers;
 
+  // -- backfill scan readahead --
+  std::vector<std::unique_ptr<Finisher>> backfill_scan_finishers;
+  Finisher* get_backfill_scan_finisher(spg_t pgid) {
+    return backfill_scan_finishers[
+      pgid.ps() % backfill_scan_finishers.size()].get();
+  }
+
   // -- Watch --
   ceph::mutex watch_lock = ceph::make_mutex("OSDService::watch_lock");
   SafeTimer watch_timer;
@@ -1030,6 +1054,31 @@ struct OSDShard {
   /// priority queue
   ceph::osd::scheduler::OpSchedulerRef scheduler;
 
+  /// an op pushed by _enqueue without shard_lock, see osd_op_queue_staging
+  struct staged_op_t {
+    OpSchedulerItem item;
+    ceph::real_time arrival;
+  };
+  const unsigned staged_max;
+  /// staged ops, moved into scheduler under shard_lock by _drain_staged()
+  boost::lockfree::queue<staged_op_t*,
+                         boost::lockfree::fixed_sized<true>> staged;
+
+  /// push item into staged, false (leaving it alone) if that is full
+  bool stage(OpSchedulerItem&& item);
+  /// move what is staged into scheduler, in order; returns how many
+  unsigned _drain_staged();
+  bool has_staged() const {
+    return !staged.empty();
+  }
+
+  /// items in scheduler and staged; changed under shard_lock or by
+  /// stage(), read without it by threads of other shards looking for
+  /// work to steal
+  std::atomic<uint64_t> queue_depth = {0};
+  std::atomic<uint64_t> num_steals = {0};  ///< items our threads took elsewhere
+  std::atomic<uint64_t> num_stolen = {0};  ///< our items run by other threads
+
   bool stop_waiting = false;
 
   ContextQueue context_queue;
@@ -1075,6 +1124,7 @@ struct OSDShard {
     OSD *osd,
     op_queue_type_t osd_op_queue,
     unsigned osd_op_queue_cut_off);
+  ~OSDShard();
 };
 
 struct OSDBenchTest {
@@ -1757,6 +1807,17 @@ protected:
       OSDShardPGSlot *slot,
       OpSchedulerItem&& qi);
 
+    /// run an item dequeued from sdata; called with shard_lock held,
+    /// returns with it released
+    void _process_item(
+      OSDShard *sdata,
+      OpSchedulerItem&& item,
+      std::list<Context*>& oncommits,
+      ceph::heartbeat_handle_d *hb);
+
+    /// run one ready item of the most backed up other shard, if any
+    bool _try_steal(uint32_t shard_index, ceph::heartbeat_handle_d *hb);
+
     /// try to do some work
     void _process(uint32_t thread_index,
                   uint32_t shard_index,
@@ -1800,6 +1861,9 @@ protected:
 	std::scoped_lock l{sdata->shard_lock};
 	f->open_object_section(queue_name);
 	sdata->scheduler->dump(*f);
+	f->dump_unsigned("queue_depth", sdata->queue_depth);
+	f->dump_unsigned("steals", sdata->num_steals);
+	f->dump_unsigned("stolen", sdata->num_stolen);
 	f->close_section();
       }
     }
@@ -1809,9 +1873,10 @@ protected:
       ceph_assert(sdata);
       std::lock_guard l(sdata->shard_lock);
       if (thread_index < osd->num_shards) {
-	return sdata->scheduler->empty() && sdata->context_queue.empty();
+	return sdata->scheduler->empty() && !sdata->has_staged() &&
+	  sdata->context_queue.empty();
       } else {
-	return sdata->scheduler->empty();
+	return sdata->scheduler->empty() && !sdata->has_staged();
       }
     }
 
@@ -2079,6 +2144,7 @@ protected:
   void handle_pg_notify_nopg(const MNotifyRec& q);
   void handle_fast_pg_info(MOSDPGInfo *m);
   void handle_fast_pg_remove(MOSDPGRemove *m);
+  void handle_fast_repop_batch(MOSDRepOpBatch *m);
 
 public:
   // used by OSDShard
@@ -2129,6 +2195,7 @@ private:
     case MSG_OSD_RECOVERY_RESERVE:
     case MSG_OSD_REPOP:
     case MSG_OSD_REPOPREPLY:
+    case MSG_OSD_REPOP_BATCH:
     case MSG_OSD_PG_PUSH:
     case MSG_OSD_PG_PULL:
     case MSG_OSD_PG_PUSH_REPLY:
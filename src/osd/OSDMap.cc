@@ -3167,17 +3167,8 @@ void OSDMap::_pg_to_up_acting_osds(
   _get_temp_osds(*pool, pg, &_acting, &_acting_primary);
   if (_acting.empty() || up || up_primary) {
     _pg_to_raw_osds(*pool, pg, &raw, &pps);
-    _apply_upmap(*pool, pg, &raw);
-    _raw_to_up_osds(*pool, raw, &_up);
-    _up_primary = _pick_primary(_up);
-    _apply_primary_affinity(pps, *pool, &_up, &_up_primary);
-    if (_acting.empty()) {
-      _acting = _up;
-      if (_acting_primary == -1) {
-        _acting_primary = _up_primary;
-      }
-    }
-  
+    _raw_to_up_acting_osds(*pool, pg, pps, &raw, &_up, &_up_primary,
+			   &_acting, &_acting_primary);
     if (up)
       up->swap(_up);
     if (up_primary)
@@ -3190,6 +3181,64 @@ void OSDMap::_pg_to_up_acting_osds(
     *acting_primary = _acting_primary;
 }
 
+void OSDMap::_raw_to_up_acting_osds(
+  const pg_pool_t& pool, pg_t pg, ps_t pps,
+  vector<int> *raw,
+  vector<int> *up, int *up_primary,
+  vector<int> *acting, int *acting_primary) const
+{
+  _apply_upmap(pool, pg, raw);
+  _raw_to_up_osds(pool, *raw, up);
+  *up_primary = _pick_primary(*up);
+  _apply_primary_affinity(pps, pool, up, up_primary);
+  if (acting->empty()) {
+    *acting = *up;
+    if (*acting_primary == -1) {
+      *acting_primary = *up_primary;
+    }
+  }
+}
+
+void OSDMap::pgs_to_up_acting_osds(
+  int64_t poolid, unsigned ps_begin, unsigned ps_end,
+  std::function<void(unsigned ps,
+		     vector<int>&& up, int up_primary,
+		     vector<int>&& acting, int acting_primary)> fn) const
+{
+  ceph_assert(ps_begin <= ps_end);
+  const pg_pool_t *pool = get_pg_pool(poolid);
+  // pgs past pg_num fold onto existing ones, as for pg_to_up_acting_osds()
+  unsigned end = pool ? ps_end : ps_begin;
+  vector<int> pps;
+  pps.reserve(end - ps_begin);
+  for (unsigned ps = ps_begin; ps < end; ++ps) {
+    pps.push_back(pool->raw_pg_to_pps(pg_t(ps, poolid)));
+  }
+  vector<vector<int>> raws;
+  int ruleno = pool ? pool->get_crush_rule() : -1;
+  if (ruleno >= 0 && !pps.empty()) {
+    crush->do_rule_batch(ruleno, pps, raws, pool->get_size(), osd_weight,
+			 poolid);
+  } else {
+    raws.resize(pps.size());
+  }
+  for (unsigned i = 0; i < pps.size(); ++i) {
+    pg_t pg(ps_begin + i, poolid);
+    auto& raw = raws[i];
+    _remove_nonexistent_osds(*pool, raw);
+    vector<int> up, acting;
+    int up_primary, acting_primary;
+    _get_temp_osds(*pool, pg, &acting, &acting_primary);
+    _raw_to_up_acting_osds(*pool, pg, pps[i], &raw, &up, &up_primary,
+			   &acting, &acting_primary);
+    fn(pg.ps(), std::move(up), up_primary, std::move(acting), acting_primary);
+  }
+  // a nonexistent pool maps to nothing
+  for (unsigned ps = end; ps < ps_end; ++ps) {
+    fn(ps, {}, -1, {}, -1);
+  }
+}
+
 int OSDMap::calc_pg_role_broken(int osd, const vector<int>& acting, int nrep)
 {
   // This implementation is broken for EC PGs since the osd may appear
@@ -5767,7 +5816,8 @@ int OSDMap::calc_pg_upmaps(
   int max,
   const set<int64_t>& only_pools,
   OSDMap::Incremental *pending_inc,
-  std::random_device::result_type *p_seed)
+  std::random_device::result_type *p_seed,
+  upmap_state_t *p_state)
 {
   ldout(cct, 10) << __func__ << " pools " << only_pools << dendl;
   OSDMap tmp_osd_map;
@@ -5776,35 +5826,47 @@ int OSDMap::calc_pg_upmaps(
     max_deviation = 1;
   tmp_osd_map.deepish_copy_from(*this);
   int num_changed = 0;
-  map<int,set<pg_t>> pgs_by_osd;
-  int total_pgs = 0;
-  float osd_weight_total = 0;
-  map<int,float> osd_weight;
 
   if (max <= 0) {
     lderr(cct) << __func__ << " abort due to max <= 0" << dendl;
     return 0;
   }
 
-  osd_weight_total = build_pool_pgs_info(cct, only_pools, tmp_osd_map, 
-                                         total_pgs, pgs_by_osd, osd_weight);
-  if (osd_weight_total == 0) {
-    lderr(cct) << __func__ << " abort due to osd_weight_total == 0" << dendl;
-    return 0;
-  }
-
-  float pgs_per_weight = total_pgs / osd_weight_total;
-  ldout(cct, 10) << " osd_weight_total " << osd_weight_total << dendl;
+  upmap_state_t local_state;
+  upmap_state_t& st = p_state ? *p_state : local_state;
+  if (st.is_valid(get_epoch(), only_pools)) {
+    ldout(cct, 10) << " reusing state from e" << st.epoch << dendl;
+    ceph_assert(st.trial.empty());
+    st.epoch = get_epoch();
+    st.pending = false;
+  } else {
+    st = upmap_state_t();
+    st.osd_weight_total = build_pool_pgs_info(cct, only_pools, tmp_osd_map,
+                                              st.total_pgs, st.pgs_by_osd,
+                                              st.osd_weight);
+    if (st.osd_weight_total == 0) {
+      lderr(cct) << __func__ << " abort due to osd_weight_total == 0" << dendl;
+      return 0;
+    }
+    st.pgs_per_weight = st.total_pgs / st.osd_weight_total;
+    st.max_deviation = calc_deviations(cct, st.pgs_by_osd, st.osd_weight,
+                                       st.pgs_per_weight, st.osd_deviation,
+                                       st.deviation_osd, st.stddev);
+    st.pools = only_pools;
+    st.epoch = get_epoch();
+  }
+  st.next_epoch = pending_inc->epoch;
+  auto& pgs_by_osd = st.pgs_by_osd;
+  auto& osd_weight = st.osd_weight;
+  auto& osd_deviation = st.osd_deviation;
+  auto& deviation_osd = st.deviation_osd;
+  float& stddev = st.stddev;
+  const float pgs_per_weight = st.pgs_per_weight;
+  ldout(cct, 10) << " osd_weight_total " << st.osd_weight_total << dendl;
   ldout(cct, 10) << " pgs_per_weight " << pgs_per_weight << dendl;
 
-  float stddev = 0;
-  map<int,float> osd_deviation;       // osd, deviation(pgs)
-  multimap<float,int> deviation_osd;  // deviation(pgs), osd
-  float cur_max_deviation = calc_deviations(cct, pgs_by_osd, osd_weight, pgs_per_weight,
-				      	    osd_deviation, deviation_osd, stddev);
-
-  ldout(cct, 20) << " stdev " << stddev << " max_deviation " << cur_max_deviation << dendl;
-  if (cur_max_deviation <= max_deviation) {
+  ldout(cct, 20) << " stdev " << stddev << " max_deviation " << st.max_deviation << dendl;
+  if (st.max_deviation <= max_deviation) {
     ldout(cct, 10) << __func__ << " distribution is almost perfect"
                    << dendl;
     return 0;
@@ -5855,7 +5917,8 @@ int OSDMap::calc_pg_upmaps(
 
     set<pg_t> to_unmap;
     map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>> to_upmap;
-    auto temp_pgs_by_osd = pgs_by_osd;
+    // forget whatever the previous attempt tried
+    st.rollback();
     // always start with fullest, break if we find any changes to make
     for (auto p = deviation_osd.rbegin(); p != deviation_osd.rend(); ++p) {
       if (skip_overfull && !underfull.empty()) {
@@ -5904,7 +5967,7 @@ int OSDMap::calc_pg_upmaps(
       }
       // look for remaps we can un-remap
       if (try_drop_remap_overfull(cct, pgs, tmp_osd_map, osd,
-				  temp_pgs_by_osd, to_unmap, to_upmap, osd_deviation))
+				  st, to_unmap, to_upmap, osd_deviation))
 	goto test_change;
 
       // try upmap
@@ -5962,7 +6025,7 @@ int OSDMap::calc_pg_upmaps(
           // definitely make distribution of PGs converging to
           // the perfect status.
 	  add_remap_pair(cct, orig[pos], out[pos], pg, (size_t)pg_pool_size, 
-	  		 osd, existing, temp_pgs_by_osd,
+	  		 osd, existing, st,
 			 new_upmap_items, to_upmap);
           goto test_change;
 	}
@@ -6000,7 +6063,7 @@ int OSDMap::calc_pg_upmaps(
       // look for remaps we can un-remap
       candidates_t candidates = build_candidates(cct, tmp_osd_map, to_skip,
       						 only_pools, aggressive, p_seed);
-      if (try_drop_remap_underfull(cct, candidates, osd, temp_pgs_by_osd,
+      if (try_drop_remap_underfull(cct, candidates, osd, st,
           to_unmap, to_upmap)) {
 	goto test_change;
       }
@@ -6029,11 +6092,7 @@ int OSDMap::calc_pg_upmaps(
     // test change, apply if change is good
     ceph_assert(to_unmap.size() || to_upmap.size());
     float new_stddev = 0;
-    map<int,float> temp_osd_deviation;
-    multimap<float,int> temp_deviation_osd;
-    float cur_max_deviation = calc_deviations(cct, temp_pgs_by_osd, osd_weight,
-    					      pgs_per_weight, temp_osd_deviation,
-					      temp_deviation_osd, new_stddev);
+    float cur_max_deviation = st.calc_trial_deviation(&new_stddev);
     ldout(cct, 10) << " stddev " << stddev << " -> " << new_stddev << dendl;
     if (new_stddev >= stddev) {
       if (!aggressive) {
@@ -6065,10 +6124,7 @@ int OSDMap::calc_pg_upmaps(
 
     // ready to go
     ceph_assert(new_stddev < stddev);
-    stddev = new_stddev;
-    pgs_by_osd = temp_pgs_by_osd;
-    osd_deviation = temp_osd_deviation;
-    deviation_osd = temp_deviation_osd;
+    st.commit(new_stddev, cur_max_deviation);
     n_changes++;
 
 
@@ -6081,10 +6137,94 @@ int OSDMap::calc_pg_upmaps(
       break;
     }
   }
+  st.rollback();
+  // only describes the map once pending_inc is applied
+  st.pending = num_changed > 0;
   ldout(cct, 10) << " num_changed = " << num_changed << dendl;
   return num_changed;
 }
 
+void OSDMap::upmap_state_t::move_pg(pg_t pg, int from, int to)
+{
+  auto entry = [&](int osd) -> set<pg_t>& {
+    auto p = pgs_by_osd.find(osd);
+    if (p == pgs_by_osd.end()) {
+      // the entry operator[] would add, dropped again on rollback
+      p = pgs_by_osd.emplace(osd, set<pg_t>()).first;
+      trial.push_back({osd, pg, false, true});
+    }
+    return p->second;
+  };
+  if (entry(from).erase(pg)) {
+    trial.push_back({from, pg, false, false});
+  }
+  if (entry(to).insert(pg).second) {
+    trial.push_back({to, pg, true, false});
+  }
+}
+
+void OSDMap::upmap_state_t::rollback()
+{
+  for (auto op = trial.rbegin(); op != trial.rend(); ++op) {
+    auto p = pgs_by_osd.find(op->osd);
+    ceph_assert(p != pgs_by_osd.end());
+    if (op->created) {
+      ceph_assert(p->second.empty());
+      pgs_by_osd.erase(p);
+    } else if (op->insert) {
+      p->second.erase(op->pg);
+    } else {
+      p->second.insert(op->pg);
+    }
+  }
+  trial.clear();
+}
+
+float OSDMap::upmap_state_t::calc_trial_deviation(float *new_stddev) const
+{
+  // same walk as calc_deviations, so the result is bit for bit the same
+  float cur_max_deviation = 0.0;
+  *new_stddev = 0.0;
+  for (auto& [oid, opgs] : pgs_by_osd) {
+    ceph_assert(osd_weight.count(oid));
+    float target = osd_weight.at(oid) * pgs_per_weight;
+    float deviation = (float)opgs.size() - target;
+    *new_stddev += deviation * deviation;
+    if (fabsf(deviation) > cur_max_deviation)
+      cur_max_deviation = fabsf(deviation);
+  }
+  return cur_max_deviation;
+}
+
+void OSDMap::upmap_state_t::commit(float new_stddev, float new_max_deviation)
+{
+  set<int> touched;
+  for (auto& op : trial) {
+    touched.insert(op.osd);
+  }
+  trial.clear();
+  for (auto osd : touched) {
+    auto p = osd_deviation.find(osd);
+    if (p != osd_deviation.end()) {
+      auto r = deviation_osd.equal_range(p->second);
+      auto q = std::find_if(r.first, r.second,
+                            [osd](auto& i) { return i.second == osd; });
+      ceph_assert(q != r.second);
+      deviation_osd.erase(q);
+    }
+    float deviation = (float)pgs_by_osd.at(osd).size() -
+      osd_weight.at(osd) * pgs_per_weight;
+    osd_deviation[osd] = deviation;
+    // calc_deviations inserts in osd order, keep ties that way
+    auto r = deviation_osd.equal_range(deviation);
+    auto q = std::find_if(r.first, r.second,
+                          [osd](auto& i) { return i.second > osd; });
+    deviation_osd.emplace_hint(q, deviation, osd);
+  }
+  stddev = new_stddev;
+  max_deviation = new_max_deviation;
+}
+
 map<uint64_t,set<pg_t>> OSDMap::get_pgs_by_osd(
     CephContext *cct,
     int64_t pid,
@@ -6353,15 +6493,15 @@ bool OSDMap::try_drop_remap_overfull(
   const std::vector<pg_t>& pgs,
   const OSDMap& tmp_osd_map,
   int osd,
-  map<int,std::set<pg_t>>& temp_pgs_by_osd,
+  upmap_state_t& state,
   set<pg_t>& to_unmap,
   map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>>& to_upmap,
   const map<int,float>& osd_deviation)
 {
   //
   // This function tries to drop existimg upmap items which map data to overfull 
-  // OSDs. It updates temp_pgs_by_osd, to_unmap and to_upmap and rerturns true 
-  // if it found an item that can be dropped, false if not. 
+  // OSDs. It tries the moves on state, updates to_unmap and to_upmap and
+  // rerturns true if it found an item that can be dropped, false if not.
   //
   const float osd_dev = osd_deviation.at(osd);
   for (auto pg : pgs) {
@@ -6382,8 +6522,7 @@ bool OSDMap::try_drop_remap_overfull(
                        << " which remapped " << pg
                        << " into overfull osd." << osd
                        << dendl;
-        temp_pgs_by_osd[um_to].erase(pg);
-        temp_pgs_by_osd[um_from].insert(pg);
+        state.move_pg(pg, um_to, um_from);
         } else {
           new_upmap_items.push_back(um_pair);
         }
@@ -6414,14 +6553,14 @@ bool OSDMap::try_drop_remap_underfull(
     CephContext *cct,
     const candidates_t& candidates,
     int osd,
-    map<int,std::set<pg_t>>& temp_pgs_by_osd,
+    upmap_state_t& state,
     set<pg_t>& to_unmap,
     map<pg_t, mempool::osdmap::vector<std::pair<int32_t,int32_t>>>& to_upmap)
 {
   // 
   // This function tries to drop existimg upmap items which map data from underfull
-  // OSDs. It updates temp_pgs_by_osd, to_unmap and to_upmap and rerturns true 
-  // if it found an item that can be dropped, false if not. 
+  // OSDs. It tries the moves on state, updates to_unmap and to_upmap and
+  // rerturns true if it found an item that can be dropped, false if not.
   //
   for (auto& [pg, um_pairs] : candidates) {
     mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
@@ -6435,8 +6574,7 @@ bool OSDMap::try_drop_remap_underfull(
                        << " which remapped " << pg
                        << " out from underfull osd." << osd
                        << dendl;
-        temp_pgs_by_osd[um_to].erase(pg);
-        temp_pgs_by_osd[um_from].insert(pg);
+        state.move_pg(pg, um_to, um_from);
       } else {
         new_upmap_items.push_back(ump);
       }
@@ -6473,7 +6611,7 @@ void OSDMap::add_remap_pair(
   size_t pg_pool_size,
   int osd,
   set<int>& existing,
-  map<int,set<pg_t>>& temp_pgs_by_osd,
+  upmap_state_t& state,
   mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items,
   map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>>& to_upmap) 
 {
@@ -6487,8 +6625,7 @@ void OSDMap::add_remap_pair(
                  << dendl;
   existing.insert(orig);
   existing.insert(out);
-  temp_pgs_by_osd[orig].erase(pg);
-  temp_pgs_by_osd[out].insert(pg);
+  state.move_pg(pg, orig, out);
   ceph_assert(new_upmap_items.size() < pg_pool_size);
   new_upmap_items.push_back(make_pair(orig, out));
   // append new remapping pairs slowly
@@ -6504,7 +6641,7 @@ int OSDMap::find_best_remap (
   const vector<int>& orig,
   const vector<int>& out,
   const set<int>& existing,
-  const map<int,float> osd_deviation) 
+  const map<int,float>& osd_deviation)
 {
   //
   // Find the best remap from the suggestions in orig and out - the best remap 
@@ -6530,7 +6667,7 @@ int OSDMap::find_best_remap (
 OSDMap::candidates_t OSDMap::build_candidates(
   CephContext *cct,
   const OSDMap& tmp_osd_map,
-  const set<pg_t> to_skip,
+  const set<pg_t>& to_skip,
   const set<int64_t>& only_pools,
   bool aggressive,
   std::random_device::result_type *p_seed)
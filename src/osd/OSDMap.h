@@ -31,6 +31,7 @@
 #include <map>
 #include <memory>
 #include <random>
+#include <functional>
 
 #include "include/btree_map.h"
 #include "include/common_fwd.h"
@@ -684,6 +685,7 @@ private:
   uint32_t crush_version = 1;
 
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -1282,6 +1284,12 @@ private:
   void _pg_to_up_acting_osds(const pg_t& pg, std::vector<int> *up, int *up_primary,
                              std::vector<int> *acting, int *acting_primary,
 			     bool raw_pg_to_pg = true) const;
+  /// raw (crush) osds -> up, and acting unless a pg_temp already set it
+  void _raw_to_up_acting_osds(const pg_pool_t& pool, pg_t pg, ps_t pps,
+			      std::vector<int> *raw,
+			      std::vector<int> *up, int *up_primary,
+			      std::vector<int> *acting,
+			      int *acting_primary) const;
 
 public:
   /***
@@ -1321,6 +1329,17 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /**
+   * pg_to_up_acting_osds() for pgs [ps_begin, ps_end) of a pool, with
+   * the crush mappings of the whole range computed in one batch. fn is
+   * called for each pg in order; like pg_to_up_acting_osds(), pgs past
+   * pg_num are mapped as the pgs they fold onto.
+   */
+  void pgs_to_up_acting_osds(
+    int64_t pool, unsigned ps_begin, unsigned ps_end,
+    std::function<void(unsigned ps,
+		       std::vector<int>&& up, int up_primary,
+		       std::vector<int>&& acting, int acting_primary)> fn) const;
   bool pg_is_ec(pg_t pg) const {
     auto i = pools.find(pg.pool());
     ceph_assert(i != pools.end());
@@ -1558,13 +1577,62 @@ public:
   float calc_desired_prims_for_osdsizeopt(int npgs, int forced_primaries, int forced_secondaries,
                                           int iops_per_osd, int write_ratio) const;
 
+  /**
+   * What calc_pg_upmaps knows about the pgs of a set of pools: the osds
+   * they map to and how far each osd is from its target.  It is kept up
+   * to date as upmap items are added or dropped, so handing the same state
+   * to the next call for the same pools skips rebuilding it.  Once a call
+   * has added upmap items, the state describes the map with that call's
+   * pending incremental applied, and is only reused at its epoch; until
+   * then it is also reused on the map it was last brought up to.  Any
+   * other epoch rebuilds it.
+   */
+  struct upmap_state_t {
+    std::set<int64_t> pools;
+    epoch_t epoch = 0;       ///< map epoch the state was built or reused at
+    epoch_t next_epoch = 0;  ///< epoch of the last call's pending_inc
+    bool pending = false;    ///< holds moves only the map at next_epoch has
+    int total_pgs = 0;
+    float osd_weight_total = 0;
+    float pgs_per_weight = 0;
+    std::map<int,float> osd_weight;
+    std::map<int,std::set<pg_t>> pgs_by_osd;
+    std::map<int,float> osd_deviation;       ///< osd, deviation(pgs)
+    std::multimap<float,int> deviation_osd;  ///< deviation(pgs), osd
+    float stddev = 0;
+    float max_deviation = 0;
+
+    /// pgs_by_osd changes of the remap being tried, so it can be undone
+    struct trial_op_t {
+      int osd;
+      pg_t pg;
+      bool insert;   ///< pg was added to osd, else removed
+      bool created;  ///< osd had no entry before
+    };
+    std::vector<trial_op_t> trial;
+
+    bool is_valid(epoch_t e, const std::set<int64_t>& p) const {
+      return epoch && pools == p &&
+        (e == next_epoch || (e == epoch && !pending));
+    }
+    /// try moving pg from one osd to another
+    void move_pg(pg_t pg, int from, int to);
+    /// undo the moves tried since the last commit
+    void rollback();
+    /// deviation of the state with the tried moves, as calc_deviations
+    float calc_trial_deviation(float *new_stddev) const;
+    /// keep the tried moves, updating the deviations of the osds they touched
+    void commit(float new_stddev, float new_max_deviation);
+  };
+
   int calc_pg_upmaps(
     CephContext *cct,
     uint32_t max_deviation, ///< max deviation from target (value >= 1)
     int max_iterations,  ///< max iterations to run
     const std::set<int64_t>& pools,        ///< [optional] restrict to pool
     Incremental *pending_inc,
-    std::random_device::result_type *p_seed = nullptr  ///< [optional] for regression tests
+    std::random_device::result_type *p_seed = nullptr,  ///< [optional] for regression tests
+    upmap_state_t *p_state = nullptr  ///< [optional] kept between calls
     );
 
   std::map<uint64_t,std::set<pg_t>> get_pgs_by_osd(
@@ -1630,7 +1698,7 @@ private: // Bunch of internal functions used only by calc_pg_upmaps (result of c
     const std::vector<pg_t>& pgs,
     const OSDMap& tmp_osd_map,
     int osd,
-    std::map<int,std::set<pg_t>>& temp_pgs_by_osd,
+    upmap_state_t& state,
     std::set<pg_t>& to_unmap,
     std::map<pg_t, mempool::osdmap::vector<std::pair<int32_t,int32_t>>>& to_upmap,
     const std::map<int,float>& osd_deviation
@@ -1643,7 +1711,7 @@ bool try_drop_remap_underfull(
     CephContext *cct,
     const candidates_t& candidates,
     int osd,
-    std::map<int,std::set<pg_t>>& temp_pgs_by_osd,
+    upmap_state_t& state,
     std::set<pg_t>& to_unmap,
     std::map<pg_t, mempool::osdmap::vector<std::pair<int32_t,int32_t>>>& to_upmap
   );
@@ -1656,7 +1724,7 @@ bool try_drop_remap_underfull(
     size_t pg_pool_size,
     int osd,
     std::set<int>& existing,
-    std::map<int,std::set<pg_t>>& temp_pgs_by_osd,
+    upmap_state_t& state,
     mempool::osdmap::vector<std::pair<int32_t,int32_t>> new_upmap_items,
     std::map<pg_t, mempool::osdmap::vector<std::pair<int32_t,int32_t>>>& to_upmap
   );
@@ -1666,13 +1734,13 @@ bool try_drop_remap_underfull(
     const std::vector<int>& orig,
     const std::vector<int>& out,
     const std::set<int>& existing,
-    const std::map<int,float> osd_deviation
+    const std::map<int,float>& osd_deviation
   );
 
   candidates_t build_candidates(
     CephContext *cct,
     const OSDMap& tmp_osd_map,
-    const std::set<pg_t> to_skip,
+    const std::set<pg_t>& to_skip,
     const std::set<int64_t>& only_pools,
     bool aggressive,
     std::random_device::result_type *p_seed
@@ -33,13 +33,15 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
 	q = pools.erase(q);
       } else {
 	// keep it
+	q->second.set_params(p.second);
 	++q;
 	continue;
       }
     }
-    pools.emplace(p.first, PoolMapping(p.second.get_size(),
-				       p.second.get_pg_num(),
-				       p.second.is_erasure()));
+    auto r = pools.emplace(p.first, PoolMapping(p.second.get_size(),
+						p.second.get_pg_num(),
+						p.second.is_erasure()));
+    r.first->second.set_params(p.second);
   }
   pools.erase(q, pools.end());
   ceph_assert(pools.size() == osdmap.get_pools().size());
@@ -60,6 +62,228 @@ void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
+bool OSDMapMapping::update(const OSDMap& osdmap,
+			   const OSDMap::Incremental& inc)
+{
+  vector<pg_t> pgs;
+  if (!_get_affected_pgs(osdmap, inc, &pgs)) {
+    update(osdmap);
+    return false;
+  }
+  _start(osdmap);
+  _update_pgs(osdmap, pgs);
+  _finish(osdmap);
+  return true;
+}
+
+std::unique_ptr<OSDMapMapping::MappingJob> OSDMapMapping::start_update(
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  ParallelPGMapper& mapper,
+  unsigned pgs_per_item)
+{
+  vector<pg_t> pgs;
+  if (!_get_affected_pgs(osdmap, inc, &pgs)) {
+    return start_update(osdmap, mapper, pgs_per_item);
+  }
+  std::unique_ptr<MappingJob> job(new MappingJob(&osdmap, this));
+  if (pgs.empty()) {
+    // nothing moved, we only need to catch up with the epoch
+    job->complete();
+  } else {
+    mapper.queue(job.get(), pgs_per_item, pgs);
+  }
+  return job;
+}
+
+// can a pg of a pool using this rule be mapped to osd by crush?
+static bool rule_reaches(const CrushWrapper& crush, int ruleno, int osd)
+{
+  if (ruleno < 0 || !crush.rule_exists(ruleno)) {
+    return false;
+  }
+  for (int step = 0; step < crush.get_rule_len(ruleno); ++step) {
+    if (crush.get_rule_op(ruleno, step) == CRUSH_RULE_TAKE &&
+	crush.subtree_contains(crush.get_rule_arg1(ruleno, step), osd)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool OSDMapMapping::_get_affected_pgs(
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  vector<pg_t> *pgs) const
+{
+  if (epoch == 0 ||
+      epoch + 1 != osdmap.get_epoch() ||
+      inc.epoch != osdmap.get_epoch()) {
+    return false;
+  }
+  // anything that can move pgs around wholesale
+  if (inc.fullmap.length() ||
+      inc.crush.length() ||
+      inc.new_max_osd >= 0) {
+    return false;
+  }
+
+  // pools that are new or changed in a way that affects placement
+  std::set<int64_t> whole_pools;
+  for (auto& [poolid, pi] : osdmap.get_pools()) {
+    auto p = pools.find(poolid);
+    if (p == pools.end() || !p->second.same_params(pi)) {
+      whole_pools.insert(poolid);
+    }
+  }
+
+  // osds whose change can alter crush's choice (up, in, exists), and
+  // osds whose change only matters to the pgs already mapped to them
+  // (down, primary affinity)
+  std::set<int> remapped, touched;
+  for (auto& [osd, state] : inc.new_state) {
+    int s = state ? state : CEPH_OSD_UP;
+    if ((s & CEPH_OSD_EXISTS) ||
+	((s & CEPH_OSD_UP) && osdmap.is_up(osd))) {
+      remapped.insert(osd);
+    } else if (s & CEPH_OSD_UP) {
+      touched.insert(osd);
+    }
+  }
+  for (auto& p : inc.new_up_client) {
+    remapped.insert(p.first);
+  }
+  for (auto& p : inc.new_weight) {
+    remapped.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_affinity) {
+    touched.insert(p.first);
+  }
+  for (auto osd : remapped) {
+    for (auto& [poolid, pi] : osdmap.get_pools()) {
+      if (!whole_pools.count(poolid) &&
+	  rule_reaches(*osdmap.crush, pi.get_crush_rule(), osd)) {
+	whole_pools.insert(poolid);
+      }
+    }
+  }
+  touched.insert(remapped.begin(), remapped.end());
+
+  std::set<pg_t> affected;
+  auto add = [&](pg_t pgid) {
+    auto pi = osdmap.get_pg_pool(pgid.pool());
+    if (pi && pgid.ps() < pi->get_pg_num() &&
+	!whole_pools.count(pgid.pool())) {
+      affected.insert(pgid);
+    }
+  };
+
+  // explicit per-pg changes
+  for (auto& p : inc.new_pg_temp) {
+    add(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    add(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    add(p.first);
+  }
+  for (auto pgid : inc.old_pg_upmap) {
+    add(pgid);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    add(p.first);
+  }
+  for (auto pgid : inc.old_pg_upmap_items) {
+    add(pgid);
+  }
+  for (auto& p : inc.new_pg_upmap_primary) {
+    add(p.first);
+  }
+  for (auto pgid : inc.old_pg_upmap_primary) {
+    add(pgid);
+  }
+
+  if (!touched.empty()) {
+    // pgs acting on the osd, which covers the up set unless there is
+    // a pg_temp
+    for (auto osd : touched) {
+      if (osd >= 0 && osd < (int)acting_rmap.size()) {
+	for (auto pgid : acting_rmap[osd]) {
+	  add(pgid);
+	}
+      }
+    }
+    auto any_touched = [&](auto& osds) {
+      for (auto osd : osds) {
+	if (touched.count(osd)) {
+	  return true;
+	}
+      }
+      return false;
+    };
+    vector<int> up;
+    for (auto p = osdmap.pg_temp->begin(); p != osdmap.pg_temp->end(); ++p) {
+      pg_t pgid = p->first;
+      auto q = pools.find(pgid.pool());
+      if (q == pools.end() || pgid.ps() >= q->second.pg_num) {
+	continue;
+      }
+      q->second.get(pgid.ps(), &up, nullptr, nullptr, nullptr);
+      if (any_touched(p->second) || any_touched(up)) {
+	add(pgid);
+      }
+    }
+    // upmap targets are checked against the osd weights
+    for (auto& [pgid, osds] : osdmap.pg_upmap) {
+      if (any_touched(osds)) {
+	add(pgid);
+      }
+    }
+    for (auto& [pgid, items] : osdmap.pg_upmap_items) {
+      for (auto& [from, to] : items) {
+	if (touched.count(from) || touched.count(to)) {
+	  add(pgid);
+	  break;
+	}
+      }
+    }
+    for (auto& [pgid, osd] : osdmap.pg_upmap_primaries) {
+      if (touched.count(osd)) {
+	add(pgid);
+      }
+    }
+  }
+
+  uint64_t num = affected.size(), total = 0;
+  for (auto& [poolid, pi] : osdmap.get_pools()) {
+    total += pi.get_pg_num();
+    if (whole_pools.count(poolid)) {
+      num += pi.get_pg_num();
+    }
+  }
+  if (num >= total) {
+    // everything may have moved, the full update walks pools as ranges
+    return false;
+  }
+
+  pgs->clear();
+  pgs->reserve(num);
+  auto a = affected.begin();
+  for (auto& [poolid, pi] : osdmap.get_pools()) {
+    if (whole_pools.count(poolid)) {
+      for (unsigned ps = 0; ps < pi.get_pg_num(); ++ps) {
+	pgs->emplace_back(ps, poolid);
+      }
+    }
+    for (; a != affected.end() && a->pool() == poolid; ++a) {
+      pgs->push_back(*a);
+    }
+  }
+  ceph_assert(a == affected.end());
+  return true;
+}
+
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 {
   acting_rmap.resize(osdmap.get_max_osd());
@@ -115,14 +339,28 @@ void OSDMapMapping::_update_range(
   ceph_assert(i != pools.end());
   ceph_assert(pg_begin <= pg_end);
   ceph_assert(pg_end <= i->second.pg_num);
-  for (unsigned ps = pg_begin; ps < pg_end; ++ps) {
-    std::vector<int> up, acting;
-    int up_primary, acting_primary;
-    osdmap.pg_to_up_acting_osds(
-      pg_t(ps, pool),
-      &up, &up_primary, &acting, &acting_primary);
-    i->second.set(ps, std::move(up), up_primary,
-		  std::move(acting), acting_primary);
+  osdmap.pgs_to_up_acting_osds(
+    pool, pg_begin, pg_end,
+    [&](unsigned ps, std::vector<int>&& up, int up_primary,
+	std::vector<int>&& acting, int acting_primary) {
+      i->second.set(ps, std::move(up), up_primary,
+		    std::move(acting), acting_primary);
+    });
+}
+
+void OSDMapMapping::_update_pgs(
+  const OSDMap& osdmap,
+  const vector<pg_t>& pgs)
+{
+  for (auto p = pgs.begin(); p != pgs.end(); ) {
+    auto q = p + 1;
+    while (q != pgs.end() &&
+	   q->pool() == p->pool() &&
+	   q->ps() == (q - 1)->ps() + 1) {
+      ++q;
+    }
+    _update_range(osdmap, p->pool(), p->ps(), (q - 1)->ps() + 1);
+    p = q;
   }
 }
 
@@ -9,12 +9,11 @@
 #include <map>
 
 #include "osd/osd_types.h"
+#include "osd/OSDMap.h"
 #include "common/WorkQueue.h"
 #include "common/Clock.h" // for ceph_clock_now()
 #include "common/Cond.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -186,6 +185,31 @@ private:
     bool erasure = false;
     mempool::osdmap_mapping::vector<int32_t> table;
 
+    // the rest of the pool the raw mapping depends on
+    unsigned pgp_num = 0;
+    int crush_rule = -1;
+    uint64_t flags = 0;
+    shard_id_set nonprimary_shards;
+
+    static constexpr uint64_t MAPPING_FLAGS =
+      pg_pool_t::FLAG_HASHPSPOOL | pg_pool_t::FLAG_EC_OPTIMIZATIONS;
+
+    void set_params(const pg_pool_t& pi) {
+      pgp_num = pi.get_pgp_num();
+      crush_rule = pi.get_crush_rule();
+      flags = pi.get_flags() & MAPPING_FLAGS;
+      nonprimary_shards = pi.nonprimary_shards;
+    }
+    bool same_params(const pg_pool_t& pi) const {
+      return size == pi.get_size() &&
+	pg_num == pi.get_pg_num() &&
+	erasure == pi.is_erasure() &&
+	pgp_num == pi.get_pgp_num() &&
+	crush_rule == pi.get_crush_rule() &&
+	flags == (pi.get_flags() & MAPPING_FLAGS) &&
+	nonprimary_shards == pi.nonprimary_shards;
+    }
+
     size_t row_size() const {
       return
 	1 + // acting_primary
@@ -263,6 +287,14 @@ private:
     const OSDMap& map,
     int64_t pool,
     unsigned pg_begin, unsigned pg_end);
+  /// pgs must be sorted; runs of consecutive pgs are mapped as a range
+  void _update_pgs(const OSDMap& map, const std::vector<pg_t>& pgs);
+
+  /// pgs whose mapping inc may have changed, or false if we can't tell
+  bool _get_affected_pgs(
+    const OSDMap& map,
+    const OSDMap::Incremental& inc,
+    std::vector<pg_t> *pgs) const;
 
   void _build_rmap(const OSDMap& osdmap);
 
@@ -281,7 +313,9 @@ private:
       : Job(osdmap), mapping(m) {
       mapping->_start(*osdmap);
     }
-    void process(const std::vector<pg_t>& pgs) override {}
+    void process(const std::vector<pg_t>& pgs) override {
+      mapping->_update_pgs(*osdmap, pgs);
+    }
     void process(int64_t pool, unsigned ps_begin, unsigned ps_end) override {
       mapping->_update_range(*osdmap, pool, ps_begin, ps_end);
     }
@@ -334,6 +368,11 @@ public:
 
   void update(const OSDMap& map, pg_t pgid);
 
+  /// bring a mapping of the previous epoch up to date with map, which
+  /// is that epoch with inc applied.  returns false if everything had
+  /// to be recomputed.
+  bool update(const OSDMap& map, const OSDMap::Incremental& inc);
+
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
     ParallelPGMapper& mapper,
@@ -343,6 +382,14 @@ public:
     return job;
   }
 
+  /// like the above, but only remap the pgs inc may have moved if
+  /// we are at the epoch right before it
+  std::unique_ptr<MappingJob> start_update(
+    const OSDMap& map,
+    const OSDMap::Incremental& inc,
+    ParallelPGMapper& mapper,
+    unsigned pgs_per_item);
+
   epoch_t get_epoch() const {
     return epoch;
   }
@@ -627,6 +627,27 @@ int PGBackend::objects_list_partial(
   int max,
   vector<hobject_t> *ls,
   hobject_t *next)
+{
+  int r = list_partial(
+    store, ch, get_parent()->whoami_shard().shard,
+    HAVE_FEATURE(parent->min_upacting_features(), OSD_FIXED_COLLECTION_LIST),
+    begin, min, max, ls, next);
+  if (r != 0) {
+    derr << __func__ << " list collection " << ch << " got: " << cpp_strerror(r) << dendl;
+  }
+  return r;
+}
+
+int PGBackend::list_partial(
+  ObjectStore *store,
+  ObjectStore::CollectionHandle &ch,
+  shard_id_t shard,
+  bool fixed_collection_list,
+  const hobject_t &begin,
+  int min,
+  int max,
+  vector<hobject_t> *ls,
+  hobject_t *next)
 {
   ceph_assert(ls);
   // Starts with the smallest generation to make sure the result list
@@ -634,7 +655,7 @@ int PGBackend::objects_list_partial(
   // though, which would be filtered).
   ghobject_t _next;
   if (!begin.is_min())
-    _next = ghobject_t(begin, 0, get_parent()->whoami_shard().shard);
+    _next = ghobject_t(begin, 0, shard);
   ls->reserve(max);
   int r = 0;
 
@@ -643,8 +664,7 @@ int PGBackend::objects_list_partial(
 
   while (!_next.is_max() && ls->size() < (unsigned)min) {
     vector<ghobject_t> objects;
-    if (HAVE_FEATURE(parent->min_upacting_features(),
-                     OSD_FIXED_COLLECTION_LIST)) {
+    if (fixed_collection_list) {
       r = store->collection_list(
         ch,
         _next,
@@ -662,7 +682,6 @@ int PGBackend::objects_list_partial(
         &_next);
     }
     if (r != 0) {
-      derr << __func__ << " list collection " << ch << " got: " << cpp_strerror(r) << dendl;
       break;
     }
     for (vector<ghobject_t>::iterator i = objects.begin();
@@ -626,6 +626,18 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
      std::vector<hobject_t> *ls,
      hobject_t *next);
 
+   /// objects_list_partial() on explicit arguments, safe without the pg lock
+   static int list_partial(
+     ObjectStore *store,
+     ObjectStore::CollectionHandle &ch,
+     shard_id_t shard,
+     bool fixed_collection_list,
+     const hobject_t &begin,
+     int min,
+     int max,
+     std::vector<hobject_t> *ls,
+     hobject_t *next);
+
    int objects_list_range(
      const hobject_t &start,
      const hobject_t &end,
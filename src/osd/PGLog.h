@@ -23,6 +23,7 @@
 #include "include/ceph_assert.h"
 #include "include/common_fwd.h"
 #include "osd_types.h"
+#include "ReqIdIndex.h"
 #include "os/ObjectStore.h"
 
 #include <iosfwd>
@@ -170,9 +171,9 @@ public:
    */
   struct IndexedLog : public pg_log_t {
     mutable std::unordered_map<hobject_t, pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable std::unordered_map<osd_reqid_t, pg_log_entry_t*> caller_ops;
+    mutable ReqIdIndex<pg_log_entry_t> caller_ops;
     mutable std::unordered_multimap<osd_reqid_t, pg_log_entry_t*> extra_caller_ops;
-    mutable std::unordered_map<osd_reqid_t, pg_log_dup_t*> dup_index;
+    mutable ReqIdIndex<pg_log_dup_t> dup_index;
 
     // recovery pointers
     std::list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -414,12 +415,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      auto p = caller_ops.find(r);
-      if (p != caller_ops.end()) {
-	*version = p->second->version;
-	*user_version = p->second->user_version;
-	*return_code = p->second->return_code;
-	*op_returns = p->second->op_returns;
+      if (auto e = caller_ops.find(r); e) {
+	*version = e->version;
+	*user_version = e->user_version;
+	*return_code = e->return_code;
+	*op_returns = e->op_returns;
 	return true;
       }
 
@@ -428,7 +428,7 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
+      auto p = extra_caller_ops.find(r);
       if (p != extra_caller_ops.end()) {
 	uint32_t idx = 0;
 	for (auto i = p->second->extra_reqids.begin();
@@ -454,12 +454,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_DUPS)) {
         index_dups();
       }
-      auto q = dup_index.find(r);
-      if (q != dup_index.end()) {
-	*version = q->second->version;
-	*user_version = q->second->user_version;
-	*return_code = q->second->return_code;
-	*op_returns = q->second->op_returns;
+      if (auto d = dup_index.find(r); d) {
+	*version = d->version;
+	*user_version = d->user_version;
+	*return_code = d->return_code;
+	*op_returns = d->op_returns;
 	return true;
       }
 
@@ -517,14 +516,17 @@ public:
 
       if (to_index & PGLOG_INDEXED_OBJECTS)
 	objects.clear();
-      if (to_index & PGLOG_INDEXED_CALLER_OPS)
+      if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	caller_ops.clear();
+	caller_ops.reserve(log.size());
+      }
       if (to_index & PGLOG_INDEXED_EXTRA_CALLER_OPS)
 	extra_caller_ops.clear();
       if (to_index & PGLOG_INDEXED_DUPS) {
 	dup_index.clear();
+	dup_index.reserve(dups.size());
 	for (auto& i : dups) {
-	  dup_index[i.reqid] = const_cast<pg_log_dup_t*>(&i);
+	  dup_index.insert_or_assign(const_cast<pg_log_dup_t*>(&i));
 	}
       }
 
@@ -543,7 +545,7 @@ public:
 
 	  if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	    if (i->reqid_is_indexed()) {
-	      caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	      caller_ops.insert_or_assign(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
@@ -586,7 +588,7 @@ public:
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  caller_ops.insert_or_assign(&e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -615,10 +617,8 @@ public:
       }
       if (e.reqid_is_indexed()) {
         if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
-	  auto it = caller_ops.find(e.reqid);
 	  // divergent merge_log indexes new before unindexing old
-          if (it != caller_ops.end() && it->second == &e)
-            caller_ops.erase(it);
+	  caller_ops.erase(e.reqid, &e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -639,16 +639,13 @@ public:
 
     void index(pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	dup_index[e.reqid] = &e;
+	dup_index.insert_or_assign(&e);
       }
     }
 
     void unindex(const pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	auto i = dup_index.find(e.reqid);
-	if (i != dup_index.end()) {
-	  dup_index.erase(i);
-	}
+	dup_index.erase(e.reqid);
       }
     }
 
@@ -682,7 +679,7 @@ public:
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  caller_ops.insert_or_assign(&(log.back()));
         }
       }
 
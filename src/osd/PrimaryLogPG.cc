@@ -4547,6 +4547,7 @@ void PrimaryLogPG::log_op_stats(const OpRequest& op,
   osd->logger->inc(l_osd_op_inb, inb);
   osd->logger->tinc(l_osd_op_lat, latency);
   osd->logger->tinc(l_osd_op_process_lat, process_latency);
+  osd->note_op_latency(latency);
 
   if (op.may_read() && op.may_write()) {
     osd->logger->inc(l_osd_op_rw);
@@ -12914,7 +12915,8 @@ void PrimaryLogPG::do_update_log_missing(OpRequestRef &op)
 	    msg->get_tid(),
 	    new_lcod);
 	reply->set_priority(CEPH_MSG_PRIO_HIGH);
-	msg->get_connection()->send_message(reply);
+	// must not overtake repop replies held for this connection
+	osd->send_message_osd_cluster(reply, msg->get_connection());
       }
     });
 
@@ -13511,6 +13513,7 @@ void PrimaryLogPG::_clear_recovery_state()
   }
   ceph_assert(backfills_in_flight.empty());
   pending_backfill_updates.clear();
+  backfill_readahead.reset();
   ceph_assert(recovering.empty());
   pgbackend->clear_recovery_state();
 }
@@ -14174,6 +14177,7 @@ uint64_t PrimaryLogPG::recover_backfill(
 	recovery_state.get_peer_info(*i).last_backfill);
     }
     backfill_info.reset(last_backfill_started);
+    backfill_readahead.reset();
 
     backfills_in_flight.clear();
     pending_backfill_updates.clear();
@@ -14193,6 +14197,7 @@ uint64_t PrimaryLogPG::recover_backfill(
   // update our local interval to cope with recent changes
   backfill_info.begin = last_backfill_started;
   update_range(&backfill_info, handle);
+  kick_backfill_readahead();
 
   unsigned ops = 0;
   vector<boost::tuple<hobject_t, eversion_t, pg_shard_t> > to_remove;
@@ -14213,10 +14218,24 @@ uint64_t PrimaryLogPG::recover_backfill(
     if (backfill_info.begin <= earliest_peer_backfill() &&
 	!backfill_info.extends_to_end() && backfill_info.empty()) {
       hobject_t next = backfill_info.end;
-      backfill_info.reset(next);
-      backfill_info.end = hobject_t::get_max();
+      auto scan_start = ceph::mono_clock::now();
+      if (backfill_readahead.take(next, &backfill_info)) {
+	BackfillReadahead::revalidate(
+	  &backfill_info, get_backfill_targets(),
+	  [this](const hobject_t& hoid) {
+	    return object_contexts.lookup(hoid);
+	  });
+	dout(20) << " took readahead " << backfill_info << dendl;
+	osd->logger->inc(l_osd_backfill_scan_readahead);
+      } else {
+	backfill_info.reset(next);
+	backfill_info.end = hobject_t::get_max();
+      }
       update_range(&backfill_info, handle);
       backfill_info.trim();
+      osd->logger->tinc(l_osd_backfill_scan_stall,
+			ceph::mono_clock::now() - scan_start);
+      kick_backfill_readahead();
     }
 
     dout(20) << "   my backfill interval " << backfill_info << dendl;
@@ -14660,6 +14679,28 @@ void PrimaryLogPG::update_range(
   }
 }
 
+void PrimaryLogPG::kick_backfill_readahead()
+{
+  unsigned window = cct->_conf->osd_backfill_scan_readahead;
+  if (window == 0 || backfill_info.empty() ||
+      backfill_info.extends_to_end()) {
+    return;
+  }
+  BackfillReadahead::params_t p;
+  p.store = osd->store;
+  p.ch = ch;
+  p.shard = pg_whoami.shard;
+  p.fixed_collection_list = HAVE_FEATURE(min_upacting_features(),
+					 OSD_FIXED_COLLECTION_LIST);
+  p.backfill_targets = get_backfill_targets();
+  p.min = cct->_conf->osd_backfill_scan_min;
+  p.max = cct->_conf->osd_backfill_scan_max;
+  backfill_readahead.kick(osd->get_backfill_scan_finisher(info.pgid),
+			  backfill_info.end,
+			  recovery_state.get_last_update_applied(), window,
+			  std::move(p));
+}
+
 void PrimaryLogPG::scan_range_primary(
   int min, int max, PrimaryBackfillInterval *bi,
   ThreadPool::TPHandle &handle,
@@ -14712,23 +14753,7 @@ void PrimaryLogPG::scan_range_primary(
       shard_versions = oi.shard_versions;
     }
     dout(20) << "  " << *p << " " << version << dendl;
-    if (shard_versions.empty()) {
-      bi->objects.insert(make_pair(*p, std::make_pair(shard_id_t::NO_SHARD,
-						      version)));
-    } else {
-      bool added_default = false;
-      for (auto & shard: backfill_targets) {
-	if (shard_versions.contains(shard.shard)) {
-	  auto shard_version = shard_versions.at(shard.shard);
-	  bi->objects.insert(make_pair(*p, std::make_pair(shard.shard,
-							  shard_version)));
-	} else if (!added_default) {
-	  bi->objects.insert(make_pair(*p, std::make_pair(shard_id_t::NO_SHARD,
-							  version)));
-	  added_default = true;
-	}
-      }
-    }
+    bi->add(*p, version, shard_versions, backfill_targets);
   }
 }
 
@@ -21,6 +21,7 @@
 #include "include/ceph_assert.h"
 #include "include/types.h" // for client_t
 #include "DynamicPerfStats.h"
+#include "BackfillReadahead.h"
 #include "OSD.h"
 #include "PG.h"
 #include "Watch.h"
@@ -1195,6 +1196,8 @@ protected:
   /// last backfill operation started
   hobject_t last_backfill_started;
   bool new_backfill;
+  /// local intervals after backfill_info, scanned ahead
+  BackfillReadahead backfill_readahead;
 
   int prep_object_replica_pushes(const hobject_t& soid, eversion_t v,
 				 PGBackend::RecoveryHandle *h,
@@ -1363,6 +1366,9 @@ protected:
     ThreadPool::TPHandle &handle ///< [in] tp handle
     );
 
+  /// scan the intervals after backfill_info ahead, if configured
+  void kick_backfill_readahead();
+
   int prep_backfill_object_push(
     hobject_t oid, eversion_t v, ObjectContextRef obc,
     std::vector<pg_shard_t> peers,
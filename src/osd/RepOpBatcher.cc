@@ -0,0 +1,152 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "RepOpBatcher.h"
+
+#include "common/Thread.h"
+#include "common/debug.h"
+#include "common/perf_counters.h"
+#include "include/ceph_features.h"
+#include "messages/MOSDRepOpBatch.h"
+#include "osd/osd_perf_counters.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix *_dout << "repop_batcher "
+
+RepOpBatcher::~RepOpBatcher()
+{
+  ceph_assert(!flusher.joinable());
+}
+
+void RepOpBatcher::start(PerfCounters *l)
+{
+  logger = l;
+  stopping = false;
+  flusher = ceph::make_named_thread("osd_repop_batch",
+                                    &RepOpBatcher::flusher_entry, this);
+}
+
+void RepOpBatcher::stop()
+{
+  {
+    std::lock_guard l{flusher_lock};
+    stopping = true;
+    flusher_cond.notify_all();
+  }
+  if (flusher.joinable()) {
+    flusher.join();
+  }
+  for (auto& s : shards) {
+    std::lock_guard l{s.lock};
+    for (auto& [con, b] : s.batches) {
+      _send(b);
+    }
+    num_batches -= s.batches.size();
+    s.batches.clear();
+  }
+}
+
+void RepOpBatcher::_send(batch_t& b)
+{
+  if (b.msgs.empty()) {
+    return;
+  }
+  dout(20) << __func__ << " " << b.msgs.size() << " ops " << b.bytes
+           << " bytes to " << b.con->get_peer_addr() << dendl;
+  if (logger) {
+    logger->inc(l_osd_repop_batch, b.msgs.size());
+  }
+  if (b.msgs.size() == 1) {
+    b.con->send_message(b.msgs.front());
+  } else {
+    b.con->send_message(new MOSDRepOpBatch(std::move(b.msgs)));
+  }
+  b.msgs.clear();
+  b.bytes = 0;
+}
+
+bool RepOpBatcher::queue(const ConnectionRef& con, Message *m)
+{
+  const auto& conf = cct->_conf;
+  if (!conf->osd_repop_batch ||
+      !is_batchable(m) ||
+      !con->has_features(CEPH_FEATUREMASK_SERVER_UMBRELLA)) {
+    return false;
+  }
+  auto& s = shard_of(con.get());
+  std::lock_guard l{s.lock};
+  auto [p, created] = s.batches.try_emplace(con.get());
+  auto& b = p->second;
+  if (created) {
+    b.con = con;
+    b.deadline = ceph::mono_clock::now() +
+      std::chrono::microseconds(conf->osd_repop_batch_window_us);
+    if (num_batches++ == 0) {
+      // the flusher sleeps for as long as nothing is held
+      std::lock_guard fl{flusher_lock};
+      flusher_cond.notify_all();
+    }
+  }
+  b.msgs.push_back(m);
+  b.bytes += m->get_payload().length() + m->get_data().length();
+  if (b.msgs.size() >= conf->osd_repop_batch_max_ops ||
+      b.bytes >= conf->osd_repop_batch_max_bytes) {
+    _send(b);
+    s.batches.erase(p);
+    --num_batches;
+  }
+  return true;
+}
+
+void RepOpBatcher::flush(Connection *con)
+{
+  if (num_batches == 0) {
+    return;
+  }
+  auto& s = shard_of(con);
+  std::lock_guard l{s.lock};
+  auto p = s.batches.find(con);
+  if (p != s.batches.end()) {
+    _send(p->second);
+    s.batches.erase(p);
+    --num_batches;
+  }
+}
+
+void RepOpBatcher::flusher_entry()
+{
+  std::unique_lock fl{flusher_lock};
+  while (!stopping) {
+    fl.unlock();
+    auto now = ceph::mono_clock::now();
+    auto next = ceph::mono_time::max();
+    for (auto& s : shards) {
+      std::lock_guard l{s.lock};
+      for (auto p = s.batches.begin(); p != s.batches.end();) {
+        if (p->second.deadline <= now) {
+          _send(p->second);
+          p = s.batches.erase(p);
+          --num_batches;
+        } else {
+          next = std::min(next, p->second.deadline);
+          ++p;
+        }
+      }
+    }
+    fl.lock();
+    if (stopping) {
+      break;
+    }
+    if (num_batches == 0) {
+      flusher_cond.wait(fl);
+    } else if (next == ceph::mono_time::max()) {
+      // only batches created since the sweep, due a window from then
+      flusher_cond.wait_for(fl, std::chrono::microseconds(
+        std::max<uint64_t>(1, cct->_conf->osd_repop_batch_window_us)));
+    } else {
+      flusher_cond.wait_until(fl, next);
+    }
+  }
+}
@@ -0,0 +1,96 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+#include "include/common_fwd.h"
+#include "msg/Connection.h"
+#include "msg/Message.h"
+
+/**
+ * RepOpBatcher - coalesce MOSDRepOp and MOSDRepOpReply per connection
+ *
+ * With osd_repop_batch on, repops and their commit replies headed for
+ * the same peer are held for up to osd_repop_batch_window_us, or until
+ * osd_repop_batch_max_ops / osd_repop_batch_max_bytes are reached, and
+ * then sent as one MOSDRepOpBatch.
+ *
+ * Ordering: a batch is sent under its shard lock, and every other
+ * message for the same connection must go through flush() first (the
+ * OSDService send helpers and send_incremental_map() do, and peering
+ * messages are sent through the former), so nothing overtakes a held
+ * repop.
+ */
+class RepOpBatcher {
+  CephContext *cct;
+  PerfCounters *logger = nullptr;
+
+  struct batch_t {
+    ConnectionRef con;
+    std::vector<Message*> msgs;
+    uint64_t bytes = 0;
+    ceph::mono_time deadline;
+  };
+  struct shard_t {
+    ceph::mutex lock = ceph::make_mutex("RepOpBatcher::shard_t::lock");
+    std::map<Connection*, batch_t> batches;
+  };
+  static constexpr unsigned NUM_SHARDS = 16;
+  std::array<shard_t, NUM_SHARDS> shards;
+  /// batches held over all shards, lets flush() skip the locks
+  std::atomic<uint64_t> num_batches = {0};
+
+  ceph::mutex flusher_lock = ceph::make_mutex("RepOpBatcher::flusher_lock");
+  ceph::condition_variable flusher_cond;
+  bool stopping = false;
+  std::thread flusher;
+
+  shard_t& shard_of(const Connection *con) {
+    return shards[(std::hash<const Connection*>{}(con) >> 4) % NUM_SHARDS];
+  }
+  /// send b and empty it, shard lock held
+  void _send(batch_t& b);
+  void flusher_entry();
+
+public:
+  explicit RepOpBatcher(CephContext *cct) : cct(cct) {}
+  ~RepOpBatcher();
+
+  void start(PerfCounters *l);
+  /// send everything still held and stop the flusher
+  void stop();
+
+  /// whether m is a message type that may be held
+  static bool is_batchable(const Message *m) {
+    return m->get_type() == MSG_OSD_REPOP ||
+      m->get_type() == MSG_OSD_REPOPREPLY;
+  }
+  /**
+   * hold m for con
+   *
+   * Takes the reference of m and returns true if it was queued.  If
+   * batching is off or the peer can't decode a batch, returns false and
+   * the caller sends m as usual, after calling flush().
+   */
+  bool queue(const ConnectionRef& con, Message *m);
+  /// send whatever is held for con, before a message that bypasses us
+  void flush(Connection *con);
+};
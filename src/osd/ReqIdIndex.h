@@ -0,0 +1,162 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "include/mempool.h"
+#include "osd/osd_types.h"
+
+/**
+ * ReqIdIndex - open addressing index of log entries by reqid
+ *
+ * Indexes pg_log_entry_t or pg_log_dup_t pointers by their own reqid.
+ * The key is not copied: a slot only holds the entry pointer and the
+ * full 64-bit hash of its reqid, and the entry is looked at only when
+ * the hash matches.  This keeps a per-PG index at 16 bytes per entry in
+ * one flat array, instead of one heap node per entry, and makes
+ * rebuilding it (peering, split, merge) a linear fill.
+ *
+ * Every indexed entry must stay alive, at the same address, until it is
+ * erased or the index is cleared.
+ */
+template <typename T>
+class ReqIdIndex {
+  struct slot_t {
+    uint64_t hash = 0;
+    T *entry = nullptr;   ///< nullptr if the slot is free
+  };
+  mempool::osd_pglog::vector<slot_t> slots;  ///< size is 0 or a power of 2
+  size_t num = 0;
+
+  static uint64_t hash_of(const osd_reqid_t &r) {
+    // std::hash<osd_reqid_t> only xors the fields; run them through
+    // murmur3's finalizer so that consecutive tids from a few clients
+    // spread over the whole table
+    uint64_t h = r.name.num() * 0x9e3779b97f4a7c15ull;
+    h ^= r.tid + ((uint64_t)(uint32_t)r.inc << 32) + r.name.type();
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+  size_t mask() const {
+    return slots.size() - 1;
+  }
+  /// slot holding r, or the free slot ending its probe sequence
+  size_t probe(const osd_reqid_t &r, uint64_t h) const {
+    for (size_t i = h & mask(); ; i = (i + 1) & mask()) {
+      const slot_t &s = slots[i];
+      if (!s.entry || (s.hash == h && s.entry->reqid == r)) {
+	return i;
+      }
+    }
+  }
+  void rehash(size_t new_size) {
+    mempool::osd_pglog::vector<slot_t> old(new_size);
+    old.swap(slots);
+    for (auto &s : old) {
+      if (s.entry) {
+	size_t i = s.hash & mask();
+	while (slots[i].entry) {
+	  i = (i + 1) & mask();
+	}
+	slots[i] = s;
+      }
+    }
+  }
+
+public:
+  size_t size() const {
+    return num;
+  }
+  bool empty() const {
+    return num == 0;
+  }
+  size_t count(const osd_reqid_t &r) const {
+    return find(r) ? 1 : 0;
+  }
+
+  T *find(const osd_reqid_t &r) const {
+    if (num == 0) {
+      return nullptr;
+    }
+    return slots[probe(r, hash_of(r))].entry;
+  }
+
+  /// make room for n entries without rehashing
+  void reserve(size_t n) {
+    if (n == 0) {
+      return;
+    }
+    size_t want = 16;
+    while (want * 3 < n * 4) {
+      want <<= 1;
+    }
+    if (want > slots.size()) {
+      rehash(want);
+    }
+  }
+
+  /// index e by its reqid, replacing whatever had the same reqid
+  void insert_or_assign(T *e) {
+    // keep the load factor at or below 3/4
+    if ((num + 1) * 4 > slots.size() * 3) {
+      rehash(slots.empty() ? 16 : slots.size() * 2);
+    }
+    uint64_t h = hash_of(e->reqid);
+    slot_t &s = slots[probe(e->reqid, h)];
+    if (!s.entry) {
+      ++num;
+    }
+    s.hash = h;
+    s.entry = e;
+  }
+
+  /**
+   * remove r from the index
+   *
+   * If only_if is given, r is removed only if it is still indexed to
+   * that entry.  Returns true if something was removed.
+   */
+  bool erase(const osd_reqid_t &r, const T *only_if = nullptr) {
+    if (num == 0) {
+      return false;
+    }
+    size_t i = probe(r, hash_of(r));
+    if (!slots[i].entry || (only_if && slots[i].entry != only_if)) {
+      return false;
+    }
+    // backward shift deletion: pull later members of the probe run
+    // into the hole, so lookups never need tombstones
+    for (size_t j = (i + 1) & mask(); slots[j].entry; j = (j + 1) & mask()) {
+      size_t home = slots[j].hash & mask();
+      if (((j - home) & mask()) >= ((j - i) & mask())) {
+	slots[i] = slots[j];
+	i = j;
+      }
+    }
+    slots[i] = slot_t();
+    --num;
+    return true;
+  }
+
+  void clear() {
+    slots.clear();
+    slots.shrink_to_fit();
+    num = 0;
+  }
+};
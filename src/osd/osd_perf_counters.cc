@@ -132,6 +132,12 @@ PerfCounters *build_osd_logger(CephContext *cct) {
 
   osd_plb.add_time_avg(l_osd_op_before_dequeue_op_lat, "op_before_dequeue_op_lat",
     "Latency of IO before calling dequeue_op(already dequeued and get PG lock)"); // client io before dequeue_op latency
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_steal, "op_wq_steal",
+    "Op queue items run by a thread of another shard");
+  osd_plb.add_u64_avg(
+    l_osd_repop_batch, "repop_batch",
+    "Replication ops and replies per message sent by the repop batcher");
 
 
   osd_plb.add_u64_counter(
@@ -219,6 +225,13 @@ PerfCounters *build_osd_logger(CephContext *cct) {
     "l_osd_recovery_context_queue_latency",
     "PGRecoveryContext queue latency");
 
+  osd_plb.add_time_avg(
+    l_osd_backfill_scan_stall, "backfill_scan_stall",
+    "Time backfill waited for a scan of the local PG");
+  osd_plb.add_u64_counter(
+    l_osd_backfill_scan_readahead, "backfill_scan_readahead",
+    "Local backfill intervals taken from the scan readahead");
+
   osd_plb.add_u64(l_osd_loadavg, "loadavg", "CPU load");
   osd_plb.add_u64(
     l_osd_cached_crc, "cached_crc", "Total number getting crc from crc_cache");
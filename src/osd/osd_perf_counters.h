@@ -42,6 +42,8 @@ enum osd_counter_idx_t {
 
   l_osd_op_before_queue_op_lat,
   l_osd_op_before_dequeue_op_lat,
+  l_osd_op_wq_steal,
+  l_osd_repop_batch,
 
   l_osd_replica_read,
   l_osd_replica_read_redirect_missing,
@@ -77,6 +79,9 @@ enum osd_counter_idx_t {
   l_osd_recovery_queue_lat,
   l_osd_recovery_context_queue_lat,
 
+  l_osd_backfill_scan_stall,
+  l_osd_backfill_scan_readahead,
+
   l_osd_loadavg,
   l_osd_cached_crc,
   l_osd_cached_crc_adjusted,
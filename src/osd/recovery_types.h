@@ -4,6 +4,7 @@
 #pragma once
 
 #include <map>
+#include <set>
 
 #include "osd_types.h"
 
@@ -127,6 +128,30 @@ public:
     trim();
   }
 
+  /// add hoid at version, plus the entries of shard_versions that the
+  /// backfill targets need
+  void add(const hobject_t& hoid, eversion_t version,
+           const std::map<shard_id_t,eversion_t>& shard_versions,
+           const std::set<pg_shard_t>& backfill_targets) {
+    if (shard_versions.empty()) {
+      objects.insert(std::make_pair(hoid, std::make_pair(shard_id_t::NO_SHARD,
+                                                         version)));
+      return;
+    }
+    bool added_default = false;
+    for (auto& shard : backfill_targets) {
+      if (auto p = shard_versions.find(shard.shard);
+          p != shard_versions.end()) {
+        objects.insert(std::make_pair(hoid, std::make_pair(shard.shard,
+                                                           p->second)));
+      } else if (!added_default) {
+        objects.insert(std::make_pair(hoid, std::make_pair(shard_id_t::NO_SHARD,
+                                                           version)));
+        added_default = true;
+      }
+    }
+  }
+
   /// dump
   void dump(ceph::Formatter *f) const override {
     f->dump_stream("begin") << begin;
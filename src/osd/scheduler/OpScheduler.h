@@ -19,6 +19,7 @@
 #include <variant>
 
 #include "common/ceph_context.h"
+#include "common/ceph_time.h"
 #include "common/OpQueue.h"
 #include "mon/MonClient.h"
 #include "osd/scheduler/OpSchedulerItem.h"
@@ -39,6 +40,13 @@ public:
   // Enqueue op for scheduling
   virtual void enqueue(OpSchedulerItem &&item) = 0;
 
+  // Enqueue op that arrived at the given time and was held since, as
+  // though it had been enqueued then
+  virtual void enqueue_staged(OpSchedulerItem &&item,
+                              ceph::real_time arrival) {
+    enqueue(std::move(item));
+  }
+
   // Enqueue op for processing as though it were enqueued prior
   // to other items already scheduled.
   virtual void enqueue_front(OpSchedulerItem &&item) = 0;
@@ -111,6 +111,17 @@ mClockScheduler::get_scheduler_op_type(const OpSchedulerItem &item)
 }
 
 void mClockScheduler::enqueue(OpSchedulerItem&& item)
+{
+  _enqueue(std::move(item), dmc::get_time());
+}
+
+void mClockScheduler::enqueue_staged(OpSchedulerItem&& item,
+                                     ceph::real_time arrival)
+{
+  _enqueue(std::move(item), ceph::real_clock::to_double(arrival));
+}
+
+void mClockScheduler::_enqueue(OpSchedulerItem&& item, dmc::Time time)
 {
   auto id = get_scheduler_id(item);
   unsigned priority = item.get_priority();
@@ -134,9 +145,11 @@ void mClockScheduler::enqueue(OpSchedulerItem&& item)
     mclock_conf.get_mclock_counter(id, sch_op_type, item_cost);
 
     // Add item to scheduler queue
-    scheduler.add_request(
+    scheduler.add_request_time(
       std::move(item),
       id,
+      dmc::ReqParams(),
+      time,
       qos_cost);
   }
 
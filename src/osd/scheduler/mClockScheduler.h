@@ -119,6 +119,10 @@ public:
   // Enqueue op in the back of the regular queue
   void enqueue(OpSchedulerItem &&item) final;
 
+  // Enqueue op with mClock tags computed for its arrival time
+  void enqueue_staged(OpSchedulerItem &&item,
+                      ceph::real_time arrival) final;
+
   // Enqueue the op in the front of the high priority queue
   void enqueue_front(OpSchedulerItem &&item) final;
 
@@ -147,6 +151,8 @@ public:
     return mclock_conf.get_cost_per_io();
   }
 private:
+  // Enqueue op as arrived at time (dmclock time, real clock seconds)
+  void _enqueue(OpSchedulerItem &&item, crimson::dmclock::Time time);
   // Enqueue the op to the high priority queue
   void enqueue_high(unsigned prio, OpSchedulerItem &&item, bool front = false);
   // Return the scheduler op type - used to update perf counters
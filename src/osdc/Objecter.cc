@@ -3306,7 +3306,17 @@ int Objecter::_calc_target(op_target_t *t, bool any_change)
         !is_write && pi->is_replicated() && t->acting.size() > 1) {
       int osd;
       ceph_assert(is_read && t->acting[0] == acting_primary);
-      if (t->flags & CEPH_OSD_FLAG_BALANCE_READS) {
+      if ((t->flags & CEPH_OSD_FLAG_BALANCE_READS) &&
+	  cct->_conf->objecter_balance_reads_by_load) {
+	unsigned p = pick_least_loaded(
+	  t->acting, rand() % t->acting.size(),
+	  [this](int o) { return _get_osd_load(o); });
+	if (p)
+	  t->used_replica = true;
+	osd = t->acting[p];
+	ldout(cct, 10) << " chose osd." << osd << " load "
+		       << _get_osd_load(osd) << " of " << t->acting << dendl;
+      } else if (t->flags & CEPH_OSD_FLAG_BALANCE_READS) {
 	int p = rand() % t->acting.size();
 	if (p)
 	  t->used_replica = true;
@@ -3354,6 +3364,20 @@ int Objecter::_calc_target(op_target_t *t, bool any_change)
   return RECALC_OP_TARGET_NO_ACTION;
 }
 
+uint64_t Objecter::_get_osd_load(int osd) const
+{
+  auto p = osd_sessions.find(osd);
+  if (p == osd_sessions.end()) {
+    return 0;
+  }
+  const OSDSession *s = p->second;
+  auto ttl = ceph::make_timespan(cct->_conf->objecter_load_hint_ttl);
+  if (s->load_stamp.load() + ttl < ceph::coarse_mono_clock::now()) {
+    return 0;
+  }
+  return expected_wait(s->load_queue_depth, s->load_latency_us);
+}
+
 int Objecter::_map_session(op_target_t *target, OSDSession **s,
 			   shunique_lock<ceph::shared_mutex>& sul)
 {
@@ -3816,6 +3840,12 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
     return;
   }
 
+  if (m->get_load_latency_us()) {
+    s->load_queue_depth = m->get_load_queue_depth();
+    s->load_latency_us = m->get_load_latency_us();
+    s->load_stamp = ceph::coarse_mono_clock::now();
+  }
+
   unique_lock sl(s->lock);
 
   map<ceph_tid_t, Op *>::iterator iter = s->ops.find(tid);
@@ -2513,6 +2513,11 @@ public:
     int num_locks;
     std::unique_ptr<std::mutex[]> completion_locks;
 
+    // load hint from the osd's latest op reply, for balancing reads
+    std::atomic<uint32_t> load_queue_depth = {0};
+    std::atomic<uint32_t> load_latency_us = {0};
+    std::atomic<ceph::coarse_mono_time> load_stamp = {};
+
     OSDSession(CephContext *cct, int o) :
       osd(o), incarnation(0), con(NULL),
       num_locks(cct->_conf->objecter_completion_locks_per_session),
@@ -2604,6 +2609,35 @@ public:
 
   bool target_should_be_paused(op_target_t *op);
   int _calc_target(op_target_t *t, bool any_change = false);
+  /// expected wait at osd from its last load hint, 0 if none; rwlock held
+  uint64_t _get_osd_load(int osd) const;
+  /// roughly how long a new op waits for the ones queued ahead of it
+  static uint64_t expected_wait(uint32_t queue_depth, uint32_t latency_us) {
+    return (uint64_t)latency_us * (queue_depth + 1);
+  }
+  /**
+   * rank in acting with the least load(osd), for a balanced read
+   *
+   * Looks from rank start on, so that ties, and osds we have no hint
+   * for, are spread when start is random.  An osd with no load is
+   * taken right away.
+   */
+  template <typename LoadFn>
+  static unsigned pick_least_loaded(const std::vector<int>& acting,
+				    unsigned start, LoadFn&& load) {
+    unsigned n = acting.size();
+    unsigned p = start % n;
+    uint64_t best_load = load(acting[p]);
+    for (unsigned i = 1; i < n && best_load; ++i) {
+      unsigned q = (start + i) % n;
+      uint64_t l = load(acting[q]);
+      if (l < best_load) {
+	p = q;
+	best_load = l;
+      }
+    }
+    return p;
+  }
   int _map_session(op_target_t *op, OSDSession **s,
 		   ceph::shunique_lock<ceph::shared_mutex>& lc);
 
@@ -36,29 +36,16 @@ struct T : public Thread {
 };
 
 void usage(const char *name) {
-  cout << name << " <threads> <lines>\n"
-       << "\t threads: the number of threads for this test.\n"
+  cout << name << " <threads> <lines> [--log-thread-ring-size N]\n"
+       << "\t threads: the most threads to log from; runs with 1, 2, 4, ..."
+       << " up to this many.\n"
        << "\t lines: the number of log entries per thread.\n";
 }
 
-int main(int argc, const char **argv)
+static void run(int threads, int num)
 {
-  if (argc < 3) {
-    usage(argv[0]);
-    return EXIT_FAILURE;
-  }
-
-  int threads = atoi(argv[1]);
-  int num = atoi(argv[2]);
-
-  cout << threads << " threads, " << num << " lines per thread" << std::endl;
-
-  auto args = argv_to_vec(argc, argv);
-
-  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_OSD,
-			 CODE_ENVIRONMENT_UTILITY,
-			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
-
+  auto log = g_ceph_context->_log;
+  uint64_t dropped = log->get_ring_dropped();
   utime_t start = ceph_clock_now();
 
   list<T*> ls;
@@ -75,15 +62,44 @@ int main(int argc, const char **argv)
     delete t;
   }
 
-  utime_t t = ceph_clock_now();
-  t -= start;
-  cout << " flushing.. " << t << " so far ..." << std::endl;
+  utime_t submitted = ceph_clock_now() - start;
+  log->flush();
+  utime_t dur = ceph_clock_now() - start;
 
-  g_ceph_context->_log->flush();
+  cout << threads << " threads: submitted in " << submitted
+       << ", flushed in " << dur << ", "
+       << (uint64_t)(threads * (double)num / (double)submitted)
+       << " lines/s submitted";
+  if (uint64_t d = log->get_ring_dropped() - dropped; d) {
+    cout << ", " << d << " dropped";
+  }
+  cout << std::endl;
+}
 
-  utime_t end = ceph_clock_now();
-  utime_t dur = end - start;
+int main(int argc, const char **argv)
+{
+  if (argc < 3) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int threads = atoi(argv[1]);
+  int num = atoi(argv[2]);
 
-  cout << dur << std::endl;
+  cout << "up to " << threads << " threads, " << num << " lines per thread"
+       << std::endl;
+
+  auto args = argv_to_vec(argc, argv);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  cout << "log_thread_ring_size "
+       << g_conf().get_val<uint64_t>("log_thread_ring_size") << std::endl;
+
+  for (int n = 1; n < threads; n *= 2) {
+    run(n, num);
+  }
+  run(threads, num);
   return 0;
 }
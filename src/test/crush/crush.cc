@@ -190,6 +190,28 @@ TEST_P(IndepTest, basic) {
   }
 }
 
+TEST_P(IndepTest, batch) {
+  std::unique_ptr<CrushWrapper> c(build_indep_map(cct, 3, 5, 4));
+  vector<__u32> weight(c->get_max_devices(), 0x10000);
+  for (unsigned i = 0; i < weight.size(); i += 3) {
+    weight[i] = 0x8000;
+  }
+  weight[1] = 0;
+
+  vector<int> xs;
+  for (int x = 0; x < 1000; ++x) {
+    xs.push_back(x * 7919);
+  }
+  vector<vector<int>> outs;
+  c->do_rule_batch(0, xs, outs, 5, weight, 0);
+  ASSERT_EQ(xs.size(), outs.size());
+  for (unsigned i = 0; i < xs.size(); ++i) {
+    vector<int> out;
+    c->do_rule(0, xs[i], out, 5, weight, 0);
+    ASSERT_EQ(out, outs[i]);
+  }
+}
+
 TEST_P(IndepTest, single_out_first) {
   std::unique_ptr<CrushWrapper> c(build_indep_map(cct, 3, 3, 3));
   c->dump_tree(&cout, nullptr);
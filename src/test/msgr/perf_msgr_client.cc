@@ -31,6 +31,7 @@ using namespace std;
 #include "messages/MOSDOp.h"
 #include "auth/DummyAuth.h"
 
+#include <algorithm>
 #include <atomic>
 
 class MessengerClient {
@@ -174,6 +175,7 @@ void usage(const string &name) {
   cout << "       [ios]: how much messages sent for each client" << std::endl;
   cout << "       [thinktime]: sleep time when do fast dispatching(match client logic)" << std::endl;
   cout << "       [msg length]: message data bytes" << std::endl;
+  cout << "       add --ms_async_zerocopy true to send large messages with MSG_ZEROCOPY" << std::endl;
 }
 
 int main(int argc, char **argv)
@@ -206,6 +208,9 @@ int main(int argc, char **argv)
   cout << "       ios " << ios << std::endl;
   cout << "       thinktime(us) " << think_time << std::endl;
   cout << "       message data bytes " << len << std::endl;
+  cout << "       zerocopy " << g_ceph_context->_conf->ms_async_zerocopy
+       << " (min bytes " << g_ceph_context->_conf->ms_async_zerocopy_min_bytes
+       << ")" << std::endl;
 
   MessengerClient client(public_msgr_type, args[0], think_time);
 
@@ -214,7 +219,11 @@ int main(int argc, char **argv)
   uint64_t start = Cycles::rdtsc();
   client.start();
   uint64_t stop = Cycles::rdtsc();
-  cout << " Total op " << (ios * numjobs) << " run time " << Cycles::to_microseconds(stop - start) << "us." << std::endl;
+  uint64_t us = Cycles::to_microseconds(stop - start);
+  cout << " Total op " << (ios * numjobs) << " run time " << us << "us." << std::endl;
+  cout << " Data throughput "
+       << (double)ios * numjobs * len / std::max<uint64_t>(us, 1)
+       << " MB/s." << std::endl;
 
   return 0;
 }
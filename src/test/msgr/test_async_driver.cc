@@ -332,6 +332,30 @@ TEST(EventCenterTest, DispatchTest) {
   worker2.join();
 }
 
+TEST(EventCenterTest, BusyPollTest) {
+  g_ceph_context->_conf.set_val_or_die("ms_async_busy_poll_us", "100");
+  Worker worker(g_ceph_context, 3);
+  g_ceph_context->_conf.set_val_or_die("ms_async_busy_poll_us", "0");
+  std::atomic<unsigned> count = { 0 };
+  ceph::mutex lock = ceph::make_mutex("BusyPollTest::lock");
+  ceph::condition_variable cond;
+  worker.create("worker_3");
+  for (int i = 0; i < 1000; ++i) {
+    count++;
+    worker.center.dispatch_event_external(EventCallbackRef(new CountEvent(&count, &lock, &cond)));
+    std::unique_lock l{lock};
+    cond.wait(l, [&] { return count == 0; });
+  }
+  worker.stop();
+  worker.join();
+
+  EventCenter::busy_poll_stats_t stats;
+  ASSERT_TRUE(worker.center.take_busy_poll_stats(&stats));
+  ASSERT_GT(stats.hits + stats.misses, 0u);
+  ASSERT_GE(stats.budget_us, 1u);
+  ASSERT_LE(stats.budget_us, 100u);
+}
+
 INSTANTIATE_TEST_SUITE_P(
   AsyncMessenger,
   EventDriverTest,
@@ -6,6 +6,7 @@
  * Author: Igor Fedotov, ifedotov@suse.com
  */
 #include <iostream>
+#include <thread>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
 
@@ -16,6 +17,7 @@
 #include "include/Context.h"
 #include "os/bluestore/Allocator.h"
 #include "os/bluestore/AllocatorBase.h"
+#include "os/bluestore/CpuCachedAllocator.h"
 
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int.hpp>
@@ -817,6 +819,67 @@ TEST_P(AllocTest, test_alloc_bench2_75_500_x2)
   doOverwriteMPC2Test(2, capacity, prefill, overwrite, 0.05);
 }
 
+/*
+* Many threads doing small allocate/release pairs against one allocator,
+* which is what PG shards do on a busy OSD. Runs the plain allocator and
+* then the same one behind the per-cpu extent cache.
+*/
+static double bench_alloc_threads(Allocator* alloc, size_t thread_count,
+                                  size_t ops_per_thread, uint64_t alloc_unit)
+{
+  std::vector<std::thread> threads;
+  auto start = mono_clock::now();
+  for (size_t t = 0; t < thread_count; t++) {
+    threads.emplace_back([&, t] {
+      gen_type rng(t);
+      boost::uniform_int<> u(1, 16);
+      std::vector<PExtentVector> live(64);
+      for (size_t i = 0; i < ops_per_thread; i++) {
+        auto& slot = live[i % live.size()];
+        if (!slot.empty()) {
+          alloc->release(slot);
+          slot.clear();
+        }
+        uint64_t want = alloc_unit * u(rng);
+        ASSERT_EQ((int64_t)want,
+                  alloc->allocate(want, alloc_unit, 0, -1, &slot));
+      }
+      for (auto& e : live) {
+        alloc->release(e);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  return std::chrono::duration<double>(mono_clock::now() - start).count();
+}
+
+TEST_P(AllocTest, test_alloc_bench_cpu_cache_mt)
+{
+  uint64_t capacity = uint64_t(64) * 1024 * 1024 * 1024;
+  uint64_t alloc_unit = 4096;
+  size_t ops = 200000;
+
+  for (uint64_t cache_size : {0, 1024 * 1024}) {
+    init_alloc(capacity, alloc_unit);
+    if (cache_size) {
+      alloc.reset(new CpuCachedAllocator(g_ceph_context, alloc.release(),
+                                         cache_size));
+    }
+    alloc->init_add_free(0, capacity);
+    for (size_t threads : {1, 4, 16}) {
+      double secs = bench_alloc_threads(alloc.get(), threads, ops, alloc_unit);
+      std::cout << GetParam() << " cpu_cache " << cache_size
+                << " threads " << threads
+                << ": " << (threads * ops * 2) / secs / 1000000 << " Mops/s"
+                << std::endl;
+      ASSERT_EQ(capacity, alloc->get_free());
+    }
+    init_close();
+  }
+}
+
 TEST_P(AllocTest, mempoolAccounting)
 {
   uint64_t bytes = mempool::bluestore_alloc::allocated_bytes();
@@ -15,6 +15,7 @@
 #include "include/stringify.h"
 #include "include/Context.h"
 #include "os/bluestore/Allocator.h"
+#include "os/bluestore/CpuCachedAllocator.h"
 
 using namespace std;
 
@@ -795,6 +796,63 @@ TEST_P(AllocTest, test_alloc_spatial_locality)
 }
 
 
+TEST_P(AllocTest, test_alloc_cpu_cache)
+{
+  int64_t block_size = 0x1000;
+  int64_t capacity = 256 * 1024 * 1024;
+  init_alloc(capacity, block_size);
+  alloc.reset(new CpuCachedAllocator(g_ceph_context, alloc.release(),
+                                     1024 * 1024));
+  alloc->init_add_free(0, capacity);
+  ASSERT_EQ((uint64_t)capacity, alloc->get_free());
+
+  interval_set<uint64_t> allocated;
+  for (int i = 0; i < 1000; i++) {
+    PExtentVector extents;
+    uint64_t want = block_size * (1 + i % 16);
+    ASSERT_EQ((int64_t)want,
+              alloc->allocate(want, block_size, 0, (int64_t)0, &extents));
+    for (auto& e : extents) {
+      // never hand out the same space twice
+      ASSERT_FALSE(allocated.intersects(e.offset, e.length));
+      allocated.insert(e.offset, e.length);
+    }
+    ASSERT_EQ(capacity - allocated.size(), alloc->get_free());
+    if (i % 3 == 0) {
+      interval_set<uint64_t> release_set;
+      release_set.insert(extents[0].offset, extents[0].length);
+      allocated.erase(extents[0].offset, extents[0].length);
+      alloc->release(release_set);
+    }
+  }
+  ASSERT_EQ(capacity - allocated.size(), alloc->get_free());
+
+  // cached extents are still reported as free
+  interval_set<uint64_t> free;
+  alloc->foreach([&](uint64_t o, uint64_t l) {
+    free.union_insert(o, l);
+  });
+  ASSERT_EQ(capacity - allocated.size(), free.size());
+  for (auto p = free.begin(); p != free.end(); ++p) {
+    ASSERT_FALSE(allocated.intersects(p.get_start(), p.get_len()));
+  }
+
+  // everything, including cached extents, can be allocated in the end
+  uint64_t left = alloc->get_free();
+  uint64_t got = 0;
+  while (true) {
+    PExtentVector extents;
+    int64_t r = alloc->allocate(0x100000, block_size, 0, (int64_t)0, &extents);
+    if (r <= 0) {
+      break;
+    }
+    got += r;
+  }
+  ASSERT_EQ(left, got);
+  ASSERT_EQ(0u, alloc->get_free());
+  alloc->shutdown();
+}
+
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
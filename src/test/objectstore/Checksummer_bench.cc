@@ -0,0 +1,73 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Blob checksum calc/verify throughput, on contiguous buffers (the
+ * per-buffer fast path) and on fragmented ones (chunks straddling
+ * buffer boundaries), for every csum type and chunk size.
+ */
+#include <iostream>
+#include <gtest/gtest.h>
+
+#include "common/ceph_time.h"
+#include "include/types.h"
+#include "os/bluestore/bluestore_types.h"
+
+using namespace std;
+
+// split bl into pieces of varying size that do not line up with csum
+// chunks, the way reads assembled from several extents/buffers look
+static bufferlist fragment_bl(const bufferlist& bl, unsigned piece)
+{
+  bufferlist res;
+  unsigned off = 0;
+  unsigned n = 0;
+  while (off < bl.length()) {
+    unsigned len = std::min(piece + 511 * (n++ % 3), bl.length() - off);
+    bufferlist t;
+    t.substr_of(bl, off, len);
+    res.claim_append(t);
+    off += len;
+  }
+  return res;
+}
+
+TEST(Checksummer, bench) {
+  const unsigned len = 4 << 20;
+  bufferlist bl;
+  bufferptr bp(len);
+  for (char *a = bp.c_str(); a < bp.c_str() + bp.length(); ++a)
+    *a = (unsigned long)a & 0xff;
+  bl.append(bp);
+  bufferlist frag = fragment_bl(bl, 0x3000);
+  int count = 32;
+  auto mbsec = [&](ceph::timespan dur) {
+    return (double)count * len / 1000000.0 /
+      std::chrono::duration<double>(dur).count();
+  };
+  for (unsigned csum_type = Checksummer::CSUM_NONE + 1;
+       csum_type < Checksummer::CSUM_MAX; ++csum_type) {
+    for (unsigned order : {12, 13, 14, 15, 16, 17}) {
+      for (auto* src : {&bl, &frag}) {
+        bluestore_blob_t b;
+        b.init_csum(csum_type, order, len);
+        auto start = ceph::mono_clock::now();
+        for (int i = 0; i < count; ++i) {
+          b.calc_csum(0, *src);
+        }
+        auto mid = ceph::mono_clock::now();
+        int bad_off;
+        uint64_t bad_csum;
+        for (int i = 0; i < count; ++i) {
+          ASSERT_EQ(0, b.verify_csum(0, *src, &bad_off, &bad_csum));
+        }
+        auto end = ceph::mono_clock::now();
+        cout << "csum_type " << Checksummer::get_csum_type_string(csum_type)
+             << " chunk " << (1u << order)
+             << (src == &bl ? " contiguous" : " fragmented")
+             << ", calc " << mbsec(mid - start) << " MB/sec"
+             << ", verify " << mbsec(end - mid) << " MB/sec" << std::endl;
+      }
+    }
+  }
+}
@@ -629,6 +629,49 @@ TEST_P(StoreTest, TrivialRemountFsck) {
   ASSERT_EQ(0, r);
 }
 
+TEST_P(StoreTest, DeepFsckParallelRead) {
+  if(string(GetParam()) != "bluestore")
+    return;
+  const unsigned num_objects = 64;
+  coll_t cid;
+  int r;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i), CEPH_NOSNAP)));
+    bufferlist bl;
+    bl.append(std::string(4096 * (i % 8 + 1), 'a' + i % 26));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ch.reset();
+  r = store->umount();
+  ASSERT_EQ(0, r);
+
+  auto logger = store->get_perf_counters();
+  SetVal(g_conf(), "bluestore_fsck_deep_read_threads", "0");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(0, store->fsck(true));
+  ASSERT_EQ(logger->get(l_bluestore_fsck_deep_read_objects), num_objects);
+  uint64_t serial_bytes = logger->get(l_bluestore_fsck_deep_read_bytes);
+
+  SetVal(g_conf(), "bluestore_fsck_deep_read_threads", "4");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(0, store->fsck(true));
+  ASSERT_EQ(logger->get(l_bluestore_fsck_deep_read_objects), num_objects);
+  ASSERT_EQ(logger->get(l_bluestore_fsck_deep_read_bytes), serial_bytes);
+
+  r = store->mount();
+  ASSERT_EQ(0, r);
+}
+
 TEST_P(StoreTest, SimpleRemount) {
   coll_t cid;
   ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
@@ -6034,6 +6077,26 @@ INSTANTIATE_TEST_SUITE_P(
   }))
 );
 
+class SyntheticMatrixKVCommitLanes: public MatrixTest {};
+TEST_P(SyntheticMatrixKVCommitLanes, Test)
+{
+  SyntheticTest();
+};
+
+INSTANTIATE_TEST_SUITE_P(
+  BlueStore,
+  SyntheticMatrixKVCommitLanes,
+  ::testing::ValuesIn(MatrixTest::Expand({
+    { "bluestore_min_alloc_size", "4096" },
+    { "max_write", "65536" },
+    { "max_size", "1048576" },
+    { "alignment", "512" },
+    { "bluestore_kv_commit_lanes", "1", "4" },
+    { "bluestore_prefer_deferred_size", "32768", "0" },
+    { "bluestore_sync_submit_transaction", "true", "false" }
+  }))
+);
+
 TEST_P(StoreTest, AttrSynthetic) {
   MixedGenerator gen(447);
   gen_type rng(TEST_RANDOM_SEED);
@@ -7717,6 +7780,67 @@ TEST_P(DeferredWriteTest, NewData) {
   }
 }
 
+TEST_P(DeferredWriteTest, AggregateAcrossCollections) {
+  deferred_test_t t = GetParam();
+  if (t.prefer_deferred_size <= t.bdev_block_size) {
+    return;
+  }
+  SetVal(g_conf(), "bdev_block_size", stringify(t.bdev_block_size).c_str());
+  SetVal(g_conf(), "bluestore_min_alloc_size", stringify(t.min_alloc_size).c_str());
+  SetVal(g_conf(), "bluestore_max_blob_size", stringify(t.max_blob_size).c_str());
+  SetVal(g_conf(), "bluestore_prefer_deferred_size", stringify(t.prefer_deferred_size).c_str());
+  // keep the deferred writes of all collections pending until umount
+  // drains them together
+  SetVal(g_conf(), "bluestore_max_defer_interval", "0");
+  SetVal(g_conf(), "bluestore_deferred_batch_ops", "10000");
+  SetVal(g_conf(), "bluestore_deferred_aggregate", "true");
+  g_conf().apply_changes(nullptr);
+  DeferredSetup();
+
+  const unsigned num_colls = 4;
+  const uint32_t length = t.bdev_block_size;
+  const PerfCounters* logger = store->get_perf_counters();
+  std::vector<coll_t> cids;
+  for (unsigned i = 0; i < num_colls; ++i) {
+    coll_t cid(spg_t(pg_t(i, 1)));
+    auto ch = store->create_new_collection(cid);
+    ObjectStore::Transaction tr;
+    tr.create_collection(cid, 0);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(tr)));
+    for (unsigned j = 0; j < 4; ++j) {
+      ghobject_t hoid(hobject_t(fmt::format("obj-{}", j), "", CEPH_NOSNAP,
+                                i, 1, ""));
+      C_SaferCond c;
+      ObjectStore::Transaction tw;
+      bufferlist bl;
+      bl.append(std::string(length, 'a' + i + j));
+      tw.write(cid, hoid, 0, bl.length(), bl,
+               CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+      tw.register_on_commit(&c);
+      ASSERT_EQ(0, queue_transaction(store, ch, std::move(tw)));
+      c.wait();
+    }
+    cids.push_back(cid);
+  }
+  ASSERT_EQ(0, logger->get(l_bluestore_submitted_deferred_writes));
+
+  store->umount();
+  ASSERT_LE(2u, logger->get(l_bluestore_deferred_aggregated_batches));
+  ASSERT_LT(0u, logger->get(l_bluestore_submitted_deferred_writes));
+  ASSERT_EQ(0, store->mount());
+
+  for (unsigned i = 0; i < num_colls; ++i) {
+    auto ch = store->open_collection(cids[i]);
+    for (unsigned j = 0; j < 4; ++j) {
+      ghobject_t hoid(hobject_t(fmt::format("obj-{}", j), "", CEPH_NOSNAP,
+                                i, 1, ""));
+      bufferlist bl;
+      ASSERT_EQ((int)length, store->read(ch, hoid, 0, length, bl));
+      ASSERT_EQ(std::string(length, 'a' + i + j), bl.to_str());
+    }
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(
   BlueStore,
   DeferredWriteTest,
@@ -13,6 +13,7 @@
 #include "common/errno.h"
 
 #include "blk/BlockDevice.h"
+#include "blk/kernel/io_uring.h"
 
 using namespace std;
 
@@ -91,6 +92,127 @@ TEST(KernelDevice, Ticket45337) {
   b->close();
 }
 
+TEST(KernelDevice, IoringPlugged) {
+  // ioring submits nothing until the outermost unplug, then every
+  // IOContext queued in between must complete
+  if (!ioring_queue_t::supported()) {
+    GTEST_SKIP() << "io_uring is not available, KernelDevice would use libaio";
+  }
+  uint64_t size = 1048576ull * 64;
+  TempBdev bdev{ size };
+
+  g_ceph_context->_conf.set_val("bdev_ioring", "true");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  std::unique_ptr<BlockDevice> b(
+    BlockDevice::create(g_ceph_context, bdev.path, NULL, NULL,
+      [](void* handle, void* aio) {}, NULL));
+  int r = b->open(bdev.path);
+  if (r < 0) {
+    std::cerr << "open " << bdev.path << " failed" << std::endl;
+    return;
+  }
+
+  const std::vector<uint64_t> lens = {
+    0x1000, 0x2000, 0x10000, 0x20000, 0x1000, 0x3000, 0x1000, 0x1000
+  };
+  std::vector<bufferlist> written;
+  {
+    IOContext ioc(g_ceph_context, NULL);
+    uint64_t off = 0;
+    b->aio_plug();
+    for (size_t i = 0; i < lens.size(); ++i) {
+      bufferlist bl;
+      bl.append(string(lens[i], 'a' + i));
+      written.push_back(bl);
+      ASSERT_EQ(b->aio_write(off, bl, &ioc, false), 0);
+      b->aio_submit(&ioc);
+      off += lens[i];
+    }
+    b->aio_unplug();
+    ioc.aio_wait();
+  }
+  {
+    IOContext ioc(g_ceph_context, NULL);
+    std::vector<bufferlist> read(lens.size());
+    uint64_t off = 0;
+    for (size_t i = 0; i < lens.size(); ++i) {
+      ASSERT_EQ(b->aio_read(off, lens[i], &read[i], &ioc), 0);
+      off += lens[i];
+    }
+    b->aio_submit(&ioc);
+    ioc.aio_wait();
+    for (size_t i = 0; i < lens.size(); ++i) {
+      ASSERT_TRUE(read[i].contents_equal(written[i]));
+    }
+  }
+  b->close();
+
+  g_ceph_context->_conf.set_val("bdev_ioring", "false");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+TEST(KernelDevice, ZonedEmulation) {
+  const uint64_t zone_size = 1048576ull;
+  uint64_t size = zone_size * 16;
+  TempBdev bdev{ size };
+
+  g_ceph_context->_conf.set_val("bdev_zoned_emulate_zone_size",
+                                stringify(zone_size));
+  g_ceph_context->_conf.set_val("bdev_zoned_emulate_conventional_zones", "1");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  std::unique_ptr<BlockDevice> b(
+    BlockDevice::create(g_ceph_context, bdev.path, NULL, NULL,
+      [](void* handle, void* aio) {}, NULL));
+  ASSERT_EQ(0, b->open(bdev.path));
+  ASSERT_TRUE(b->is_smr());
+  ASSERT_EQ(zone_size, b->get_zone_size());
+  ASSERT_EQ(zone_size, b->get_conventional_region_size());
+
+  auto zones = b->get_zones();
+  ASSERT_EQ(16u, zones.size());
+  for (size_t i = 0; i < zones.size(); ++i) {
+    ASSERT_EQ(i * zone_size, zones[i]);
+  }
+
+  bufferlist bl;
+  bl.append(string(0x2000, 'z'));
+  // conventional zone takes random writes
+  ASSERT_EQ(0, b->write(0x4000, bl, false));
+  // sequential zones only at the write pointer
+  ASSERT_EQ(0, b->write(2 * zone_size, bl, false));
+  ASSERT_EQ(-EIO, b->write(2 * zone_size + 0x4000, bl, false));
+  ASSERT_EQ(0, b->write(2 * zone_size + 0x2000, bl, false));
+  {
+    IOContext ioc(g_ceph_context, NULL);
+    ASSERT_EQ(-EIO, b->aio_write(3 * zone_size + 0x1000, bl, &ioc, false));
+    ASSERT_EQ(0, b->aio_write(3 * zone_size, bl, &ioc, false));
+    b->aio_submit(&ioc);
+    ioc.aio_wait();
+  }
+  zones = b->get_zones();
+  ASSERT_EQ(2 * zone_size + 0x4000, zones[2]);
+  ASSERT_EQ(3 * zone_size + 0x2000, zones[3]);
+
+  b->reset_zone(2);
+  zones = b->get_zones();
+  ASSERT_EQ(2 * zone_size, zones[2]);
+  ASSERT_EQ(0, b->write(2 * zone_size, bl, false));
+  b->close();
+
+  // write pointers are recovered on reopen
+  ASSERT_EQ(0, b->open(bdev.path));
+  zones = b->get_zones();
+  ASSERT_EQ(2 * zone_size + 0x2000, zones[2]);
+  ASSERT_EQ(3 * zone_size + 0x2000, zones[3]);
+  ASSERT_EQ(4 * zone_size, zones[4]);
+  b->close();
+
+  g_ceph_context->_conf.set_val("bdev_zoned_emulate_zone_size", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
 int main(int argc, char **argv) {
   auto args = argv_to_vec(argc, argv);
   map<string,string> defaults = {
@@ -11,6 +11,7 @@
 #include <random>
 #include <thread>
 #include <stack>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include "common/dout.h"
 #include "common/debug.h"
@@ -2426,6 +2427,84 @@ TEST(BlueFS, test_log_runway_advance_seq) {
   fs.umount();
 }
 
+// Appends small records to a WAL-like file while the log is compacted on
+// every fsync and reports the append+fsync latency distribution.
+static void bench_append_during_compaction(bool background)
+{
+  const unsigned num_files = 2000;
+  const unsigned num_appends = 500;
+  const unsigned append_size = 4096;
+  ConfSaver conf(g_ceph_context->_conf);
+  conf.SetVal("bluefs_alloc_size", "65536");
+  conf.SetVal("bluefs_compact_log_sync", "false");
+  conf.SetVal("bluefs_compact_log_background", background ? "true" : "false");
+  // make sure fsync always trigger log compact
+  conf.SetVal("bluefs_log_compact_min_ratio", "0");
+  conf.SetVal("bluefs_log_compact_min_size", "0");
+  conf.ApplyChanges();
+
+  uint64_t size = 1048576 * 256;
+  TempBdev bdev{size};
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(0, fs.maybe_verify_layout({ BlueFS::BDEV_DB, false, false }));
+
+  // give compaction some metadata to dump
+  ASSERT_EQ(0, fs.mkdir("meta"));
+  for (unsigned i = 0; i < num_files; i++) {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("meta", "file." + to_string(i), &h, false));
+    fs.close_writer(h);
+  }
+
+  auto buf = gen_buffer(append_size);
+  std::vector<double> lat_us;
+  lat_us.reserve(num_appends);
+  BlueFS::FileWriter *h;
+  ASSERT_EQ(0, fs.mkdir("db.wal"));
+  ASSERT_EQ(0, fs.open_for_write("db.wal", "000001.log", &h, false));
+  for (unsigned i = 0; i < num_appends; i++) {
+    auto t0 = std::chrono::steady_clock::now();
+    h->append(buf.get(), append_size);
+    fs.fsync(h);
+    auto t1 = std::chrono::steady_clock::now();
+    lat_us.push_back(
+      std::chrono::duration<double, std::micro>(t1 - t0).count());
+  }
+  fs.close_writer(h);
+
+  auto *logger = fs.get_perf_counters();
+  uint64_t compactions = logger->get(l_bluefs_log_compactions);
+  std::sort(lat_us.begin(), lat_us.end());
+  std::cout << (background ? "background" : "inline")
+            << " compaction: appends " << num_appends
+            << " compactions " << compactions
+            << " p50 " << lat_us[lat_us.size() / 2] << "us"
+            << " p99 " << lat_us[lat_us.size() * 99 / 100] << "us"
+            << " max " << lat_us.back() << "us"
+            << std::endl;
+  ASSERT_GT(compactions, 0u);
+
+  fs.umount();
+  ASSERT_EQ(0, fs.mount());
+  uint64_t file_size = 0;
+  utime_t mtime;
+  ASSERT_EQ(0, fs.stat("db.wal", "000001.log", &file_size, &mtime));
+  ASSERT_EQ(file_size, uint64_t(num_appends) * append_size);
+  std::vector<std::string> ls;
+  ASSERT_EQ(0, fs.readdir("meta", &ls));
+  ASSERT_EQ(ls.size(), num_files + 2); // "." and ".."
+  fs.umount();
+}
+
+TEST(BlueFS, bench_append_latency_during_compaction) {
+  bench_append_during_compaction(false);
+  bench_append_during_compaction(true);
+}
+
 TEST(BlueFS, test_69481_truncate_corrupts_log) {
   uint64_t size = 1048576 * 128;
   TempBdev bdev{size};
@@ -142,6 +142,115 @@ TEST(sb_info_space_efficient_map_t, size) {
   dump_mempools();
 }
 
+TEST(BufferCacheShard, arc_scan_resistance) {
+  const uint32_t bs = 4096;
+  BlueStore store(g_ceph_context, "", bs);
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc{
+      BlueStore::OnodeCacheShard::create(g_ceph_context, "lru", NULL)};
+  std::unique_ptr<BlueStore::BufferCacheShard> bc{
+      BlueStore::BufferCacheShard::create(
+        &store, "arc", const_cast<PerfCounters*>(store.get_perf_counters()))};
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc.get(), bc.get(), coll_t());
+  BlueStore::OnodeRef o = new BlueStore::Onode(coll.get(), ghobject_t(), "");
+  bc->set_max(16 * bs);
+
+  auto fill = [&](uint32_t block, int level) {
+    bufferlist bl;
+    bl.append(std::string(bs, 'a' + block % 26));
+    o->bc.did_read(bc.get(), block * bs, std::move(bl), level);
+  };
+  auto cached = [&](uint32_t block, uint32_t count) {
+    BlueStore::ready_regions_t res;
+    interval_set<uint32_t> res_intervals;
+    o->bc.read(bc.get(), block * bs, count * bs, res, res_intervals);
+    return res_intervals.size();
+  };
+
+  // a second reference moves the working set to the frequent list
+  for (uint32_t i = 0; i < 8; ++i) {
+    fill(i, 1);
+  }
+  ASSERT_EQ(8 * bs, cached(0, 8));
+
+  // a scan four times the cache size must not evict it
+  for (uint32_t i = 0; i < 64; ++i) {
+    fill(100 + i, 0);
+  }
+  ASSERT_LE(bc->_get_bytes(), 16 * bs);
+  ASSERT_EQ(64u * bs, bc->scan_admit_bytes);
+  ASSERT_EQ(8 * bs, cached(0, 8));
+  ASSERT_EQ(0u, bc->ghost_hits);
+
+  // one-time reads age out into history; coming back is a ghost hit
+  for (uint32_t i = 0; i < 16; ++i) {
+    fill(200 + i, 1);
+  }
+  ASSERT_LE(bc->_get_bytes(), 16 * bs);
+  ASSERT_EQ(0u, cached(200, 1));
+  fill(200, 1);
+  ASSERT_EQ(1u, bc->ghost_hits);
+  ASSERT_EQ(bs, cached(200, 1));
+}
+
+TEST(OnodeCacheShard, cold_tier) {
+  BlueStore store(g_ceph_context, "", 4096);
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc{
+      BlueStore::OnodeCacheShard::create(
+        g_ceph_context, "lru",
+        const_cast<PerfCounters*>(store.get_perf_counters()))};
+  std::unique_ptr<BlueStore::BufferCacheShard> bc{
+      BlueStore::BufferCacheShard::create(&store, "lru", NULL)};
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc.get(), bc.get(), coll_t());
+  oc->set_max(16);
+  oc->set_cold_max(1 << 20);
+
+  ghobject_t oid(hobject_t(sobject_t("cold", CEPH_NOSNAP)));
+  {
+    BlueStore::OnodeRef o = new BlueStore::Onode(coll.get(), oid, "");
+    o->exists = true;
+    o->onode.size = 0x1234;
+    o->onode.attrs["_"] = ceph::buffer::copy("value", 5);
+    unsigned n;
+    o->extent_map.encode_some(0, OBJECT_MAX_SIZE, o->extent_map.inline_bl, &n);
+    coll->onode_space.add_onode(oid, o);
+  }
+  uint64_t cold_onodes = 0, cold_bytes = 0;
+  oc->add_cold_stats(&cold_onodes, &cold_bytes);
+  ASSERT_EQ(0u, cold_onodes);
+
+  // trimming the decoded onode keeps its encoded form
+  oc->set_max(0);
+  oc->trim();
+  ASSERT_FALSE(coll->onode_space.lookup(oid));
+  oc->add_cold_stats(&cold_onodes, &cold_bytes);
+  ASSERT_EQ(1u, cold_onodes);
+  ASSERT_GT(cold_bytes, 0u);
+
+  bufferlist v;
+  ASSERT_TRUE(coll->onode_space.take_cold(oid, &v));
+  bufferlist v2;
+  ASSERT_FALSE(coll->onode_space.take_cold(oid, &v2));
+  BlueStore::OnodeRef o{BlueStore::Onode::create_decode(
+    coll, oid, "", v, false, false)};
+  ASSERT_TRUE(o->exists);
+  ASSERT_EQ(0x1234u, o->onode.size);
+  ASSERT_EQ(1u, o->onode.attrs.size());
+  ASSERT_EQ(std::string("value"),
+            std::string(o->onode.attrs["_"].c_str(), 5));
+
+  // nothing is kept once the tier has no budget
+  oc->set_max(16);
+  coll->onode_space.add_onode(oid, o);
+  o.reset();
+  oc->set_cold_max(0);
+  oc->set_max(0);
+  oc->trim();
+  cold_onodes = cold_bytes = 0;
+  oc->add_cold_stats(&cold_onodes, &cold_bytes);
+  ASSERT_EQ(0u, cold_onodes);
+  ASSERT_EQ(0u, cold_bytes);
+}
+
 TEST(bluestore_extent_ref_map_t, add) {
   bluestore_extent_ref_map_t m;
   m.get(10, 10);
@@ -420,6 +529,62 @@ TEST(bluestore_blob_t, csum_bench) {
   }
 }
 
+// split bl into pieces of varying size that do not line up with csum
+// chunks, the way reads assembled from several extents/buffers look
+static bufferlist fragment_bl(const bufferlist& bl, unsigned piece)
+{
+  bufferlist res;
+  unsigned off = 0;
+  unsigned n = 0;
+  while (off < bl.length()) {
+    unsigned len = std::min(piece + 511 * (n++ % 3), bl.length() - off);
+    bufferlist t;
+    t.substr_of(bl, off, len);
+    res.claim_append(t);
+    off += len;
+  }
+  return res;
+}
+
+TEST(bluestore_blob_t, csum_fragmented) {
+  bufferlist bl;
+  bufferptr bp(0x10000);
+  for (char *a = bp.c_str(); a < bp.c_str() + bp.length(); ++a)
+    *a = rand() & 0xff;
+  bl.append(bp);
+  bufferlist frag = fragment_bl(bl, 3000);
+  ASSERT_GT(frag.get_num_buffers(), 1u);
+
+  for (unsigned csum_type = Checksummer::CSUM_NONE + 1;
+       csum_type < Checksummer::CSUM_MAX; ++csum_type) {
+    for (unsigned order : {9, 12, 13}) {
+      cout << "csum_type " << Checksummer::get_csum_type_string(csum_type)
+           << " chunk " << (1u << order) << std::endl;
+      bluestore_blob_t a, b;
+      a.init_csum(csum_type, order, bl.length());
+      b.init_csum(csum_type, order, bl.length());
+      a.calc_csum(0, bl);
+      b.calc_csum(0, frag);
+      ASSERT_EQ(0, memcmp(a.csum_data.c_str(), b.csum_data.c_str(),
+                          a.csum_data.length()));
+
+      int bad_off;
+      uint64_t bad_csum;
+      ASSERT_EQ(0, a.verify_csum(0, frag, &bad_off, &bad_csum));
+      ASSERT_EQ(-1, bad_off);
+
+      // corrupt a byte somewhere past the first fragment
+      unsigned corrupt = 3000 + 4 * (1u << order);
+      bufferlist bad;
+      bad.append(bl.c_str(), bl.length());
+      bad.c_str()[corrupt] ^= 0x5a;
+      bufferlist bad_frag = fragment_bl(bad, 3000);
+      ASSERT_EQ(-1, a.verify_csum(0, bad_frag, &bad_off, &bad_csum));
+      ASSERT_EQ((int)(corrupt & ~((1u << order) - 1)), bad_off);
+    }
+  }
+}
+
 TEST(Blob, put_ref) {
   {
     BlueStore store(g_ceph_context, "", 4096);
@@ -8,9 +8,11 @@
 #include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <thread>
 
 #include "os/ObjectStore.h"
+#include "blk/kernel/io_uring.h"
 
 #include "global/global_init.h"
 
@@ -35,7 +37,12 @@ static void usage()
       "	 --threads\n"
       "	       number of threads to carry out this workload\n"
       "	 --multi-object\n"
-    "	       have each thread write to a separate object\n" << std::endl;
+      "	       have each thread write to a separate object\n"
+      "	 --random\n"
+      "	       write blocks at random block-aligned offsets\n"
+      "	 --compare-bdev-backends\n"
+      "	       run the workload on a fresh store with the libaio and then\n"
+      "	       the io_uring block device backend and compare the results\n" << std::endl;
   generic_server_usage();
 }
 
@@ -79,10 +86,19 @@ struct Config {
   int repeats;
   int threads;
   bool multi_object;
+  bool random;
+  bool compare_bdev_backends;
   Config()
     : size(1048576), block_size(4096),
       repeats(1), threads(1),
-      multi_object(false) {}
+      multi_object(false), random(false),
+      compare_bdev_backends(false) {}
+};
+
+struct Result {
+  uint64_t duration_us = 0;
+  size_t iops = 0;
+  byte_units rate = 0;
 };
 
 class C_NotifyCond : public Context {
@@ -115,6 +131,10 @@ void osbench_worker(ObjectStore *os, const Config &cfg,
   ObjectStore::CollectionHandle ch = os->open_collection(cid);
   ceph_assert(ch);
 
+  std::mt19937_64 rng(starting_offset);
+  std::uniform_int_distribution<uint64_t> block(
+    0, cfg.size / cfg.block_size - 1);
+
   for (int i = 0; i < cfg.repeats; ++i) {
     uint64_t offset = starting_offset;
     size_t len = cfg.size;
@@ -124,6 +144,8 @@ void osbench_worker(ObjectStore *os, const Config &cfg,
     std::cout << "Write cycle " << i << std::endl;
     while (len) {
       size_t count = len < cfg.block_size ? len : (size_t)cfg.block_size;
+      if (cfg.random)
+        offset = block(rng) * cfg.block_size;
 
       auto t = new ObjectStore::Transaction;
       t->write(cid, oid, offset, count, data);
@@ -150,77 +172,20 @@ void osbench_worker(ObjectStore *os, const Config &cfg,
   }
 }
 
-int main(int argc, const char *argv[])
+static int run_bench(const Config &cfg, const std::string &data_dir,
+                     Result *res)
 {
-  // command-line arguments
-  auto args = argv_to_vec(argc, argv);
-
-  if (args.empty()) {
-    cerr << argv[0] << ": -h or --help for usage" << std::endl;
-    exit(1);
-  }
-  if (ceph_argparse_need_usage(args)) {
-    usage();
-    exit(0);
-  }
-
-  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
-			 CODE_ENVIRONMENT_UTILITY,
-			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
-
-  Config cfg;
-  std::string val;
-  vector<const char*>::iterator i = args.begin();
-  while (i != args.end()) {
-    if (ceph_argparse_double_dash(args, i))
-      break;
-
-    if (ceph_argparse_witharg(args, i, &val, "--size", (char*)nullptr)) {
-      std::string err;
-      if (!cfg.size.parse(val, &err)) {
-        derr << "error parsing size: " << err << dendl;
-        exit(1);
-      }
-    } else if (ceph_argparse_witharg(args, i, &val, "--block-size", (char*)nullptr)) {
-      std::string err;
-      if (!cfg.block_size.parse(val, &err)) {
-        derr << "error parsing block-size: " << err << dendl;
-        exit(1);
-      }
-    } else if (ceph_argparse_witharg(args, i, &val, "--repeats", (char*)nullptr)) {
-      cfg.repeats = atoi(val.c_str());
-    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)nullptr)) {
-      cfg.threads = atoi(val.c_str());
-    } else if (ceph_argparse_flag(args, i, "--multi-object", (char*)nullptr)) {
-      cfg.multi_object = true;
-    } else {
-      derr << "Error: can't understand argument: " << *i << "\n" << dendl;
-      exit(1);
-    }
-  }
-
-  common_init_finish(g_ceph_context);
-
-  // create object store
-  dout(0) << "objectstore " << g_conf()->osd_objectstore << dendl;
-  dout(0) << "data " << g_conf()->osd_data << dendl;
-  dout(0) << "journal " << g_conf()->osd_journal << dendl;
-  dout(0) << "size " << cfg.size << dendl;
-  dout(0) << "block-size " << cfg.block_size << dendl;
-  dout(0) << "repeats " << cfg.repeats << dendl;
-  dout(0) << "threads " << cfg.threads << dendl;
-
   auto os =
       ObjectStore::create(g_ceph_context,
                           g_conf()->osd_objectstore,
-                          g_conf()->osd_data,
+                          data_dir,
                           g_conf()->osd_journal);
 
   //Checking data folder: create if needed or error if it's not empty
-  DIR *dir = ::opendir(g_conf()->osd_data.c_str());
+  DIR *dir = ::opendir(data_dir.c_str());
   if (!dir) {
     std::string cmd("mkdir -p ");
-    cmd+=g_conf()->osd_data;
+    cmd+=data_dir;
     int r = ::system( cmd.c_str() );
     if( r<0 ){
       derr << "Failed to create data directory, ret = " << r << dendl;
@@ -230,7 +195,7 @@ int main(int argc, const char *argv[])
   else {
      bool non_empty = readdir(dir) != NULL && readdir(dir) != NULL && readdir(dir) != NULL;
      if( non_empty ){
-       derr << "Data directory '"<<g_conf()->osd_data<<"' isn't empty, please clean it first."<< dendl;
+       derr << "Data directory '"<<data_dir<<"' isn't empty, please clean it first."<< dendl;
        return 1;
      }
   }
@@ -320,6 +285,9 @@ int main(int argc, const char *argv[])
   dout(0) << "Wrote " << total << " in "
       << duration.count() << "us, at a rate of " << rate << "/s and "
       << iops << " iops" << dendl;
+  res->duration_us = duration.count();
+  res->iops = iops;
+  res->rate = rate;
 
   // remove the objects
   ObjectStore::Transaction t;
@@ -330,3 +298,104 @@ int main(int argc, const char *argv[])
   os->umount();
   return 0;
 }
+
+int main(int argc, const char *argv[])
+{
+  // command-line arguments
+  auto args = argv_to_vec(argc, argv);
+
+  if (args.empty()) {
+    cerr << argv[0] << ": -h or --help for usage" << std::endl;
+    exit(1);
+  }
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  Config cfg;
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--size", (char*)nullptr)) {
+      std::string err;
+      if (!cfg.size.parse(val, &err)) {
+        derr << "error parsing size: " << err << dendl;
+        exit(1);
+      }
+    } else if (ceph_argparse_witharg(args, i, &val, "--block-size", (char*)nullptr)) {
+      std::string err;
+      if (!cfg.block_size.parse(val, &err)) {
+        derr << "error parsing block-size: " << err << dendl;
+        exit(1);
+      }
+    } else if (ceph_argparse_witharg(args, i, &val, "--repeats", (char*)nullptr)) {
+      cfg.repeats = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)nullptr)) {
+      cfg.threads = atoi(val.c_str());
+    } else if (ceph_argparse_flag(args, i, "--multi-object", (char*)nullptr)) {
+      cfg.multi_object = true;
+    } else if (ceph_argparse_flag(args, i, "--random", (char*)nullptr)) {
+      cfg.random = true;
+    } else if (ceph_argparse_flag(args, i, "--compare-bdev-backends", (char*)nullptr)) {
+      cfg.compare_bdev_backends = true;
+    } else {
+      derr << "Error: can't understand argument: " << *i << "\n" << dendl;
+      exit(1);
+    }
+  }
+
+  common_init_finish(g_ceph_context);
+
+  // create object store
+  dout(0) << "objectstore " << g_conf()->osd_objectstore << dendl;
+  dout(0) << "data " << g_conf()->osd_data << dendl;
+  dout(0) << "journal " << g_conf()->osd_journal << dendl;
+  dout(0) << "size " << cfg.size << dendl;
+  dout(0) << "block-size " << cfg.block_size << dendl;
+  dout(0) << "repeats " << cfg.repeats << dendl;
+  dout(0) << "threads " << cfg.threads << dendl;
+
+  if (!cfg.compare_bdev_backends) {
+    Result res;
+    return run_bench(cfg, g_conf()->osd_data, &res);
+  }
+
+  // KernelDevice quietly falls back to libaio without io_uring, which
+  // would compare libaio against itself
+  if (!ioring_queue_t::supported()) {
+    derr << "--compare-bdev-backends: io_uring is not supported on this"
+         << " host" << dendl;
+    return 1;
+  }
+
+  // same workload on a fresh store per backend
+  Result aio, ioring;
+  g_conf().set_val_or_die("bdev_ioring", "false");
+  g_conf().apply_changes(nullptr);
+  int r = run_bench(cfg, g_conf()->osd_data + "/aio", &aio);
+  if (r)
+    return r;
+  g_conf().set_val_or_die("bdev_ioring", "true");
+  g_conf().apply_changes(nullptr);
+  r = run_bench(cfg, g_conf()->osd_data + "/io_uring", &ioring);
+  if (r)
+    return r;
+
+  dout(0) << "libaio:   " << aio.iops << " iops, " << aio.rate << "/s" << dendl;
+  dout(0) << "io_uring: " << ioring.iops << " iops, " << ioring.rate << "/s"
+          << " (sqpoll " << g_conf().get_val<bool>("bdev_ioring_sqthread_poll")
+          << ")" << dendl;
+  if (aio.iops) {
+    dout(0) << "io_uring/libaio iops ratio: "
+            << (double)ioring.iops / aio.iops << dendl;
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include <map>
+
+#include "gtest/gtest.h"
+#include "osd/BackfillReadahead.h"
+#include "osd/osd_internal_types.h"
+
+namespace {
+
+hobject_t make_hoid(const char *name)
+{
+  return hobject_t(object_t(name), "", CEPH_NOSNAP, 0, 1, "");
+}
+
+ObjectContextRef make_obc(const hobject_t& hoid, eversion_t v, bool exists)
+{
+  auto obc = std::make_shared<ObjectContext>();
+  obc->obs.oi = object_info_t(hoid);
+  obc->obs.oi.version = v;
+  obc->obs.exists = exists;
+  return obc;
+}
+
+} // anonymous namespace
+
+TEST(BackfillReadahead, RevalidateKeepsUncached)
+{
+  std::set<pg_shard_t> targets{pg_shard_t(1, shard_id_t::NO_SHARD)};
+  PrimaryBackfillInterval bi;
+  bi.add(make_hoid("a"), eversion_t(1, 1), {}, targets);
+  bi.add(make_hoid("b"), eversion_t(1, 2), {}, targets);
+  auto before = bi.objects;
+
+  BackfillReadahead::revalidate(&bi, targets, [](const hobject_t&) {
+    return ObjectContextRef();
+  });
+  ASSERT_EQ(before, bi.objects);
+}
+
+TEST(BackfillReadahead, RevalidateTakesCachedVersions)
+{
+  // a write in flight when the interval was scanned off the PG lock
+  // shows up in the object context only
+  std::set<pg_shard_t> targets{pg_shard_t(1, shard_id_t::NO_SHARD)};
+  hobject_t a = make_hoid("a"), b = make_hoid("b"), c = make_hoid("c");
+  PrimaryBackfillInterval bi;
+  bi.begin = a;
+  bi.end = make_hoid("d");
+  bi.add(a, eversion_t(1, 1), {}, targets);
+  bi.add(b, eversion_t(1, 2), {}, targets);
+  bi.add(c, eversion_t(1, 3), {}, targets);
+
+  std::map<hobject_t, ObjectContextRef> cached{
+    {a, make_obc(a, eversion_t(1, 5), true)},
+    {b, make_obc(b, eversion_t(1, 6), false)},
+  };
+  BackfillReadahead::revalidate(&bi, targets, [&](const hobject_t& hoid) {
+    auto p = cached.find(hoid);
+    return p == cached.end() ? ObjectContextRef() : p->second;
+  });
+
+  ASSERT_EQ(2u, bi.objects.size());
+  ASSERT_EQ(1u, bi.objects.count(a));
+  ASSERT_EQ(eversion_t(1, 5), bi.objects.find(a)->second.second);
+  ASSERT_EQ(0u, bi.objects.count(b));
+  ASSERT_EQ(eversion_t(1, 3), bi.objects.find(c)->second.second);
+  ASSERT_EQ(a, bi.begin);
+}
+
+TEST(BackfillReadahead, RevalidateShardVersions)
+{
+  // an optimized EC partial write leaves shard 1 behind
+  std::set<pg_shard_t> targets{pg_shard_t(1, shard_id_t(1)),
+                               pg_shard_t(2, shard_id_t(2))};
+  hobject_t a = make_hoid("a");
+  PrimaryBackfillInterval bi;
+  bi.add(a, eversion_t(1, 1), {}, targets);
+  ASSERT_EQ(1u, bi.objects.count(a));
+
+  auto obc = make_obc(a, eversion_t(1, 4), true);
+  obc->obs.oi.shard_versions[shard_id_t(1)] = eversion_t(1, 2);
+  BackfillReadahead::revalidate(&bi, targets, [&](const hobject_t&) {
+    return obc;
+  });
+
+  ASSERT_EQ(2u, bi.objects.count(a));
+  std::map<shard_id_t, eversion_t> got;
+  auto [first, last] = bi.objects.equal_range(a);
+  for (auto p = first; p != last; ++p) {
+    got[p->second.first] = p->second.second;
+  }
+  ASSERT_EQ(eversion_t(1, 2), got[shard_id_t(1)]);
+  ASSERT_EQ(eversion_t(1, 4), got[shard_id_t::NO_SHARD]);
+}
@@ -195,6 +195,77 @@ TEST_F(mClockSchedulerTest, TestMultiClientOrderedEnqueueDequeue) {
   ASSERT_TRUE(q.empty());
 }
 
+TEST_F(mClockSchedulerTest, TestStagedEnqueueDequeue) {
+  // ops staged by the OSD reach the scheduler later, in batches, and
+  // must come out as if enqueued when they arrived
+  const unsigned NUM = 100;
+  std::vector<std::pair<OpSchedulerItem, ceph::real_time>> staged;
+  for (unsigned i = 0; i < NUM; ++i) {
+    for (auto &&c: {client1, client2, client3}) {
+      staged.emplace_back(create_item(i, c, SchedulerClass::client),
+                          ceph::real_clock::now());
+      std::this_thread::sleep_for(std::chrono::microseconds(1));
+    }
+  }
+  std::this_thread::sleep_for(5ms);
+  for (auto& [item, arrival] : staged) {
+    q.enqueue_staged(std::move(item), arrival);
+  }
+
+  std::map<uint64_t, epoch_t> next;
+  for (auto &&c: {client1, client2, client3}) {
+    next[c] = 0;
+  }
+  for (unsigned i = 0; i < NUM * 3; ++i) {
+    ASSERT_FALSE(q.empty());
+    auto r = get_item(q.dequeue());
+    auto niter = next.find(r.get_owner());
+    ASSERT_FALSE(niter == next.end());
+    ASSERT_EQ(niter->second, r.get_map_epoch());
+    niter->second++;
+  }
+  ASSERT_TRUE(q.empty());
+}
+
+TEST_F(mClockSchedulerTest, TestStagedArrivalTags) {
+  // client ops staged before a background op was enqueued must be
+  // tagged by their arrival, ahead of it, even though they reach the
+  // scheduler after it does
+  const unsigned NUM = 10;
+  std::vector<std::pair<OpSchedulerItem, ceph::real_time>> staged;
+  for (unsigned i = 0; i < NUM; ++i) {
+    staged.emplace_back(create_item(i, client1, SchedulerClass::client),
+                        ceph::real_clock::now());
+  }
+  std::this_thread::sleep_for(20ms);
+  q.enqueue(create_item(NUM, client2,
+                        SchedulerClass::background_best_effort));
+  std::this_thread::sleep_for(1ms);
+  for (auto& [item, arrival] : staged) {
+    q.enqueue_staged(std::move(item), arrival);
+  }
+
+  for (unsigned i = 0; i < NUM; ++i) {
+    ASSERT_FALSE(q.empty());
+    auto r = get_item(q.dequeue());
+    ASSERT_EQ(client1, r.get_owner());
+    ASSERT_EQ(i, r.get_map_epoch());
+  }
+  auto r = get_item(q.dequeue());
+  ASSERT_EQ(client2, r.get_owner());
+  ASSERT_TRUE(q.empty());
+
+  // the same ops enqueued on arrival at the scheduler come after it
+  q.enqueue(create_item(NUM, client2,
+                        SchedulerClass::background_best_effort));
+  std::this_thread::sleep_for(1ms);
+  for (unsigned i = 0; i < NUM; ++i) {
+    q.enqueue(create_item(i, client1, SchedulerClass::client));
+  }
+  r = get_item(q.dequeue());
+  ASSERT_EQ(client2, r.get_owner());
+}
+
 TEST_F(mClockSchedulerTest, TestHighPriorityQueueEnqueueDequeue) {
   ASSERT_TRUE(q.empty());
   for (unsigned i = 200; i < 205; ++i) {
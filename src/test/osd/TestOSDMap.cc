@@ -11,6 +11,7 @@
 #include "common/ceph_argparse.h"
 #include "common/ceph_json.h"
 #include "crush/CrushWrapper.h"
+#include "include/scope_guard.h"
 #include "include/stringify.h"
 
 #include <iostream>
@@ -547,6 +548,142 @@ TEST_F(OSDMapTest, MapFunctionsMatch) {
   EXPECT_EQ(acting_osds, acting_osds_two);
 }
 
+TEST_F(OSDMapTest, BatchMapMatches) {
+  set_up_map();
+  // a pg_temp and an upmap, so the batch path goes through both
+  pg_t pg0(0, my_rep_pool), pg1(1, my_rep_pool);
+  vector<int> up, acting;
+  osdmap.pg_to_up_acting_osds(pg0, up, acting);
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.new_pg_temp[pg0] = mempool::osdmap::vector<int>(
+    acting.rbegin(), acting.rend());
+  osdmap.pg_to_up_acting_osds(pg1, up, acting);
+  for (int osd = 0; osd < (int)get_num_osds(); ++osd) {
+    if (std::find(up.begin(), up.end(), osd) == up.end()) {
+      inc.new_pg_upmap_items[pg1] =
+        mempool::osdmap::vector<pair<int32_t,int32_t>>{{up[0], osd}};
+      break;
+    }
+  }
+  osdmap.apply_incremental(inc);
+
+  for (auto pool : {my_ec_pool, my_rep_pool}) {
+    unsigned pg_num = osdmap.get_pg_pool(pool)->get_pg_num();
+    unsigned seen = 0;
+    osdmap.pgs_to_up_acting_osds(
+      pool, 0, pg_num + 2,
+      [&](unsigned ps, vector<int>&& up, int up_primary,
+          vector<int>&& acting, int acting_primary) {
+        ASSERT_EQ(seen++, ps);
+        vector<int> up2, acting2;
+        int up_primary2, acting_primary2;
+        osdmap.pg_to_up_acting_osds(pg_t(ps, pool), &up2, &up_primary2,
+                                    &acting2, &acting_primary2);
+        ASSERT_EQ(up2, up);
+        ASSERT_EQ(up_primary2, up_primary);
+        ASSERT_EQ(acting2, acting);
+        ASSERT_EQ(acting_primary2, acting_primary);
+      });
+    ASSERT_EQ(pg_num + 2, seen);
+  }
+}
+
+TEST_F(OSDMapTest, IncrementalMapping) {
+  set_up_map(12);
+  auto check = [&](OSDMap::Incremental& inc, bool incremental) {
+    osdmap.apply_incremental(inc);
+    ASSERT_EQ(incremental, mapping.update(osdmap, inc));
+    ASSERT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+    map<int, set<pg_t>> rmap;
+    for (auto& [pool, pi] : osdmap.get_pools()) {
+      for (unsigned ps = 0; ps < pi.get_pg_num(); ++ps) {
+        pg_t pgid(ps, pool);
+        vector<int> up, acting, up2, acting2;
+        int up_primary, acting_primary, up_primary2, acting_primary2;
+        osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+                                    &acting, &acting_primary);
+        mapping.get(pgid, &up2, &up_primary2, &acting2, &acting_primary2);
+        ASSERT_EQ(up, up2);
+        ASSERT_EQ(up_primary, up_primary2);
+        ASSERT_EQ(acting, acting2);
+        ASSERT_EQ(acting_primary, acting_primary2);
+        for (auto osd : acting) {
+          if (osd != CRUSH_ITEM_NONE) {
+            rmap[osd].insert(pgid);
+          }
+        }
+      }
+    }
+    for (int osd = 0; osd < osdmap.get_max_osd(); ++osd) {
+      auto& pgs = mapping.get_osd_acting_pgs(osd);
+      ASSERT_EQ(rmap[osd], set<pg_t>(pgs.begin(), pgs.end()));
+    }
+  };
+
+  pg_t pg0(0, my_rep_pool), pg1(1, my_rep_pool);
+  vector<int> up, acting;
+  {
+    // nothing to start from yet
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    osdmap.pg_to_up_acting_osds(pg0, up, acting);
+    inc.new_pg_temp[pg0] = mempool::osdmap::vector<int>(
+      acting.rbegin(), acting.rend());
+    check(inc, false);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[1] = CEPH_OSD_UP;
+    check(inc, true);
+    ASSERT_TRUE(osdmap.is_down(1));
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_primary_affinity[2] = CEPH_OSD_MAX_PRIMARY_AFFINITY / 4;
+    check(inc, true);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    osdmap.pg_to_up_acting_osds(pg1, up, acting);
+    for (int osd = 0; osd < osdmap.get_max_osd(); ++osd) {
+      if (osdmap.is_up(osd) &&
+          std::find(up.begin(), up.end(), osd) == up.end()) {
+        inc.new_pg_upmap_items[pg1] =
+          mempool::osdmap::vector<pair<int32_t,int32_t>>{{up[0], osd}};
+        break;
+      }
+    }
+    inc.new_pg_temp[pg0] = {};
+    check(inc, true);
+  }
+  {
+    // no placement change at all
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_up_thru[0] = osdmap.get_epoch();
+    check(inc, true);
+  }
+  {
+    // crush may pick osd.1 again for any pg
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    entity_addrvec_t sample_addrs;
+    sample_addrs.v.push_back(entity_addr_t());
+    inc.new_up_client[1] = sample_addrs;
+    inc.new_up_cluster[1] = sample_addrs;
+    inc.new_hb_back_up[1] = sample_addrs;
+    inc.new_hb_front_up[1] = sample_addrs;
+    check(inc, false);
+    ASSERT_TRUE(osdmap.is_up(1));
+  }
+  {
+    // a mapping two epochs behind can't follow
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[3] = CEPH_OSD_UP;
+    osdmap.apply_incremental(inc);
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.new_state[4] = CEPH_OSD_UP;
+    check(inc2, false);
+  }
+}
+
 /** This test must be removed or modified appropriately when we allow
  * other ways to specify a primary. */
 TEST_F(OSDMapTest, PrimaryIsFirst) {
@@ -1926,6 +2063,73 @@ TEST_F(OSDMapTest, TryDropRemapOverfullBothOverfull) {
   }
 }
 
+TEST_F(OSDMapTest, CalcPgUpmapsKeepsState) {
+  set_up_map(12);
+  // pile a few pgs onto osd.0 so there is something to balance
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    for (unsigned ps = 0; ps < 64 && inc.new_pg_upmap_items.size() < 12; ++ps) {
+      pg_t pg(ps, my_rep_pool);
+      vector<int> up, acting;
+      osdmap.pg_to_up_acting_osds(pg, up, acting);
+      if (std::find(up.begin(), up.end(), 0) == up.end()) {
+        inc.new_pg_upmap_items[pg] =
+          mempool::osdmap::vector<pair<int32_t,int32_t>>{{up[1], 0}};
+      }
+    }
+    osdmap.apply_incremental(inc);
+  }
+  // no shuffling, so both runs take the same path
+  auto aggressively =
+    g_ceph_context->_conf.get_val<bool>("osd_calc_pg_upmaps_aggressively");
+  auto restore = make_scope_guard([aggressively] {
+    g_ceph_context->_conf.set_val("osd_calc_pg_upmaps_aggressively",
+                                  aggressively ? "true" : "false");
+  });
+  g_ceph_context->_conf.set_val("osd_calc_pg_upmaps_aggressively", "false");
+
+  OSDMap nostate;
+  nostate.deepish_copy_from(osdmap);
+  set<int64_t> only_pools = {(int64_t)my_rep_pool};
+  OSDMap::upmap_state_t state;
+  int rounds = 0, reused = 0;
+  for (; rounds < 50; ++rounds) {
+    bool valid = state.is_valid(osdmap.get_epoch(), only_pools);
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1), inc2(inc.epoch);
+    int did = osdmap.calc_pg_upmaps(g_ceph_context, 1, 2, only_pools, &inc,
+                                    nullptr, &state);
+    int did2 = nostate.calc_pg_upmaps(g_ceph_context, 1, 2, only_pools, &inc2);
+    ASSERT_EQ(did2, did);
+    ASSERT_EQ(inc2.old_pg_upmap_items, inc.old_pg_upmap_items);
+    ASSERT_EQ(inc2.new_pg_upmap_items, inc.new_pg_upmap_items);
+    if (!did) {
+      break;
+    }
+    reused += valid;
+    ASSERT_EQ(osdmap.get_epoch(), state.epoch);
+    // the moves are only in inc, a fresh one at this epoch starts over
+    ASSERT_FALSE(state.is_valid(osdmap.get_epoch(), only_pools));
+    osdmap.apply_incremental(inc);
+    nostate.apply_incremental(inc2);
+  }
+  ASSERT_GT(rounds, 1);
+  ASSERT_EQ(rounds - 1, reused);
+
+  // what the state tracked is what the map does
+  map<int,set<pg_t>> pgs_by_osd;
+  for (unsigned ps = 0; ps < 64; ++ps) {
+    pg_t pg(ps, my_rep_pool);
+    vector<int> up, acting;
+    osdmap.pg_to_up_acting_osds(pg, up, acting);
+    for (auto osd : up) {
+      pgs_by_osd[osd].insert(pg);
+    }
+  }
+  for (auto& [osd, pgs] : state.pgs_by_osd) {
+    ASSERT_EQ(pgs_by_osd[osd], pgs);
+  }
+}
+
 TEST_F(OSDMapTest, BUG_63137_calc_pg_upmaps_perf) {
   // https://tracker.ceph.com/issues/63137
   //
@@ -0,0 +1,184 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "gtest/gtest.h"
+#include "global/global_context.h"
+#include "include/ceph_features.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+#include "messages/MOSDRepOp.h"
+#include "messages/MOSDRepOpBatch.h"
+#include "messages/MOSDRepOpReply.h"
+
+namespace {
+
+/// encode m as it would go on the wire and decode it back
+template <typename T>
+ceph::ref_t<T> round_trip(Message *m, uint64_t features = CEPH_FEATURES_ALL)
+{
+  ceph::buffer::list bl;
+  encode_message(m, features, bl);
+  auto p = bl.cbegin();
+  ceph::ref_t<Message> n(decode_message(g_ceph_context, 0, p), false);
+  EXPECT_TRUE(p.end());
+  EXPECT_TRUE(n);
+  return ceph::ref_cast<T>(n);
+}
+
+} // anonymous namespace
+
+TEST(MOSDRepOpBatch, RoundTrip)
+{
+  spg_t pgid(pg_t(7, 3), shard_id_t::NO_SHARD);
+  hobject_t poid(object_t("obj"), "", CEPH_NOSNAP, 0x1234, 3, "");
+  auto op = ceph::make_message<MOSDRepOp>(
+    osd_reqid_t(entity_name_t::CLIENT(4), 0, 100),
+    pg_shard_t(0), pgid, poid, CEPH_OSD_FLAG_ONDISK,
+    20, 18, 55, eversion_t(20, 9));
+  bufferlist txn;
+  txn.append("transaction");
+  op->set_txn_payload(txn);
+
+  auto reply = ceph::make_message<MOSDRepOpReply>();
+  reply->map_epoch = 20;
+  reply->min_epoch = 18;
+  reply->reqid = osd_reqid_t(entity_name_t::CLIENT(5), 0, 101);
+  reply->pgid = pgid;
+  reply->from = pg_shard_t(1);
+  reply->ack_type = CEPH_OSD_FLAG_ONDISK;
+  reply->result = 0;
+  reply->set_last_complete_ondisk(eversion_t(20, 8));
+  reply->set_tid(56);
+  reply->set_priority(CEPH_MSG_PRIO_HIGH);
+
+  auto batch = ceph::make_message<MOSDRepOpBatch>(
+    std::vector<Message*>{op->get(), reply->get()});
+  ASSERT_EQ(CEPH_MSG_PRIO_HIGH, batch->get_priority());
+
+  auto decoded = round_trip<MOSDRepOpBatch>(batch.get());
+  ASSERT_TRUE(decoded);
+  ASSERT_EQ(MSG_OSD_REPOP_BATCH, decoded->get_type());
+  ASSERT_EQ(2u, decoded->size());
+  auto msgs = decoded->claim_messages();
+  ASSERT_EQ(2u, msgs.size());
+
+  ceph::ref_t<MOSDRepOp> dop(static_cast<MOSDRepOp*>(msgs[0]), false);
+  ASSERT_EQ(MSG_OSD_REPOP, dop->get_type());
+  dop->finish_decode();
+  ASSERT_EQ(op->reqid, dop->reqid);
+  ASSERT_EQ(pgid, dop->pgid);
+  ASSERT_EQ(poid, dop->poid);
+  ASSERT_EQ(eversion_t(20, 9), dop->version);
+  ASSERT_EQ(20u, dop->get_map_epoch());
+  ASSERT_EQ(18u, dop->get_min_epoch());
+  ASSERT_EQ(55u, dop->get_tid());
+  ASSERT_TRUE(dop->get_middle().contents_equal(txn));
+
+  ceph::ref_t<MOSDRepOpReply> dreply(static_cast<MOSDRepOpReply*>(msgs[1]),
+                                     false);
+  ASSERT_EQ(MSG_OSD_REPOPREPLY, dreply->get_type());
+  dreply->finish_decode();
+  ASSERT_EQ(reply->reqid, dreply->reqid);
+  ASSERT_EQ(pg_shard_t(1), dreply->from);
+  ASSERT_TRUE(dreply->is_ondisk());
+  ASSERT_EQ(0, dreply->get_result());
+  ASSERT_EQ(eversion_t(20, 8), dreply->get_last_complete_ondisk());
+  ASSERT_EQ(56u, dreply->get_tid());
+}
+
+TEST(MOSDRepOpBatch, Empty)
+{
+  auto batch = ceph::make_message<MOSDRepOpBatch>(std::vector<Message*>{});
+  auto decoded = round_trip<MOSDRepOpBatch>(batch.get());
+  ASSERT_TRUE(decoded);
+  ASSERT_EQ(0u, decoded->size());
+}
+
+namespace {
+
+ceph::ref_t<MOSDOpReply> make_op_reply()
+{
+  hobject_t hoid(object_t("obj"), "", CEPH_NOSNAP, 0x1234, 3, "");
+  spg_t pgid(pg_t(0x1234, 3));
+  auto op = ceph::make_message<MOSDOp>(0, 77, hoid, pgid, 20,
+                                       CEPH_OSD_FLAG_READ, 0);
+  OSDOp read;
+  read.op.op = CEPH_OSD_OP_READ;
+  op->ops.push_back(read);
+  return ceph::make_message<MOSDOpReply>(op.get(), 0, 20,
+                                         CEPH_OSD_FLAG_ONDISK, true);
+}
+
+/// decode payload, encoded at HEAD_VERSION, as a message of version
+ceph::ref_t<MOSDOpReply> decode_as(const MOSDOpReply& m,
+                                   const ceph::buffer::list& payload,
+                                   __u16 version)
+{
+  auto n = ceph::make_message<MOSDOpReply>();
+  ceph_msg_header h = m.get_header();
+  h.version = version;
+  n->set_header(h);
+  n->set_payload(payload);
+  n->set_data(m.get_data());
+  n->decode_payload();
+  return n;
+}
+
+void check_reply(MOSDOpReply& m)
+{
+  ASSERT_EQ(object_t("obj"), m.get_oid());
+  ASSERT_EQ(pg_t(0x1234, 3), m.get_pg());
+  ASSERT_EQ(20u, m.get_map_epoch());
+  ASSERT_EQ(0, m.get_result());
+  ASSERT_TRUE(m.is_ondisk());
+  std::vector<OSDOp> ops;
+  m.claim_ops(ops);
+  ASSERT_EQ(1u, ops.size());
+  ASSERT_EQ(CEPH_OSD_OP_READ, ops[0].op.op);
+}
+
+} // anonymous namespace
+
+TEST(MOSDOpReply, LoadHintRoundTrip)
+{
+  auto reply = make_op_reply();
+  reply->set_load_hint(12, 850);
+  auto decoded = round_trip<MOSDOpReply>(reply.get());
+  ASSERT_TRUE(decoded);
+  ASSERT_EQ(9, decoded->get_header().version);
+  check_reply(*decoded);
+  ASSERT_EQ(12u, decoded->get_load_queue_depth());
+  ASSERT_EQ(850u, decoded->get_load_latency_us());
+  ASSERT_EQ(77u, decoded->get_tid());
+}
+
+TEST(MOSDOpReply, LoadHintFromV8)
+{
+  // a v8 reply is a v9 one without the trailing hint
+  auto reply = make_op_reply();
+  reply->set_load_hint(12, 850);
+  reply->encode_payload(CEPH_FEATURES_ALL);
+  ASSERT_EQ(9, reply->get_header().version);
+  const auto& payload = reply->get_payload();
+  ceph::buffer::list v8;
+  v8.substr_of(payload, 0, payload.length() - 2 * sizeof(uint32_t));
+
+  auto decoded = decode_as(*reply, v8, 8);
+  check_reply(*decoded);
+  // no hint: the objecter takes the osd as idle
+  ASSERT_EQ(0u, decoded->get_load_queue_depth());
+  ASSERT_EQ(0u, decoded->get_load_latency_us());
+}
+
+TEST(MOSDOpReply, LoadHintToV8)
+{
+  // a v8 decoder reads what it knows of a v9 reply and leaves the hint
+  auto reply = make_op_reply();
+  reply->set_load_hint(12, 850);
+  reply->encode_payload(CEPH_FEATURES_ALL);
+
+  auto decoded = decode_as(*reply, reply->get_payload(), 8);
+  check_reply(*decoded);
+  ASSERT_EQ(0u, decoded->get_load_queue_depth());
+  ASSERT_EQ(0u, decoded->get_load_latency_us());
+}
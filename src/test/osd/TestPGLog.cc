@@ -3967,3 +3967,42 @@ TEST_F(PGLogTest, merge_log_epoch_change_basic) {
   ASSERT_EQ(2, missing.num_missing());
   ASSERT_EQ(2, missing.get_rmissing().size());
 }
+
+TEST(ReqIdIndex, InsertFindErase) {
+  std::vector<pg_log_dup_t> dups;
+  for (unsigned c = 0; c < 4; ++c) {
+    for (unsigned tid = 1; tid <= 500; ++tid) {
+      dups.emplace_back(eversion_t(1, dups.size() + 1), tid,
+			osd_reqid_t(entity_name_t::CLIENT(c), 0, tid), 0);
+    }
+  }
+  ReqIdIndex<pg_log_dup_t> index;
+  EXPECT_EQ(nullptr, index.find(dups[0].reqid));
+  for (auto& d : dups) {
+    index.insert_or_assign(&d);
+  }
+  ASSERT_EQ(dups.size(), index.size());
+
+  // same reqid replaces, conditional erase respects the current entry
+  pg_log_dup_t again(eversion_t(2, 1), 1, dups[7].reqid, 0);
+  index.insert_or_assign(&again);
+  EXPECT_EQ(dups.size(), index.size());
+  EXPECT_EQ(&again, index.find(dups[7].reqid));
+  EXPECT_FALSE(index.erase(dups[7].reqid, &dups[7]));
+  EXPECT_TRUE(index.erase(dups[7].reqid, &again));
+  index.insert_or_assign(&dups[7]);
+
+  // erasing must not lose anything sharing a probe run
+  for (size_t i = 0; i < dups.size(); i += 2) {
+    EXPECT_TRUE(index.erase(dups[i].reqid));
+  }
+  EXPECT_EQ(dups.size() / 2, index.size());
+  for (size_t i = 0; i < dups.size(); ++i) {
+    EXPECT_EQ(i % 2 ? &dups[i] : nullptr, index.find(dups[i].reqid));
+  }
+  EXPECT_FALSE(index.erase(dups[0].reqid));
+
+  index.clear();
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(0u, index.count(dups[1].reqid));
+}
@@ -0,0 +1,179 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Times the PGLog::IndexedLog operations that dominate peering: index
+ * rebuilds, reqid lookups through caller_ops and dup_index, and trim,
+ * for a number of PGs with full logs.  The same lookups are also run
+ * against a std::unordered_map for comparison.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+#include "common/Clock.h"
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "osd/PGLog.h"
+
+using namespace std;
+
+void usage(const char *name) {
+  cout << name << " [--pgs N] [--entries N] [--dups N] [--clients N]\n"
+       << "\t pgs: number of PG logs, default 100\n"
+       << "\t entries: log entries per PG, default 3000\n"
+       << "\t dups: dup entries per PG, default 3000\n"
+       << "\t clients: distinct clients issuing the ops, default 64\n";
+}
+
+static pg_log_t make_log(unsigned entries, unsigned dups,
+                         unsigned clients, std::mt19937& rng)
+{
+  pg_log_t l;
+  std::uniform_int_distribution<unsigned> client(0, clients - 1);
+  vector<ceph_tid_t> tids(clients, 0);
+  for (unsigned i = 1; i <= dups + entries; ++i) {
+    unsigned c = client(rng);
+    osd_reqid_t r(entity_name_t::CLIENT(c), 0, ++tids[c]);
+    eversion_t v(1, i);
+    if (i <= dups) {
+      l.dups.push_back(pg_log_dup_t(v, i, r, 0));
+      continue;
+    }
+    pg_log_entry_t e;
+    e.mark_unrollbackable();
+    e.op = pg_log_entry_t::MODIFY;
+    e.soid = hobject_t(object_t("obj" + to_string(i % 512)), "", CEPH_NOSNAP,
+                       i % 512, 1, "");
+    e.version = v;
+    e.prior_version = eversion_t(1, i - 1);
+    e.reqid = r;
+    e.user_version = i;
+    l.log.push_back(e);
+  }
+  l.tail = eversion_t(1, dups);
+  l.head = eversion_t(1, dups + entries);
+  l.can_rollback_to = l.head;
+  l.rollback_info_trimmed_to = l.head;
+  return l;
+}
+
+int main(int argc, const char **argv)
+{
+  auto args = argv_to_vec(argc, argv);
+  if (ceph_argparse_need_usage(args)) {
+    usage(argv[0]);
+    return EXIT_SUCCESS;
+  }
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_OSD,
+                         CODE_ENVIRONMENT_UTILITY,
+                         CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  unsigned pgs = 100, entries = 3000, dups = 3000, clients = 64;
+  for (auto i = args.begin(); i != args.end();) {
+    string val;
+    if (ceph_argparse_witharg(args, i, &val, "--pgs", (char*)NULL)) {
+      pgs = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--entries", (char*)NULL)) {
+      entries = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--dups", (char*)NULL)) {
+      dups = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--clients", (char*)NULL)) {
+      clients = std::max(1, atoi(val.c_str()));
+    } else {
+      cerr << "unknown option " << *i << std::endl;
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  cout << pgs << " pgs, " << entries << " entries, " << dups << " dups, "
+       << clients << " clients" << std::endl;
+
+  std::mt19937 rng(0);
+  size_t before = mempool::osd_pglog::allocated_bytes();
+  vector<PGLog::IndexedLog> logs;
+  logs.reserve(pgs);
+  utime_t start = ceph_clock_now();
+  for (unsigned i = 0; i < pgs; ++i) {
+    logs.emplace_back(make_log(entries, dups, clients, rng));
+  }
+  utime_t t = ceph_clock_now() - start;
+  size_t per_pg = (mempool::osd_pglog::allocated_bytes() - before) / pgs;
+  cout << "build + index " << t << " s, " << per_pg
+       << " bytes/pg in osd_pglog" << std::endl;
+
+  start = ceph_clock_now();
+  for (auto& l : logs) {
+    l.unindex();
+    l.index();
+  }
+  cout << "reindex " << (ceph_clock_now() - start) << " s" << std::endl;
+
+  // every reqid once, plus as many that were never seen
+  vector<osd_reqid_t> reqids;
+  for (auto& e : logs[0].log) {
+    reqids.push_back(e.reqid);
+  }
+  for (auto& d : logs[0].dups) {
+    reqids.push_back(d.reqid);
+  }
+  for (size_t i = 0, n = reqids.size(); i < n; ++i) {
+    reqids.push_back(osd_reqid_t(entity_name_t::CLIENT(clients + i), 0, i));
+  }
+  std::shuffle(reqids.begin(), reqids.end(), rng);
+
+  eversion_t version;
+  version_t user_version;
+  int return_code;
+  vector<pg_log_op_return_item_t> op_returns;
+  size_t found = 0;
+  start = ceph_clock_now();
+  for (auto& l : logs) {
+    for (auto& r : reqids) {
+      found += l.get_request(r, &version, &user_version, &return_code,
+                             &op_returns);
+    }
+  }
+  t = ceph_clock_now() - start;
+  cout << "get_request " << t << " s, "
+       << (double)t / (pgs * reqids.size()) * 1e9 << " ns/lookup, "
+       << found << " found" << std::endl;
+
+  {
+    std::unordered_map<osd_reqid_t, pg_log_entry_t*> caller_ops;
+    std::unordered_map<osd_reqid_t, pg_log_dup_t*> dup_index;
+    for (auto& e : logs[0].log) {
+      caller_ops[e.reqid] = &e;
+    }
+    for (auto& d : logs[0].dups) {
+      dup_index[d.reqid] = &d;
+    }
+    found = 0;
+    start = ceph_clock_now();
+    for (unsigned i = 0; i < pgs; ++i) {
+      for (auto& r : reqids) {
+        found += caller_ops.count(r) || dup_index.count(r);
+      }
+    }
+    t = ceph_clock_now() - start;
+    cout << "unordered_map baseline " << t << " s, "
+         << (double)t / (pgs * reqids.size()) * 1e9 << " ns/lookup, "
+         << found << " found" << std::endl;
+  }
+
+  // trim half of each log into the dups
+  g_ceph_context->_conf.set_val("osd_pg_log_dups_tracked",
+                                stringify(dups + entries));
+  start = ceph_clock_now();
+  for (auto& l : logs) {
+    eversion_t to(1, dups + entries / 2);
+    l.trim(g_ceph_context, to, nullptr, nullptr, nullptr);
+  }
+  cout << "trim " << (ceph_clock_now() - start) << " s" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include <map>
+
+#include "gtest/gtest.h"
+#include "osdc/Objecter.h"
+
+namespace {
+
+struct loads_t {
+  std::map<int, uint64_t> m;
+  uint64_t operator()(int osd) const {
+    auto p = m.find(osd);
+    return p == m.end() ? 0 : p->second;
+  }
+};
+
+} // anonymous namespace
+
+TEST(ObjecterLoad, ExpectedWait)
+{
+  ASSERT_EQ(0u, Objecter::expected_wait(10, 0));
+  ASSERT_EQ(500u, Objecter::expected_wait(0, 500));
+  ASSERT_EQ(2000u, Objecter::expected_wait(3, 500));
+  // a short queue on a slow osd can cost more than a long one
+  ASSERT_GT(Objecter::expected_wait(1, 4000),
+            Objecter::expected_wait(6, 1000));
+}
+
+TEST(ObjecterLoad, PicksLeastLoaded)
+{
+  std::vector<int> acting = {4, 7, 9};
+  loads_t loads{{{4, 3000}, {7, 800}, {9, 1500}}};
+  for (unsigned start = 0; start < acting.size(); ++start) {
+    ASSERT_EQ(1u, Objecter::pick_least_loaded(acting, start, loads));
+  }
+  // hints change as replies come in
+  loads.m[9] = 200;
+  for (unsigned start = 0; start < acting.size(); ++start) {
+    ASSERT_EQ(2u, Objecter::pick_least_loaded(acting, start, loads));
+  }
+}
+
+TEST(ObjecterLoad, NoHintIsIdle)
+{
+  // an osd we have not heard from lately is probed, wherever we start
+  std::vector<int> acting = {4, 7, 9};
+  loads_t loads{{{4, 3000}, {7, 800}}};
+  for (unsigned start = 0; start < acting.size(); ++start) {
+    ASSERT_EQ(2u, Objecter::pick_least_loaded(acting, start, loads));
+  }
+}
+
+TEST(ObjecterLoad, TiesGoToStart)
+{
+  std::vector<int> acting = {4, 7, 9};
+  loads_t loads{{{4, 1000}, {7, 1000}, {9, 1000}}};
+  for (unsigned start = 0; start < acting.size(); ++start) {
+    ASSERT_EQ(start, Objecter::pick_least_loaded(acting, start, loads));
+  }
+  // with no hints at all the pick is as random as start
+  loads.m.clear();
+  for (unsigned start = 0; start < acting.size(); ++start) {
+    ASSERT_EQ(start, Objecter::pick_least_loaded(acting, start, loads));
+  }
+}
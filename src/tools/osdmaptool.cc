@@ -67,6 +67,7 @@ void usage()
   cout << "                           max deviation from target [default: 5]" << std::endl;
   cout << "   --upmap-pool <poolname> restrict upmap balancing to 1 or more pools" << std::endl;
   cout << "   --upmap-active          Act like an active balancer, keep applying changes until balanced" << std::endl;
+  cout << "   --upmap-bench           like --upmap-active, but only report the time taken by each round" << std::endl;
   cout << "   --dump <format>         displays the map in plain text when <format> is 'plain', 'json' if specified format is not supported" << std::endl;
   cout << "   --tree                  displays a tree of the map" << std::endl;
   cout << "   --test-crush [--range-first <first> --range-last <last>] map pgs to acting osds" << std::endl;
@@ -182,6 +183,7 @@ int main(int argc, const char **argv)
   int upmap_max = 10;
   int upmap_deviation = 5;
   bool upmap_active = false;
+  bool upmap_bench = false;
   std::set<std::string> upmap_pools;
   std::random_device::result_type upmap_seed;
   std::random_device::result_type *upmap_p_seed = nullptr;
@@ -236,6 +238,9 @@ int main(int argc, const char **argv)
       createsimple = true;
     } else if (ceph_argparse_flag(args, i, "--upmap-active", (char*)NULL)) {
       upmap_active = true;
+    } else if (ceph_argparse_flag(args, i, "--upmap-bench", (char*)NULL)) {
+      upmap_active = true;
+      upmap_bench = true;
     } else if (ceph_argparse_flag(args, i, "--health", (char*)NULL)) {
       health = true;
     } else if (ceph_argparse_flag(args, i, "--with-default-pool", (char*)NULL)) {
@@ -602,16 +607,21 @@ int main(int argc, const char **argv)
       goto skip_upmap;
     }
     int rounds = 0;
+    float max_round_time = 0;
+    // calc_pg_upmaps picks up where the previous round left each pool
+    map<int64_t, OSDMap::upmap_state_t> upmap_states;
     struct timespec round_start;
     [[maybe_unused]] int r = clock_gettime(CLOCK_MONOTONIC, &round_start);
     assert(r == 0);
     do {
       random_device_t rd;
       std::shuffle(pools.begin(), pools.end(), std::mt19937{rd()});
-      cout << "pools ";
-      for (auto& i: pools)
-        cout << osdmap.get_pool_name(i) << " ";
-      cout << std::endl;
+      if (!upmap_bench) {
+        cout << "pools ";
+        for (auto& i: pools)
+          cout << osdmap.get_pool_name(i) << " ";
+        cout << std::endl;
+      }
       OSDMap::Incremental pending_inc(osdmap.get_epoch()+1);
       pending_inc.fsid = osdmap.get_fsid();
       int total_did = 0;
@@ -626,7 +636,7 @@ int main(int argc, const char **argv)
         int did = osdmap.calc_pg_upmaps(
           g_ceph_context, upmap_deviation,
           left, one_pool,
-          &pending_inc, upmap_p_seed);
+          &pending_inc, upmap_p_seed, &upmap_states[i]);
         total_did += did;
         left -= did;
         if (left <= 0)
@@ -637,12 +647,20 @@ int main(int argc, const char **argv)
       }
       r = clock_gettime(CLOCK_MONOTONIC, &end);
       assert(r == 0);
-      cout << "prepared " << total_did << "/" << upmap_max  << " changes" << std::endl;
       float elapsed_time = (end.tv_sec - begin.tv_sec) + 1.0e-9*(end.tv_nsec - begin.tv_nsec);
-      if (upmap_active)
-        cout << "Time elapsed " << elapsed_time << " secs" << std::endl;
+      max_round_time = std::max(max_round_time, elapsed_time);
+      if (upmap_bench) {
+        cout << "round " << rounds << " prepared " << total_did << "/"
+             << upmap_max << " changes in " << elapsed_time << " secs"
+             << std::endl;
+      } else {
+        cout << "prepared " << total_did << "/" << upmap_max  << " changes" << std::endl;
+        if (upmap_active)
+          cout << "Time elapsed " << elapsed_time << " secs" << std::endl;
+      }
       if (total_did > 0) {
-        print_inc_upmaps(pending_inc, upmap_fd, vstart);
+        if (!upmap_bench)
+          print_inc_upmaps(pending_inc, upmap_fd, vstart);
         if (save || upmap_active) {
 	  int r = osdmap.apply_incremental(pending_inc);
 	  ceph_assert(r == 0);
@@ -654,25 +672,31 @@ int main(int argc, const char **argv)
 	     << "or distribution is already perfect"
 	     << std::endl;
         if (upmap_active) {
-          map<int,set<pg_t>> pgs_by_osd;
-          for (auto& i : osdmap.get_pools()) {
-            if (!upmap_pool_nums.empty() && !upmap_pool_nums.count(i.first))
-              continue;
-            for (unsigned ps = 0; ps < i.second.get_pg_num(); ++ps) {
-              pg_t pg(ps, i.first);
-              vector<int> up;
-              osdmap.pg_to_up_acting_osds(pg, &up, nullptr, nullptr, nullptr);
-              //ldout(cct, 20) << __func__ << " " << pg << " up " << up << dendl;
-              for (auto osd : up) {
-                if (osd != CRUSH_ITEM_NONE)
-                  pgs_by_osd[osd].insert(pg);
+          if (!upmap_bench) {
+            map<int,set<pg_t>> pgs_by_osd;
+            for (auto& i : osdmap.get_pools()) {
+              if (!upmap_pool_nums.empty() && !upmap_pool_nums.count(i.first))
+                continue;
+              for (unsigned ps = 0; ps < i.second.get_pg_num(); ++ps) {
+                pg_t pg(ps, i.first);
+                vector<int> up;
+                osdmap.pg_to_up_acting_osds(pg, &up, nullptr, nullptr, nullptr);
+                //ldout(cct, 20) << __func__ << " " << pg << " up " << up << dendl;
+                for (auto osd : up) {
+                  if (osd != CRUSH_ITEM_NONE)
+                    pgs_by_osd[osd].insert(pg);
+                }
               }
             }
+            for (auto& i : pgs_by_osd)
+              cout << "osd." << i.first << " pgs " << i.second.size() << std::endl;
           }
-          for (auto& i : pgs_by_osd)
-            cout << "osd." << i.first << " pgs " << i.second.size() << std::endl;
           float elapsed_time = (end.tv_sec - round_start.tv_sec) + 1.0e-9*(end.tv_nsec - round_start.tv_nsec);
           cout << "Total time elapsed " << elapsed_time << " secs, " << rounds << " rounds" << std::endl;
+          if (upmap_bench && rounds > 0) {
+            cout << "Time per round " << elapsed_time / rounds
+                 << " secs, max " << max_round_time << " secs" << std::endl;
+          }
         }
         break;
       }